@@ -2,24 +2,34 @@
 #ifndef YB__ORM__DIALECT_INTERBASE__INCLUDED
 #define YB__ORM__DIALECT_INTERBASE__INCLUDED
 
+#include <map>
+#include "util/thread.h"
 #include "orm/sql_driver.h"
 
 namespace Yb {
 
 class InterbaseDialect: public SqlDialect
 {
+    // the returning model found for each source
+    Mutex mux_;
+    std::map<String, int> returning_models_;
 public:
     InterbaseDialect();
     Strings really_get_tables(SqlConnection &conn,
             const String &table, bool view, bool show_system);
     virtual const String select_curr_value(const String &seq_name);
     virtual const String select_next_value(const String &seq_name);
+    virtual const String select_next_block(const String &seq_name,
+            int increment);
     virtual const String sql_value(const Value &x);
     virtual bool commit_ddl();
     virtual const String type2sql(int t);
-    virtual const String create_sequence(const String &seq_name);
+    virtual const String create_sequence(const String &seq_name,
+            int increment = 1);
     virtual const String drop_sequence(const String &seq_name);
     virtual int pager_model();
+    virtual int insert_model();
+    virtual int returning_model(SqlConnection &conn);
     // schema introspection
     virtual bool table_exists(SqlConnection &conn, const String &table);
     virtual bool view_exists(SqlConnection &conn, const String &table);
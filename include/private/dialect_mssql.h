@@ -17,13 +17,16 @@ public:
     virtual const String select_last_inserted_id(const String &table_name);
     virtual const String sql_value(const Value &x);
     virtual const String type2sql(int t);
-    virtual const String create_sequence(const String &seq_name);
+    virtual const String create_sequence(const String &seq_name,
+            int increment = 1);
     virtual const String drop_sequence(const String &seq_name);
     virtual const String suffix_create_table();
     virtual const String autoinc_flag();
     virtual const String grant_insert_id_statement(const String &table_name, bool on);
     virtual bool explicit_null();
     virtual int pager_model();
+    virtual int max_params();
+    virtual int returning_model(SqlConnection &conn);
     // schema introspection
     virtual bool table_exists(SqlConnection &conn, const String &table);
     virtual bool view_exists(SqlConnection &conn, const String &table);
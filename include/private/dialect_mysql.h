@@ -17,7 +17,8 @@ public:
     virtual const String select_last_inserted_id(const String &table_name);
     virtual const String sql_value(const Value &x);
     virtual const String type2sql(int t);
-    virtual const String create_sequence(const String &seq_name);
+    virtual const String create_sequence(const String &seq_name,
+            int increment = 1);
     virtual const String drop_sequence(const String &seq_name);
     virtual const String suffix_create_table();
     virtual const String autoinc_flag();
@@ -25,6 +26,7 @@ public:
     virtual const String not_null_default(const String &not_null_clause,
             const String &default_value);
     virtual int pager_model();
+    virtual int max_params();
     // schema introspection
     virtual bool table_exists(SqlConnection &conn, const String &table);
     virtual bool view_exists(SqlConnection &conn, const String &table);
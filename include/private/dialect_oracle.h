@@ -14,10 +14,13 @@ public:
     virtual const String select_next_value(const String &seq_name);
     virtual const String sql_value(const Value &x);
     virtual const String type2sql(int t);
-    virtual const String create_sequence(const String &seq_name);
+    virtual const String create_sequence(const String &seq_name,
+            int increment = 1);
     virtual const String drop_sequence(const String &seq_name);
     virtual const String sysdate_func();
     virtual int pager_model();
+    virtual int insert_model();
+    virtual int max_params();
     // schema introspection
     virtual bool table_exists(SqlConnection &conn, const String &table);
     virtual bool view_exists(SqlConnection &conn, const String &table);
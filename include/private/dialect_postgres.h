@@ -14,8 +14,10 @@ public:
     virtual const String select_next_value(const String &seq_name);
     virtual const String sql_value(const Value &x);
     virtual const String type2sql(int t);
-    virtual const String create_sequence(const String &seq_name);
+    virtual const String create_sequence(const String &seq_name,
+            int increment = 1);
     virtual const String drop_sequence(const String &seq_name);
+    virtual int returning_model(SqlConnection &conn);
     // schema introspection
     virtual bool table_exists(SqlConnection &conn, const String &table);
     virtual bool view_exists(SqlConnection &conn, const String &table);
@@ -18,10 +18,14 @@ public:
     virtual const String type2sql(int t);
     virtual bool fk_internal();
     virtual bool has_for_update();
-    virtual const String create_sequence(const String &seq_name);
+    virtual const String create_sequence(const String &seq_name,
+            int increment = 1);
     virtual const String drop_sequence(const String &seq_name);
     virtual const String primary_key_flag();
     virtual const String autoinc_flag();
+    virtual int max_params();
+    virtual int max_insert_rows();
+    virtual int returning_model(SqlConnection &conn);
     // schema introspection
     virtual bool table_exists(SqlConnection &conn, const String &table);
     virtual bool view_exists(SqlConnection &conn, const String &table);
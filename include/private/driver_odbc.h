@@ -7,19 +7,27 @@
 #include "orm/sql_driver.h"
 #include "tiodbc.h"
 
+// rows fetched at once, see "fetch_array_size" source option
+#define YB_ODBC_FETCH_ARRAY_SIZE 64
+
 namespace Yb {
 
 class OdbcCursorBackend: public SqlCursorBackend
 {
     tiodbc::connection *conn_;
     std::auto_ptr<tiodbc::statement> stmt_;
+    RowDescr::Ptr descr_;
+    int fetch_array_size_;
     void really_exec(const Values &params);
 public:
-    OdbcCursorBackend(tiodbc::connection *conn);
+    OdbcCursorBackend(tiodbc::connection *conn, int fetch_array_size = 1);
     void exec_direct(const String &sql);
     void prepare(const String &sql);
     void exec(const Values &params);
+    void exec_many(const std::vector<Values> &params_set);
     RowPtr fetch_row();
+    bool fetch_into(Row &row);
+    void reset();
 };
 
 class OdbcDriver;
@@ -28,6 +36,7 @@ class OdbcConnectionBackend: public SqlConnectionBackend
 {
     std::auto_ptr<tiodbc::connection> conn_;
     OdbcDriver *drv_;
+    int fetch_array_size_;
 public:
     OdbcConnectionBackend(OdbcDriver *drv);
     void open(SqlDialect *dialect, const SqlSource &source);
@@ -18,6 +18,7 @@ class SOCICursorBackend: public SqlCursorBackend
     bool is_select_, bound_first_, executed_;
     TypeCodes param_types_;
     soci::row row_;
+    RowDescr::Ptr descr_;
     std::vector<std::string> in_params_;
     std::vector<soci::indicator> in_flags_;
 public:
@@ -28,6 +29,7 @@ public:
     void prepare(const String &sql);
     void bind_params(const TypeCodes &types);
     void exec(const Values &params);
+    void exec_many(const std::vector<Values> &params_set);
     RowPtr fetch_row();
 };
 
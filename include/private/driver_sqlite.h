@@ -18,6 +18,13 @@ class SQLiteCursorBackend: public SqlCursorBackend
     SQLiteDatabase *conn_;
     SQLiteQuery *stmt_;
     int last_code_, exec_count_;
+    RowDescr::Ptr descr_;
+    // columns whose REAL values are fetched as text, see prepare()
+    std::vector<char> real_as_text_;
+    // text and blob parameters bound with SQLITE_STATIC, every later
+    // sqlite3_step() reads them, so they live until the next exec
+    std::vector<std::string> bound_;
+    void bind_and_step(const Values &params);
 public:
     SQLiteCursorBackend(SQLiteDatabase *conn);
     ~SQLiteCursorBackend();
@@ -25,7 +32,10 @@ public:
     void exec_direct(const String &sql);
     void prepare(const String &sql);
     void exec(const Values &params);
+    void exec_many(const std::vector<Values> &params_set);
     RowPtr fetch_row();
+    bool fetch_into(Row &row);
+    void reset();
 };
 
 class SQLiteDriver;
@@ -61,6 +61,7 @@ namespace tiodbc
 	class connection;
 	class field_impl;
 	class param_impl;
+	class param_array;
 	class statement;	
 
 	class bind_error: public std::runtime_error
@@ -71,6 +72,22 @@ namespace tiodbc
 		{}
 	};
 
+	class fetch_error: public std::runtime_error
+	{
+	public:
+		fetch_error(int col_num):
+			std::runtime_error("can't read truncated value, column N " + Yb::to_stdstring(col_num))
+		{}
+	};
+
+	class row_error: public std::runtime_error
+	{
+	public:
+		row_error(size_t row_num):
+			std::runtime_error("can't fetch row N " + Yb::to_stdstring((int)row_num) + " of the block")
+		{}
+	};
+
 	//! @name Library Version
 	//! @{
 
@@ -291,10 +308,14 @@ namespace tiodbc
 		int type;				//!< Column data type code
 		mutable int is_null_flag;	//!< Column is null (0=no, 1=yes, -1=unknown yet)
 		mutable _tstring str_buf;   //!< Column value buffer
+		const char *bound_data;		//!< Value in the block buffer, if bound
+		SQLSMALLINT bound_type;		//!< C type of the bound value
 
 		// Not direct constructible
 		field_impl(HSTMT _stmt, int _col_num,
-				const _tstring _name, int _type);
+				const _tstring _name, int _type,
+				const char *_bound_data = NULL,
+				SQLSMALLINT _bound_type = 0, SQLLEN _bound_ind = 0);
 
 	public:
 	
@@ -413,6 +434,63 @@ namespace tiodbc
 		//! @}
 	};	// !param_impl
 
+	//! Handler of a parameter bound to an array of values.
+	/**
+		Used to execute a prepared statement for many sets of
+		parameters at once, see statement::array_param().
+		All the values of the array must be of the same type,
+		a value that was not set is NULL.
+	@note tiodbc::param_array is <B>Uncopiable</b>, <b>NON inheritable</b> and <b>NOT direct constructible</b>
+	*/
+	class param_array
+	{
+	public:
+		friend class statement;
+
+	private:
+		HSTMT stmt_h;			//!< Handle of statement that parameter is set
+		int par_num;			//!< Order number of the parameter
+		size_t rows;			//!< Number of values
+		SQLSMALLINT c_type;		//!< C type of the values, 0 if not known yet
+		int elem_sz;			//!< Size of one element in the buffer
+		std::vector<char> buffer;	//!< Column-wise buffer of values
+		std::vector<SQLLEN> ind;	//!< Str Length Or Indicator per value
+		std::vector<std::vector<SQLTCHAR> > strings;
+
+		// Not direct constructible
+		param_array(HSTMT _stmt, int _par_num, size_t _rows);
+
+		// Not copyable
+		param_array(const param_array&);
+		param_array & operator=(const param_array&);
+
+		char *slot(size_t _row, SQLSMALLINT _c_type, int _elem_sz);
+		void bind();
+	public:
+		//! @name Value assignment functions
+		//! @{
+
+		//! Set the value in a row as string
+		void set_as_string(size_t _row, const _tstring & _str);
+
+		//! Set the value in a row as long
+		void set_as_long(size_t _row, const long & _value);
+
+		//! Set the value in a row as long long
+		void set_as_long_long(size_t _row, const LongLong & _value);
+
+		//! Set the value in a row as double
+		void set_as_double(size_t _row, const double & _value);
+
+		//! Set the value in a row as DateTime
+		void set_as_date_time(size_t _row, const TIMESTAMP_STRUCT & _value);
+
+		//! Set the value in a row as NULL
+		void set_as_null(size_t _row);
+
+		//! @}
+	};	// !param_array
+
 	//! An ODBC statement representation object
 	/**
 		Represents a statement on the server. Statement is used to
@@ -439,6 +517,31 @@ namespace tiodbc
 		typedef std::map<int, param_impl *> param_map_type;
 		typedef param_map_type::iterator param_it;
 		param_map_type m_params;
+		typedef std::map<int, param_array *> param_array_map_type;
+		typedef param_array_map_type::iterator param_array_it;
+		param_array_map_type m_param_arrays;
+		size_t m_paramset_size;
+		std::vector<SQLUSMALLINT> m_param_status;	//!< Per parameter set
+		SQLULEN m_params_processed;
+		void free_params();
+
+		// Column-wise buffers of a block cursor
+		struct bound_col
+		{
+			SQLSMALLINT c_type;
+			SQLLEN elem_sz;
+			std::vector<char> buffer;
+			std::vector<SQLLEN> ind;
+		};
+		std::vector<bound_col> m_bound_cols;
+		size_t m_row_array_size;	//!< Rows to fetch at once
+		bool b_block_mode;			//!< Result set is read in blocks
+		SQLULEN m_rows_fetched;		//!< Rows in the current block
+		std::vector<SQLUSMALLINT> m_row_status;	//!< Per row of the block
+		size_t m_block_pos;			//!< Current row within the block
+		bool bind_cols();
+		void unbind_cols();
+		_tstring get_truncated(int _num) const;
 
 		struct col_descr
 		{
@@ -726,6 +829,23 @@ namespace tiodbc
 		//! Free current opened result set.
 		void free_results();
 
+		//! Set the number of rows to fetch at once
+		/**
+			With more than one row the columns of a result set are
+			bound to column-wise buffers, and fetch_next() calls SQLFetch
+			once per block of rows.  If the driver has no block cursors
+			or some column can't be bound (long data) the rows are
+			fetched one by one as usual.  Takes effect on the next
+			execution of the statement.
+		*/
+		void set_row_array_size(size_t _rows);
+
+		//! Get the number of rows to fetch at once
+		size_t row_array_size() const { return m_row_array_size; }
+
+		//! Check if the current result set is read in blocks
+		bool block_mode() const { return b_block_mode; }
+
 		//! @}
 
 		//! @name Parameters handling
@@ -752,6 +872,40 @@ namespace tiodbc
 		*/
 		param_impl &param(int _num);
 
+		//! Set the number of parameter sets for execute_arrays()
+		/**
+		@return <b>True</b> if the driver supports arrays of parameters
+			of this size, <b>False</b> otherwise.
+		*/
+		bool set_paramset_size(size_t _rows);
+
+		//! Handle a parameter bound to an array of values
+		/**
+			The array has as many values as was given to
+			set_paramset_size(). Like with param() the returned
+			object must not be stored.
+		*/
+		param_array &array_param(int _num);
+
+		//! Execute the prepared statement for all the parameter sets
+		/**
+			Parameters are bound column-wise, one array per parameter.
+			Call reset_parameters() afterwards to get back
+			to the single set of parameters.
+		@return <b>True</b> if every parameter set has been processed
+			with no error, check last_error() and failed_paramset()
+			otherwise.
+		*/
+		bool execute_arrays();
+
+		//! The first parameter set not executed by execute_arrays()
+		/**
+		@return The zero based number of the first parameter set
+			that failed or has not been processed,
+			-1 if all of them succeeded.
+		*/
+		int failed_paramset() const;
+
 		//! Reset parameters (unbind all parameters)
 		/**
 			It will remove (unbind) all the assigned
@@ -42,11 +42,11 @@ class YBORM_DECL SqlSchemaGenerator
 {
     const Schema &schema_;
     SqlDialect *dialect_;
-    std::set<String> sequences_;
+    std::map<String, int> sequences_;
     bool need_commit_, new_table_;
     Schema::TblMap::const_iterator tbl_it_, tbl_constr_it_, tbl_idx_it_;
     Columns::const_iterator col_it_, col_end_;
-    std::set<String>::const_iterator seq_it_;
+    std::map<String, int>::const_iterator seq_it_;
 public:
     SqlSchemaGenerator(const Schema &schema, SqlDialect *dialect);
     void generate(std::ostream &out);
@@ -79,6 +79,18 @@ public:
     DataObjectAlreadyInSession(const Key &key);
 };
 
+class YBORM_DECL ReadOnlyCachedTable: public ORMError
+{
+public:
+    ReadOnlyCachedTable(const String &table_name);
+};
+
+class YBORM_DECL PrefetchRelationNotFound: public ORMError
+{
+public:
+    PrefetchRelationNotFound(const String &relation_name);
+};
+
 #define EMPTY_DATAOBJ (::Yb::DataObject::Ptr(NULL))
 
 class DataObject;
@@ -98,13 +110,113 @@ class YBORM_DECL DataObjectResultSet: public ResultSetBase<DataObjectList>
     std::auto_ptr<SqlResultSet::iterator> it_;
     std::vector<const Table *> tables_;
     Session &session_;
+    // relations to load the slaves of, for all the rows at once
+    Strings prefetch_;
+    std::vector<DataObjectList> rows_;
+    size_t pos_;
+    bool prefetched_;
+    bool untracked_;
 
+    bool fetch_row(DataObjectList &row);
+    void fetch_all_and_prefetch();
     bool fetch(DataObjectList &row);
     DataObjectResultSet();
 public:
+    /** In untracked mode the objects are not added to the session:
+     * they are returned detached and live only as long as the row
+     * or the caller hold them, which keeps memory use constant while
+     * streaming big results.  The objects not held anywhere else are
+     * refilled in place with the next rows.
+     */
     DataObjectResultSet(const SqlResultSet &rs, Session &session,
-                        const Strings &tables);
+                        const Strings &tables, bool untracked = false);
     DataObjectResultSet(const DataObjectResultSet &obj);
+    /** Read all the rows before the first one is returned, then load
+     * the slaves of the relation given by its property name for all
+     * the masters read, so that iterating them costs no queries.
+     * Throws PrefetchRelationNotFound on reading if none of the tables
+     * is the master side of such a relation.
+     * Not available in untracked mode.
+     */
+    void prefetch(const String &relation_name);
+    bool untracked() const { return untracked_; }
+};
+
+//! Maps object keys to DataObjects within a Session
+/** An open addressing hash table with linear probing, keyed by
+ * key_hash(), so that looking up a surrogate integer key costs
+ * a single hash of the table name and the id.
+ * Iteration order is unspecified.
+ */
+class YBORM_DECL IdentityMap
+{
+public:
+    struct Slot {
+        Key key;
+        size_t hash;
+        DataObject *obj; // NULL for a free slot
+        Slot(): hash(0), obj(NULL) {}
+    };
+    typedef std::vector<Slot> Slots;
+
+    class const_iterator
+    {
+        Slots::const_iterator i_, end_;
+        void skip_free() { while (i_ != end_ && !i_->obj) ++i_; }
+    public:
+        const_iterator(Slots::const_iterator i, Slots::const_iterator end)
+            : i_(i), end_(end)
+        { skip_free(); }
+        const Slot &operator*() const { return *i_; }
+        const Slot *operator->() const { return &*i_; }
+        const_iterator &operator++() { ++i_; skip_free(); return *this; }
+        bool operator==(const const_iterator &x) const { return i_ == x.i_; }
+        bool operator!=(const const_iterator &x) const { return i_ != x.i_; }
+    };
+
+    IdentityMap(): size_(0) {}
+    size_t size() const { return size_; }
+    bool empty() const { return !size_; }
+    const_iterator begin() const {
+        return const_iterator(slots_.begin(), slots_.end());
+    }
+    const_iterator end() const {
+        return const_iterator(slots_.end(), slots_.end());
+    }
+    DataObject *find(const Key &key) const;
+    //! Insert unless the key is there, return the object found or NULL
+    DataObject *insert(const Key &key, DataObject *obj);
+    bool erase(const Key &key);
+    void clear();
+    void swap(IdentityMap &other);
+
+private:
+    size_t lookup(const Key &key, size_t hash) const;
+    void grow();
+
+    Slots slots_;
+    size_t size_;
+};
+
+//! Intrusive list of the DataObjects of a Session sharing a status
+/** Objects are linked through their own work_prev_/work_next_
+ * pointers, so adding and removing one never allocates.
+ */
+class YBORM_DECL WorkList
+{
+    DataObject *head_, *tail_;
+    size_t size_;
+public:
+    WorkList(): head_(NULL), tail_(NULL), size_(0) {}
+    DataObject *head() const { return head_; }
+    size_t size() const { return size_; }
+    bool empty() const { return !head_; }
+    void push(DataObject *obj);
+    void remove(DataObject *obj);
+    //! Unlink all the objects
+    void clear();
+    //! Append the objects to the vector in the order they were added
+    void copy_to(std::vector<DataObject *> &out) const;
 };
 
 //! Session handles persisted DataObjects
@@ -117,22 +229,38 @@ class YBORM_DECL Session: public NonCopyable
     friend class ::TestDataObject;
     friend class ::TestDataObjectSaveLoad;
     friend class ::TestDomainObject;
+    friend class DataObject;
     typedef std::set<DataObjectPtr> Objects;
-    typedef std::map<Key, DataObject *> IdentityMap;
+    typedef std::vector<DataObject *> ObjectPtrs;
+    typedef std::map<const Table *, WorkList> GhostLists;
 
     ILogger::Ptr logger_, engine_logger_;
     Objects objects_;
     IdentityMap identity_map_;
+    // Objects with New, Dirty, ToBeDeleted and Deleted status,
+    // indexed by DataObject::Status, for flush() not to scan objects_
+    WorkList work_lists_[6];
+    // Ghost objects of the tables with batch loading enabled
+    GhostLists ghost_lists_;
+    // Cached tables changed in the current transaction, these bypass
+    // the second-level cache and get invalidated in it on commit
+    std::set<String> changed_cached_tables_;
     const Schema &schema_;
     std::auto_ptr<EngineSource> created_engine_;
     std::auto_ptr<EngineCloned> engine_;
 
     DataObject *add_to_identity_map(DataObject *obj, bool return_found);
+    void link_work(DataObject *obj);
+    void unlink_work(DataObject *obj);
+    void clear_work_lists();
+    void load_ghosts(DataObject *obj);
+    EntityCache *entity_cache_for(const Table &tbl);
+    void note_cached_changes();
     void flush_tbl_new_keyed(const Table &tbl, Objects &keyed_objs);
     void flush_tbl_new_unkeyed(const Table &tbl, Objects &unkeyed_objs);
     void flush_new();
-    void flush_update(IdentityMap &idmap_copy);
-    void flush_delete(IdentityMap &idmap_copy);
+    void flush_update();
+    void flush_delete();
     void clone_engine(EngineSource *src_engine);
 public:
     void set_logger(ILogger::Ptr logger);
@@ -172,12 +300,20 @@ public:
                          const Expression &filter,
                          const Expression &order_by = Expression(),
                          bool for_update_flag = false);
+    //! Load objects, untracked ones see DataObjectResultSet
     DataObjectResultSet load_collection(
             const Expression &tables, const Expression &filter,
             const Expression &order_by = Expression(),
-            bool for_update_flag = false);
+            bool for_update_flag = false, bool untracked = false);
     DataObjectResultSet load_collection(
-            const Strings &tables, const SelectExpr &select_expr);
+            const Strings &tables, const SelectExpr &select_expr,
+            bool untracked = false);
+    /** Load the slaves of the relation for all the masters given
+     * using a few queries, instead of a query per master.
+     */
+    void prefetch_slaves(const DataObjectList &masters, const Relation &rel);
+    //! Prefetch the slaves for every relation where objs are masters.
+    void prefetch_master_relations(const DataObjectList &objs);
 };
 
 enum DeletionMode { DelNormal, DelDryRun, DelUnchecked };
@@ -200,6 +336,8 @@ class YBORM_DECL DataObject
     : private NonCopyable, public RefCountBase
 {
     friend class Session;
+    friend class WorkList;
+    friend class DataObjectResultSet;
 public:
     typedef DataObjectPtr Ptr;
     typedef Values::iterator iterator;
@@ -216,6 +354,9 @@ private:
     Key key_;
     bool assigned_key_;
     int depth_;
+    DataObject *work_prev_, *work_next_;
+    // non-key columns set since the object has been in Sync status
+    ColumnMask modified_;
 
     DataObject(const Table &table, Status status)
         : table_(table)
@@ -224,6 +365,8 @@ private:
         , session_(NULL)
         , assigned_key_(false)
         , depth_(0)
+        , work_prev_(NULL)
+        , work_next_(NULL)
     {}
     void update_key();
     void load();
@@ -231,7 +374,12 @@ private:
         if ((!c || !c->is_pk()) && status_ == Ghost)
             load();
     }
-    void set_status(Status st) { status_ = st; }
+    void set_status(Status st);
+    // a detached object nothing else refers to, safe to refill
+    bool recyclable() const {
+        return ref_count_ == 1 && !session_ &&
+            slave_relations_.empty() && master_relations_.empty();
+    }
     void depth(int d) { depth_ = d; }
     void populate_all_master_relations();
 public:
@@ -272,6 +420,9 @@ public:
     const Key &key();
     Key fk_value_for(const Relation &r);
     const Values &raw_values() const { return values_; }
+    //! Columns changed by set() since the last load or flush,
+    //! empty if the whole row is to be updated
+    const ColumnMask &modified_columns() const { return modified_; }
     bool assigned_key();
     SlaveRelations &slave_relations() {
         return slave_relations_;
@@ -441,27 +441,25 @@ inline int find_data_obj_in_row_by_table(const DataObjectList &row,
 
 #if defined(YB_USE_TUPLE)
 template <class H>
-boost::tuples::cons<H, boost::tuples::null_type>
-row2tuple(const boost::tuples::cons<H, boost::tuples::null_type> &,
-    const DataObjectList &row, int pos)
+void
+row2tuple(const DataObjectList &row,
+    boost::tuples::cons<H, boost::tuples::null_type> &item)
 {
-    boost::tuples::null_type tail;
     // TODO: for now, search only for the first occurrence of the table
     int tpos = find_data_obj_in_row_by_table(row, H::get_table_name(), 1);
     YB_ASSERT(tpos >= 0);
-    return boost::tuples::cons<H, boost::tuples::null_type>(H(row[tpos]), tail);
+    item.get_head() = H(row[tpos]);
 }
 
 template <class H, class T>
-boost::tuples::cons<H, T>
-row2tuple(const boost::tuples::cons<H, T> &item,
-    const DataObjectList &row, int pos)
+void
+row2tuple(const DataObjectList &row, boost::tuples::cons<H, T> &item)
 {
     // TODO: for now, search only for the first occurrence of the table
     int tpos = find_data_obj_in_row_by_table(row, H::get_table_name(), 1);
     YB_ASSERT(tpos >= 0);
-    return boost::tuples::cons<H, T>(H(row[tpos]),
-        row2tuple(item.get_tail(), row, pos + 1));
+    item.get_head() = H(row[tpos]);
+    row2tuple(row, item.get_tail());
 }
 
 template <class T0, class T1, class T2, class T3, class T4,
@@ -479,8 +477,8 @@ class DomainResultSet<boost::tuple<T0, T1, T2, T3, T4, T5, T6, T7, T8, T9> >
                     new DataObjectResultSet::iterator(rs_.begin()));
         if (rs_.end() == *it_)
             return false;
-        typename R::inherited tuple;
-        row = row2tuple(tuple, **it_, 0);
+        typename R::inherited &tuple = row;
+        row2tuple(**it_, tuple);
         ++*it_;
         return true;
     }
@@ -644,6 +642,20 @@ class QueryObj {
     Expression filter_, order_;
     bool for_update_;
     int limit_, offset_;
+    Strings prefetch_;
+    bool untracked_;
+
+    DataObjectResultSet load_collection(const Strings &tables,
+            const SelectExpr &select_expr)
+    {
+        DataObjectResultSet rs = session_->load_collection(
+                tables, select_expr, untracked_);
+        Strings::const_iterator it = prefetch_.begin(),
+            end = prefetch_.end();
+        for (; it != end; ++it)
+            rs.prefetch(*it);
+        return rs;
+    }
 public:
     QueryObj(Session &session, const Expression &filter = Expression(),
             const Expression &order = Expression(), bool for_update = false)
@@ -654,6 +666,7 @@ public:
         , for_update_(for_update)
         , limit_(0)
         , offset_(0)
+        , untracked_(false)
     {}
 
     template <class D>
@@ -750,6 +763,20 @@ public:
         return q;
     }
 
+    //! Load the slaves of the relation for all the objects fetched
+    QueryObj prefetch(const String &relation_name) {
+        QueryObj q(*this);
+        q.prefetch_.push_back(relation_name);
+        return q;
+    }
+
+    //! Stream detached objects, not registered in the session
+    QueryObj untracked() {
+        QueryObj q(*this);
+        q.untracked_ = true;
+        return q;
+    }
+
     QueryObj range(int start, int end) {
         QueryObj q(*this);
         q.limit_ = end - start;
@@ -774,15 +801,13 @@ public:
     DomainResultSet<R> all() {
         Strings tables;
         SelectExpr select_expr = get_select(tables);
-        return DomainResultSet<R>(session_->load_collection(
-                    tables, select_expr));
+        return DomainResultSet<R>(load_collection(tables, select_expr));
     }
 
     R one() {
         Strings tables;
         SelectExpr select_expr = get_select(tables);
-        DomainResultSet<R> r = session_->load_collection(
-                tables, select_expr);
+        DomainResultSet<R> r = load_collection(tables, select_expr);
         typename DomainResultSet<R>::iterator it = r.begin();
         if (it == r.end())
             throw NoDataFound("No data");
@@ -798,7 +823,7 @@ public:
         select.from_(ColumnExpr(get_select(tables), _T("X")));
         SqlResultSet rs = session_->engine()->select_iter(select);
         Row r = *rs.begin();
-        return r[0].second.as_longint();
+        return r[0].as_longint();
     }
 
     R first() { return range(0, 1).one(); }
@@ -4,6 +4,7 @@
 
 #include <memory>
 #include <vector>
+#include <list>
 #include <string>
 #include <map>
 #include <set>
@@ -20,8 +21,163 @@ class TestEngine;
 
 namespace Yb {
 
+class EngineBase;
+
+//! Source of surrogate primary key values for new objects
+class YBORM_DECL IdAllocator
+{
+public:
+    virtual ~IdAllocator();
+    virtual LongInt next_id(EngineBase &engine, const Table &table) = 0;
+};
+
+/** Thread-safe cache of sequence blocks ("pooled-lo" scheme).
+    A value v obtained from a sequence created with INCREMENT BY n
+    reserves the ids [v, v + n - 1], the increment being taken
+    from Table::seq_increment().  With the increment of 1 every id
+    costs a round-trip to the database, like get_next_value() does.
+*/
+class YBORM_DECL BlockIdAllocator: public IdAllocator
+{
+    struct Block {
+        LongInt next_, end_;
+        bool fetching_;
+        Block(): next_(0), end_(0), fetching_(false) {}
+    };
+    typedef std::map<String, Block> Blocks;
+    Blocks blocks_;
+    Mutex mux_;
+    // signalled when a block has been fetched
+    Condition fetched_;
+protected:
+    virtual LongInt fetch_block(EngineBase &engine,
+            const String &seq_name, int increment);
+public:
+    BlockIdAllocator();
+    LongInt next_id(EngineBase &engine, const Table &table);
+    void reset();
+};
+
+struct YBORM_DECL EntityCacheStats
+{
+    LongInt hits, misses, puts, evictions, invalidations;
+    EntityCacheStats()
+        : hits(0), misses(0), puts(0), evictions(0), invalidations(0)
+    {}
+};
+
+/** Thread-safe second-level cache of table rows by primary key,
+    shared by the sessions of an Engine and all its clones.
+    Only the tables with Table::cache_mode() set are cached.
+    A row stays in the cache for the table's cache_ttl() seconds,
+    or until invalidate() is called for the table, which Session
+    does on commit for the read-write cached tables it has changed.
+    Rows read before an invalidation are not put afterwards:
+    put() takes the table's generation taken before the read.
+    When max_entries is reached, put() drops the expired rows first,
+    then the least recently used ones.
+*/
+class YBORM_DECL EntityCache: private NonCopyable
+{
+    // table name and key, most recently used first
+    typedef std::list<std::pair<String, String> > Lru;
+    struct Entry {
+        Values values;
+        time_t expires_at; // 0 for no expiry
+        Lru::iterator lru_pos;
+        Entry(): expires_at(0) {}
+    };
+    typedef std::map<String, Entry> Entries;
+    struct TableCache {
+        LongInt generation;
+        Entries entries;
+        TableCache(): generation(0) {}
+    };
+    typedef std::map<String, TableCache> TableCaches;
+    TableCaches tables_;
+    Lru lru_;
+    size_t max_entries_, size_;
+    time_t last_purge_;
+    EntityCacheStats stats_;
+    Mutex mux_;
+    void erase(TableCache &tc, Entries::iterator e);
+    void make_room();
+public:
+    explicit EntityCache(size_t max_entries = 100000);
+    LongInt generation(const Table &table);
+    bool get(const Table &table, const Key &key, Values &values);
+    void put(const Table &table, const Key &key, const Values &values,
+            LongInt generation);
+    void invalidate(const String &table_name);
+    void clear();
+    size_t size();
+    const EntityCacheStats get_stats();
+};
+
+struct YBORM_DECL QueryCacheStats
+{
+    LongInt hits, misses, puts, evictions, invalidations;
+    QueryCacheStats()
+        : hits(0), misses(0), puts(0), evictions(0), invalidations(0)
+    {}
+};
+
+/** Thread-safe cache of SELECT results, keyed by the SQL text
+    and the parameter values, shared by an Engine and all its clones.
+    Entries are evicted in the least recently used order once their
+    estimated size exceeds max_bytes.  An entry is dropped when
+    invalidate() is called for any of the tables it has been read from,
+    which EngineBase does on INSERT, UPDATE, DELETE and on commit.
+    Results read before an invalidation are not put afterwards:
+    put() takes the generation of the tables taken before the read.
+*/
+class YBORM_DECL QueryCache: private NonCopyable
+{
+    struct Entry {
+        String key;
+        Strings tables, names;
+        std::vector<Values> rows;
+        size_t bytes;
+        Entry(): bytes(0) {}
+    };
+    // most recently used first
+    typedef std::list<Entry> Entries;
+    Entries entries_;
+    std::map<String, Entries::iterator> index_;
+    std::map<String, std::set<String> > keys_by_table_;
+    std::map<String, LongInt> generations_;
+    size_t max_bytes_, bytes_;
+    QueryCacheStats stats_;
+    Mutex mux_;
+    void erase(Entries::iterator e);
+public:
+    explicit QueryCache(size_t max_bytes = 16*1024*1024);
+    size_t max_bytes() const { return max_bytes_; }
+    //! The estimated size of a row, as counted against max_bytes
+    static size_t row_bytes(const Values &values);
+    LongInt generation(const Strings &tables);
+    bool get(const String &key, Rows &rows);
+    void put(const String &key, const Strings &tables, const Rows &rows,
+            LongInt generation);
+    void invalidate(const String &table_name);
+    void clear();
+    size_t size();
+    size_t bytes();
+    const QueryCacheStats get_stats();
+};
+
 class YBORM_DECL EngineBase
 {
+    struct UpdateSql {
+        String sql;
+        TypeCodes type_codes;
+        ParamNums param_nums;
+    };
+    // generated UPDATE statements by table name and the columns set
+    typedef std::map<std::pair<String, ColumnMask>, UpdateSql> UpdateSqlCache;
+    UpdateSqlCache update_sql_cache_;
+    // tables changed in the current transaction, not cached until commit
+    std::set<String> changed_tables_;
 public:
     enum Mode { READ_ONLY = 0, READ_WRITE = 1 };
 
@@ -31,9 +187,16 @@ public:
     virtual SqlDialect *get_dialect() = 0;
     virtual ILogger *logger() = 0;
     virtual int get_mode() = 0;
+    virtual IdAllocator *id_allocator();
+    //! The second-level cache, NULL if not enabled
+    virtual EntityCache *entity_cache();
+    //! The query result cache, NULL if not enabled
+    virtual QueryCache *query_cache();
 
     SqlResultSet exec_select(const String &sql, const Values &params);
-    SqlResultSet select_iter(const Expression &select_expr);
+    // the query cache, if any, is only used if use_cache is set
+    SqlResultSet select_iter(const Expression &select_expr,
+            bool use_cache = true);
     RowsPtr select(
         const Expression &what,
         const Expression &from,
@@ -45,7 +208,9 @@ public:
         bool for_update = false);
     const std::vector<LongInt> insert(const Table &table,
             const RowsData &rows, bool collect_new_ids);
-    void update(const Table &table, const RowsData &rows);
+    // columns: the non-key columns to set, or all of them if NULL or empty
+    void update(const Table &table, const RowsData &rows,
+            const ColumnMask *columns = NULL);
     void delete_from(const Table &table, const Keys &keys);
     void exec_proc(const String &proc_code);
     RowPtr select_row(const Expression &what,
@@ -54,6 +219,7 @@ public:
             const Expression &from, const Expression &where);
     LongInt get_curr_value(const String &seq_name);
     LongInt get_next_value(const String &seq_name);
+    LongInt get_next_id(const Table &table);
     void commit();
     void rollback();
     void touch();
@@ -61,14 +227,33 @@ public:
     void create_schema(const Schema &schema, bool ignore_errors = false);
     void drop_schema(const Schema &schema, bool ignore_errors = false);
 
+    // type_codes are for all the row_count rows,
+    // param_nums are the positions within one row
     static void gen_sql_insert(String &sql, TypeCodes &type_codes,
             ParamNums &param_nums, const Table &table,
-            bool include_pk, bool numbered_params = false);
+            bool include_pk, bool numbered_params = false,
+            int row_count = 1,
+            SqlInsertModel insert_model = INSERT_VALUES_LIST,
+            SqlReturningModel returning_model = RETURNING_NONE);
     static void gen_sql_update(String &sql, TypeCodes &type_codes,
             ParamNums &param_nums, const Table &table,
-            const SqlGeneratorOptions &options);
+            const SqlGeneratorOptions &options,
+            const ColumnMask *columns = NULL);
+    // type_codes are for all the key_count keys
     static void gen_sql_delete(String &sql, TypeCodes &type_codes,
-            const Table &table, const SqlGeneratorOptions &options);
+            const Table &table, const SqlGeneratorOptions &options,
+            int key_count = 1);
+private:
+    SqlResultSet exec_select_or_reconnect(const String &sql,
+            const Values &params);
+    bool query_cache_tables(const Expression &select_expr,
+            const Values &params, Strings &tables);
+    void table_changed(const Table &table);
+    void insert_chunks(const Table &table, RowsData::const_iterator &r,
+            size_t chunk_count, size_t chunk_size,
+            std::vector<LongInt> *new_ids);
+    void delete_chunks(const Table &table, Keys::const_iterator &k,
+            size_t chunk_count, size_t chunk_size);
 };
 
 class YBORM_DECL EngineCloned: public EngineBase
@@ -78,18 +263,29 @@ class YBORM_DECL EngineCloned: public EngineBase
     SqlDialect *dialect_;
     ILogger *logger_;
     SqlPool *pool_;
+    IdAllocator *id_allocator_;
+    EntityCache *entity_cache_;
+    QueryCache *query_cache_;
 public:
     EngineCloned(int mode, SqlConnection *conn,
             SqlDialect *dialect, ILogger *logger,
-            SqlPool *pool = NULL)
+            SqlPool *pool = NULL, IdAllocator *id_allocator = NULL,
+            EntityCache *entity_cache = NULL,
+            QueryCache *query_cache = NULL)
         : mode_(mode)
         , conn_(conn)
         , dialect_(dialect)
         , logger_(logger)
         , pool_(pool)
+        , id_allocator_(id_allocator)
+        , entity_cache_(entity_cache)
+        , query_cache_(query_cache)
     {}
     ~EngineCloned();
     int get_mode();
+    IdAllocator *id_allocator();
+    EntityCache *entity_cache();
+    QueryCache *query_cache();
     SqlConnection *get_conn();
     bool reconnect();
     SqlDialect *get_dialect();
@@ -122,6 +318,15 @@ public:
     ~Engine();
 
     int get_mode();
+    IdAllocator *id_allocator();
+    // ids allocator shared with all the clones of this engine
+    void set_id_allocator(std::auto_ptr<IdAllocator> id_allocator);
+    EntityCache *entity_cache();
+    // second-level cache shared with all the clones of this engine
+    void set_entity_cache(std::auto_ptr<EntityCache> entity_cache);
+    QueryCache *query_cache();
+    // query result cache shared with all the clones of this engine
+    void set_query_cache(std::auto_ptr<QueryCache> query_cache);
     SqlConnection *get_conn();
     bool reconnect();
     SqlDialect *get_dialect();
@@ -141,6 +346,9 @@ private:
     std::auto_ptr<SqlConnection> conn_;
     SqlDialect *dialect_;
     SqlConnection *conn_ptr_;
+    std::auto_ptr<IdAllocator> id_allocator_;
+    std::auto_ptr<EntityCache> entity_cache_;
+    std::auto_ptr<QueryCache> query_cache_;
 };
 
 } // namespace Yb
@@ -19,6 +19,8 @@ typedef std::map<String, int> ParamNums;
 enum SqlIdQuotes {NO_QUOTES, DBL_QUOTES, AUTO_DBL_QUOTES};
 enum SqlPagerModel {PAGER_POSTGRES, PAGER_MYSQL,
                     PAGER_INTERBASE, PAGER_ORACLE};
+enum SqlInsertModel {INSERT_SINGLE_ROW, INSERT_VALUES_LIST, INSERT_ALL};
+enum SqlReturningModel {RETURNING_NONE, RETURNING_CLAUSE};
 
 struct SqlGeneratorOptions
 {
@@ -483,6 +485,12 @@ public:
     Expression &expr();
 };
 
+//! Filter matching any of the keys given, all of the same table
+/** Single column keys give an IN list, composite keys are OR-ed
+ * one by one, since not every database supports row values.
+ */
+YBORM_DECL const Expression filter_by_keys(const Keys &keys);
+
 typedef Expression Filter;
 
 class Schema;
@@ -178,6 +178,8 @@ private:
 
 typedef std::vector<Column> Columns;
 typedef std::map<String, int> IndexMap;
+// a flag per column of a table, by the column index
+typedef std::vector<bool> ColumnMask;
 
 class Schema;
 class Relation;
@@ -187,6 +189,8 @@ class YBORM_DECL Table: NonCopyable
     Table();
 public:
     typedef SharedPtr<Table>::Type Ptr;
+    // second-level cache modes, see EntityCache
+    enum { NoCache = 0, ReadOnlyCache, ReadWriteCache };
     Table(const String &name, const String &xml_name = _T(""),
         const String &class_name = _T(""));
     void set_schema(Schema *s) { schema_ = s; }
@@ -199,6 +203,12 @@ public:
     const String &xml_name() const { return xml_name_; }
     const String &class_name() const { return class_name_; }
     const String &seq_name() const { return seq_name_; }
+    int seq_increment() const { return seq_increment_; }
+    //! How many ghost objects to load at once, 1 means one by one
+    int batch_size() const { return batch_size_; }
+    int cache_mode() const { return cache_mode_; }
+    //! Seconds to keep the cached rows for, 0 means no expiry
+    int cache_ttl() const { return cache_ttl_; }
     bool autoinc() const { return autoinc_; }
     const Column &column(size_t idx) const { return cols_[idx]; }
     const Column &column(const String &col_name) const
@@ -225,6 +235,9 @@ public:
     Table &operator << (const Column &c) { add_column(c); return *this; }
     Table &operator << (Column &c) { add_column(c); c.set_table(*this); return *this; }
     void set_seq_name(const String &seq_name);
+    void set_seq_increment(int seq_increment);
+    void set_batch_size(int batch_size);
+    void set_cache(int cache_mode, int cache_ttl = 0);
     void set_autoinc(bool autoinc) { autoinc_ = autoinc; }
     void set_name(const String &name) { name_ = name; }
     void set_xml_name(const String &xml_name) { xml_name_ = xml_name; }
@@ -238,6 +251,9 @@ public:
     const Key mk_key(LongInt id) const;
 private:
     String name_, xml_name_, class_name_, seq_name_;
+    int seq_increment_;
+    int batch_size_;
+    int cache_mode_, cache_ttl_;
     bool autoinc_;
     Columns cols_;
     IndexMap indicies_;
@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <list>
 #include <iterator>
 #include "util/utility.h"
 #include "util/thread.h"
@@ -13,6 +14,7 @@
 #include "util/item_registry.h"
 #include "util/nlogger.h"
 #include "util/value_type.h"
+#include "util/element_tree.h"
 #include "orm_config.h"
 
 namespace Yb {
@@ -97,14 +99,20 @@ public:
             const String &seq_name) = 0;
     virtual const String select_next_value(
             const String &seq_name) = 0;
+    // returns the first id of a block of increment ids
+    virtual const String select_next_block(
+            const String &seq_name, int increment);
     virtual const String select_last_inserted_id(
             const String &table_name);
     virtual const String sql_value(const Value &x) = 0;
     virtual bool fk_internal();
     virtual bool commit_ddl();
     virtual bool has_for_update();
+    // a cheap query to check if a connection is alive
+    virtual const String ping_query();
     virtual const String type2sql(int t) = 0;
-    virtual const String create_sequence(const String &seq_name) = 0;
+    virtual const String create_sequence(const String &seq_name,
+            int increment = 1) = 0;
     virtual const String drop_sequence(const String &seq_name) = 0;
     virtual const String suffix_create_table();
     virtual const String primary_key_flag();
@@ -114,6 +122,14 @@ public:
     virtual const String not_null_default(const String &not_null_clause,
             const String &default_value);
     virtual int pager_model();
+    // multi-row INSERT: syntax and limits on statement size
+    virtual int insert_model();
+    virtual int max_params();
+    virtual int max_insert_rows();
+    // max number of items in an IN (...) list
+    virtual int max_in_list();
+    // how INSERT can return generated ids, see SqlReturningModel
+    virtual int returning_model(SqlConnection &conn);
     virtual const String grant_insert_id_statement(const String &table_name, bool on);
     // schema introspection
     virtual bool table_exists(SqlConnection &conn, const String &table) = 0;
@@ -129,7 +145,110 @@ YBORM_DECL bool register_sql_dialect(std::auto_ptr<SqlDialect> dialect);
 YBORM_DECL const Strings list_sql_dialects();
 
 typedef std::pair<String, Value> RowItem;
-typedef std::vector<RowItem> Row;
+typedef std::vector<RowItem> RowItems;
+
+//! Column names of a result set, shared by all the rows fetched
+/** The descriptor is built once per prepared statement by the cursor
+ * backend, column names are stored in upper case.
+ */
+class YBORM_DECL RowDescr: public RefCountBase
+{
+    Strings names_;
+    std::map<String, int> index_;
+public:
+    typedef IntrusivePtr<RowDescr> Ptr;
+    RowDescr() {}
+    void add_column(const String &name);
+    size_t size() const { return names_.size(); }
+    const String &name(size_t i) const { return names_[i]; }
+    //! Returns the index of a column, or -1 if not found
+    int find(const String &name) const;
+};
+
+template <class Value__>
+struct RowItemRef
+{
+    const String &first;
+    Value__ &second;
+    RowItemRef(const String &name, Value__ &value)
+        : first(name), second(value)
+    {}
+    operator RowItem() const { return RowItem(first, second); }
+    const RowItemRef *operator -> () const { return this; }
+};
+
+//! Compatibility iterator, yields (name, value) pairs over a Row
+template <class Row__, class Value__>
+class RowIterator: public std::iterator<std::bidirectional_iterator_tag,
+        RowItemRef<Value__>, ptrdiff_t,
+        RowItemRef<Value__>, RowItemRef<Value__> >
+{
+    Row__ *row_;
+    size_t pos_;
+public:
+    RowIterator(): row_(NULL), pos_(0) {}
+    RowIterator(Row__ *row, size_t pos): row_(row), pos_(pos) {}
+    template <class R__, class V__>
+    RowIterator(const RowIterator<R__, V__> &other)
+        : row_(other.row()), pos_(other.pos())
+    {}
+    Row__ *row() const { return row_; }
+    size_t pos() const { return pos_; }
+    RowItemRef<Value__> operator * () const {
+        return RowItemRef<Value__>(row_->name(pos_), (*row_)[pos_]);
+    }
+    RowItemRef<Value__> operator -> () const { return **this; }
+    RowIterator &operator ++ () { ++pos_; return *this; }
+    RowIterator operator ++ (int) { RowIterator t(*this); ++pos_; return t; }
+    RowIterator &operator -- () { --pos_; return *this; }
+    RowIterator operator -- (int) { RowIterator t(*this); --pos_; return t; }
+    bool operator == (const RowIterator &o) const {
+        return row_ == o.row_ && pos_ == o.pos_;
+    }
+    bool operator != (const RowIterator &o) const { return !(*this == o); }
+};
+
+//! A fetched row: column values plus a pointer to the shared descriptor
+class YBORM_DECL Row
+{
+    RowDescr::Ptr descr_;
+    Values values_;
+public:
+    typedef RowIterator<Row, Value> iterator;
+    typedef RowIterator<const Row, const Value> const_iterator;
+
+    Row() {}
+    explicit Row(RowDescr::Ptr descr)
+        : descr_(descr)
+        , values_(descr.get()? descr->size(): 0)
+    {}
+    explicit Row(const RowItems &items);
+    const RowDescr::Ptr &descr() const { return descr_; }
+    size_t size() const { return values_.size(); }
+    bool empty() const { return values_.empty(); }
+    Value &operator[] (size_t i) { return values_[i]; }
+    const Value &operator[] (size_t i) const { return values_[i]; }
+    const String &name(size_t i) const { return descr_->name(i); }
+    //! Returns the index of a column, or -1 if not found
+    int find(const String &name) const {
+        return descr_.get()? descr_->find(name): -1;
+    }
+    Values &values() { return values_; }
+    const Values &values() const { return values_; }
+    void swap(Row &other) {
+        std::swap(descr_, other.descr_);
+        values_.swap(other.values_);
+    }
+    //! Convert to the (name, value) pairs layout
+    const RowItems items() const;
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, values_.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, values_.size()); }
+};
+
+inline void swap(Row &a, Row &b) { a.swap(b); }
+
 typedef std::auto_ptr<Row> RowPtr;
 typedef std::vector<Row> Rows;
 typedef std::auto_ptr<Rows> RowsPtr;
@@ -144,9 +263,17 @@ public:
     virtual void prepare(const String &sql) = 0;
     virtual void bind_params(const TypeCodes &types);
     virtual void exec(const Values &params) = 0;
+    // execute a prepared DML statement for each set of parameters
+    virtual void exec_many(const std::vector<Values> &params_set);
     virtual RowPtr fetch_row() = 0;
+    // fill the row in place, the buffers of a row with the same
+    // descriptor may be reused
+    virtual bool fetch_into(Row &row);
+    virtual void reset();
 };
 
+#define YB_STMT_CACHE_SIZE 32
+
 class YBORM_DECL SqlSource: public StringDict
 {
 public:
@@ -163,6 +290,9 @@ public:
     const String &passwd() const { return get(_T("&passwd")); }
     const String &host() const { return get(_T("&host")); }
     int port() const { return get_as<int>(String(_T("&port")), 0); }
+    int stmt_cache_size() const {
+        return get_as<int>(String(_T("stmt_cache_size")), YB_STMT_CACHE_SIZE);
+    }
     const Strings options() const;
     const String format(bool hide_passwd = true) const;
 
@@ -207,19 +337,96 @@ YBORM_DECL SqlDriver *sql_driver(const String &name);
 YBORM_DECL bool register_sql_driver(std::auto_ptr<SqlDriver> driver);
 YBORM_DECL const Strings list_sql_drivers();
 
+enum SqlStatementPhase {
+    STMT_PREPARE = 0, STMT_EXEC, STMT_EXEC_DIRECT, STMT_EXEC_MANY, STMT_FETCH
+};
+
+struct YBORM_DECL SqlStatementEvent
+{
+    int phase;
+    const String &sql;
+    // parameters of EXEC, NULL for the other phases
+    const Values *params;
+    // monotonic time spent in the phase, for STMT_FETCH it's the sum
+    // over all the rows fetched since the last exec
+    MicroSec elapsed;
+    // rows fetched, parameter sets executed with STMT_EXEC_MANY, or -1
+    LongInt rows;
+    bool failed;
+
+    SqlStatementEvent(int a_phase, const String &a_sql,
+            const Values *a_params, MicroSec a_elapsed,
+            LongInt a_rows, bool a_failed)
+        : phase(a_phase), sql(a_sql), params(a_params)
+        , elapsed(a_elapsed), rows(a_rows), failed(a_failed)
+    {}
+    static const char *phase_name(int phase);
+};
+
+// Receives timings of the statements run on a connection, may be shared
+// by several connections, so it should be thread safe.
+// Exceptions thrown by an observer are ignored.
+class YBORM_DECL SqlStatementObserver
+{
+public:
+    virtual ~SqlStatementObserver();
+    virtual void on_statement(SqlConnection &conn,
+            const SqlStatementEvent &event) = 0;
+};
+
+// Logs statements slower than the threshold at WARNING level,
+// and if sample_every > 0 also every n-th statement at INFO level.
+class YBORM_DECL SlowQueryLog: public SqlStatementObserver, NonCopyable
+{
+    ILogger::Ptr log_;
+    MicroSec threshold_;
+    int sample_every_;
+    Mutex mux_;
+    LongInt seen_, slow_;
+public:
+    SlowQueryLog(ILogger *parent, MilliSec threshold, int sample_every = 0);
+    void on_statement(SqlConnection &conn, const SqlStatementEvent &event);
+    LongInt slow_count();
+};
+
 class YBORM_DECL SqlResultSet: public ResultSetBase<Row>
 {
     friend class SqlCursor;
-    SqlCursor &cursor_;
+    SqlCursor *cursor_;
     mutable std::auto_ptr<SqlCursor> owned_cursor_;
+    // rows fetched in advance, if not reading from a cursor
+    mutable RowsPtr rows_;
+    size_t pos_;
     bool fetch(Row &row);
-    SqlResultSet(SqlCursor &cursor): cursor_(cursor) {}
+    bool recycle_;
+    SqlResultSet(SqlCursor &cursor)
+        : cursor_(&cursor), pos_(0), recycle_(false) {}
 public:
+    //! A result set over the rows given, e.g. taken from QueryCache
+    explicit SqlResultSet(RowsPtr rows)
+        : cursor_(NULL), rows_(rows), pos_(0), recycle_(false) {}
+    //! The rows given followed by the rows not yet read from rest,
+    //! which gives up its cursor
+    SqlResultSet(RowsPtr rows, const SqlResultSet &rest)
+        : cursor_(rest.cursor_)
+        , owned_cursor_(rest.owned_cursor_.release())
+        , rows_(rows)
+        , pos_(0)
+        , recycle_(rest.recycle_)
+    {
+        YB_ASSERT(!rest.rows_.get());
+    }
     SqlResultSet(const SqlResultSet &rs)
         : cursor_(rs.cursor_)
         , owned_cursor_(rs.owned_cursor_.release())
+        , rows_(rs.rows_.release())
+        , pos_(rs.pos_)
+        , recycle_(rs.recycle_)
     {}
-    void own(std::auto_ptr<SqlCursor> cursor);
+    ~SqlResultSet();
+    // if recycle is set the cursor is given back to the connection's
+    // statement cache when the result set is destroyed
+    void own(std::auto_ptr<SqlCursor> cursor, bool recycle = false);
 };
 
 class YBORM_DECL SqlCursor: NonCopyable
@@ -227,21 +434,56 @@ class YBORM_DECL SqlCursor: NonCopyable
     friend class SqlConnection;
     SqlConnection &connection_;
     std::auto_ptr<SqlCursorBackend> backend_;
-    bool echo_, conv_params_;
+    bool echo_, conv_params_, bound_;
     ILogger *log_;
+    String sql_;
+    TypeCodes bound_types_;
+    // fetch timings accumulated for the statement observer
+    MicroSec fetch_time_;
+    LongInt fetched_rows_;
+    bool fetch_pending_;
+    void notify(SqlStatementObserver *observer, int phase,
+            const String &sql, const Values *params, MicroSec t0,
+            LongInt rows, bool failed);
+    void flush_fetch_stats();
     void debug(const String &s, int level = ll_DEBUG)
     {
         if (log_)
             log_->log(level, NARROW(s));
     }
+    // skip formatting of the messages which would be filtered out
+    bool echo_on(int level) const
+    {
+        return echo_ && log_ && log_->enabled(level);
+    }
     SqlCursor(SqlConnection &connection);
 public:
+    ~SqlCursor();
+    SqlConnection &get_connection() const { return connection_; }
+    const String &get_sql() const { return sql_; }
     void exec_direct(const String &sql);
     void prepare(const String &sql);
     void bind_params(const TypeCodes &types);
     SqlResultSet exec(const Values &params);
+    void exec_many(const std::vector<Values> &params_set);
     RowPtr fetch_row();
+    bool fetch_into(Row &row);
     RowsPtr fetch_rows(int max_rows = -1); // -1 = all
+    void reset();
+};
+
+struct YBORM_DECL StmtCacheStats
+{
+    int hits, misses, evictions;
+    StmtCacheStats(): hits(0), misses(0), evictions(0) {}
+};
+
+struct YBORM_DECL SqlConnectionStats
+{
+    time_t opened_at;
+    // errors reported through mark_bad(), checkouts from a pool
+    int bad_marks, checkouts;
+    SqlConnectionStats(): opened_at(0), bad_marks(0), checkouts(0) {}
 };
 
 class YBORM_DECL SqlConnection: NonCopyable
@@ -254,9 +496,20 @@ class YBORM_DECL SqlConnection: NonCopyable
     std::auto_ptr<SqlConnectionBackend> backend_;
     std::auto_ptr<SqlCursor> cursor_;
     bool activity_, echo_, conv_params_, bad_, explicit_trans_started_;
-    time_t free_since_;
+    time_t free_since_, checked_at_;
+    MilliSec checked_out_at_;
     ILogger::Ptr log_;
+    // prepared statements cache, the most recently used go first
+    typedef std::list<SqlCursor *> StmtCacheList;
+    typedef std::map<String, StmtCacheList::iterator> StmtCacheIndex;
+    StmtCacheList stmt_lru_;
+    StmtCacheIndex stmt_index_;
+    int stmt_cache_size_;
+    StmtCacheStats stmt_stats_;
+    SqlConnectionStats stats_;
+    SqlStatementObserver *observer_;
     void mark_bad(const std::exception &e);
+    void shrink_stmt_cache(int max_size);
 public:
     SqlConnection(const String &driver_name,
             const String &dialect_name, const String &db,
@@ -272,13 +525,31 @@ public:
     const String &get_db() const { return source_.db(); }
     const String &get_user() const { return source_.user(); }
     void set_echo(bool echo) { echo_ = echo; }
-    void set_convert_params(bool conv_params) { conv_params_ = conv_params; }
+    void set_convert_params(bool conv_params) {
+        if (conv_params != conv_params_)
+            clear_stmt_cache();
+        conv_params_ = conv_params;
+    }
     void init_logger(ILogger *parent) {
         log_.reset(NULL);
         if (parent)
             log_.reset(parent->new_logger("sql").release());
     }
     std::auto_ptr<SqlCursor> new_cursor();
+    // take a cursor with the statement prepared, either from the cache
+    // or a brand new one; give it back with put_prepared_cursor()
+    std::auto_ptr<SqlCursor> get_prepared_cursor(const String &sql);
+    void put_prepared_cursor(std::auto_ptr<SqlCursor> cursor);
+    void clear_stmt_cache();
+    int get_stmt_cache_size() const { return stmt_cache_size_; }
+    void set_stmt_cache_size(int stmt_cache_size);
+    const StmtCacheStats &get_stmt_cache_stats() const { return stmt_stats_; }
+    const SqlConnectionStats &get_stats() const { return stats_; }
+    // the observer is not owned by the connection, NULL to remove
+    void set_observer(SqlStatementObserver *observer) { observer_ = observer; }
+    SqlStatementObserver *get_observer() const { return observer_; }
+    ElementTree::ElementPtr stats_to_json(
+            const String &name = _T("connection")) const;
     void debug(const String &s, int level = ll_DEBUG)
     {
         if (log_.get())
@@ -293,6 +564,8 @@ public:
     void commit();
     void rollback();
     void clear();
+    // run the dialect's validation query, false if the connection is broken
+    bool ping();
     void exec_direct(const String &sql);
     void prepare(const String &sql);
     SqlResultSet exec(const Values &params);
@@ -3,8 +3,10 @@
 #define YB__ORM__SQL_POOL__INCLUDED
 
 #include <map>
+#include <set>
 #include <deque>
 #include "util/thread.h"
+#include "util/element_tree.h"
 #include "orm_config.h"
 #include "sql_driver.h"
 
@@ -14,6 +16,12 @@ namespace Yb {
 #define YB_POOL_IDLE_TIME 30 // sec.
 #define YB_POOL_MONITOR_SLEEP 2 // sec.
 #define YB_POOL_WAIT_TIME 20 // sec.
+#define YB_POOL_MIN_IDLE 0
+#define YB_POOL_VALIDATE_TIME 10 // sec.
+#define YB_POOL_OPEN_PARALLELISM 4
+#define YB_POOL_REPLICA_RETRY 10 // sec.
+
+#define YB_POOL_WAIT_BUCKETS 6
 
 class SqlPool;
 
@@ -23,6 +31,29 @@ public:
     PoolError(const String &err);
 };
 
+// A snapshot of a source's metrics, times are in milliseconds
+struct YBORM_DECL SqlPoolStats
+{
+    // gauges
+    int in_use, idle, opening, waiting, max_size;
+    // the longest time one of the connections in use is held,
+    // constantly growing values are likely to be leaks
+    MilliSec longest_hold;
+    // counters
+    LongInt checkouts, timeouts, opened, open_errors, closed,
+            reconnects, bad_closed, bad_marks;
+    // checkout wait time histogram, the bucket i counts the waits
+    // shorter than wait_bucket_bound(i), the last one counts the rest
+    LongInt wait_hist[YB_POOL_WAIT_BUCKETS];
+    MilliSec wait_total, wait_max, hold_total, hold_max;
+
+    SqlPoolStats();
+    static MilliSec wait_bucket_bound(int i);
+    void add_wait(MilliSec wait);
+    void add_hold(MilliSec hold);
+    ElementTree::ElementPtr to_json(const String &name = _T("pool")) const;
+};
+
 class YBORM_DECL PoolMonThread: public Thread
 {
     SqlPool *pool_;
@@ -36,33 +67,103 @@ class YBORM_DECL SqlPool: NonCopyable
     friend class PoolMonThread;
 public:
     typedef SqlConnection *SqlConnectionPtr;
+    // how read connections are spread over replicas, see "pool_balancing"
+    enum Balancing { ROUND_ROBIN = 0, LEAST_IN_USE = 1 };
     SqlPool(int pool_max_size = YB_POOL_MAX_SIZE,
             int idle_time = YB_POOL_IDLE_TIME,
             int monitor_sleep = YB_POOL_MONITOR_SLEEP,
             ILogger *logger = NULL,
-            bool interlocked_open = true);
+            bool interlocked_open = true,
+            int open_parallelism = YB_POOL_OPEN_PARALLELISM);
     ~SqlPool();
     void add_source(const SqlSource &source);
+    // register a read-only copy of the primary source, the replica
+    // is a source of its own as well
+    void add_replica(const String &primary_id, const SqlSource &replica);
+    // Wait no more than timeout seconds for a connection to become
+    // available when the source has reached its maximum size,
+    // waiting clients are served in the order of arrival.
     SqlConnectionPtr get(const String &id, int timeout = YB_POOL_WAIT_TIME);
+    // get a connection to one of the primary's replicas that has
+    // an idle connection or room for a new one, falling back
+    // to waiting up to timeout seconds for the primary
+    SqlConnectionPtr get_for_read(const String &primary_id,
+            int timeout = YB_POOL_WAIT_TIME);
     void put(SqlConnectionPtr handle, bool close_now = false);
     bool reconnect(SqlConnectionPtr &conn);
+    // the metrics are updated while the pool is locked anyway,
+    // reading them takes a short lock to copy
+    const SqlPoolStats get_pool_stats(const String &source_id);
+    const Strings get_source_ids();
+    // installed on every connection opened after the call, not owned
+    void set_statement_observer(SqlStatementObserver *observer);
+    // all sources' metrics as a dict keyed by source ID
+    ElementTree::ElementPtr stats_to_json(const String &name = _T("pools"));
 
 private:
-    std::map<String, SqlSource> sources_;
-    std::map<String, int> counts_;
     typedef std::deque<SqlConnectionPtr> Pool;
-    std::map<String, Pool> pools_;
+    struct Waiter
+    {
+        Condition cond_;
+        SqlConnectionPtr handle_;
+        bool may_open_;
+        Waiter(Mutex &mux): cond_(mux), handle_(NULL), may_open_(false) {}
+    };
+    typedef std::deque<Waiter *> Waiters;
+    struct SourceState
+    {
+        SqlSource source_;
+        Pool pool_;
+        Waiters waiters_;
+        // the number of connections checked out and being opened
+        int in_use_, opening_;
+        // max_size_ <= 0 means no limit
+        int max_size_, min_idle_;
+        // check idle connections not used for so many seconds, 0 = never
+        int validate_time_;
+        // replicas of a primary source
+        Strings replicas_;
+        int balancing_;
+        size_t next_replica_;
+        // a replica that failed to open a connection is skipped for a while
+        time_t down_until_;
+        std::set<SqlConnectionPtr> checked_out_;
+        SqlPoolStats stats_;
+        SourceState(): in_use_(0), opening_(0), max_size_(0), min_idle_(0),
+            validate_time_(0), balancing_(ROUND_ROBIN), next_replica_(0),
+            down_until_(0) {}
+        bool has_room() const {
+            return max_size_ <= 0 ||
+                in_use_ + opening_ + (int)pool_.size() < max_size_;
+        }
+    };
+    std::map<String, SourceState> sources_;
     Mutex pool_mux_, stop_mux_, open_mux_;
-    Condition stop_cond_;
+    Condition stop_cond_, open_cond_;
     int pool_max_size_, idle_time_, monitor_sleep_;
+    // if interlocked_open_ is set no more than open_parallelism_
+    // connections are being opened at the same time
+    int open_parallelism_, opening_now_;
     bool stop_monitor_flag_, interlocked_open_;
     PoolMonThread monitor_;
     ILogger::Ptr logger_;
+    SqlStatementObserver *observer_;
 
     void *monitor_thread();
+    void close_idle();
+    void validate_idle();
+    void fill_idle(const String &source_id);
     void close_all();
     void stop_monitor_thread();
     bool sleep_not_stop();
+    SourceState &find_source(const String &source_id);
+    void serve_waiters(SourceState &st);
+    const Strings pick_replicas(const String &primary_id);
+    void checkout(SourceState &st, SqlConnectionPtr handle);
+    void checkin(SourceState &st, SqlConnectionPtr handle,
+            MilliSec checked_out_at);
+    void count_closed(SourceState &st, int bad_marks, bool bad);
+    SqlConnectionPtr open_connection(const SqlSource &source);
     const String get_stats(const String &source_id);
 };
 
@@ -28,10 +28,13 @@ public:
 };
 
 typedef LongInt MilliSec;
+typedef LongInt MicroSec;
 
 YBUTIL_DECL unsigned long get_process_id();
 YBUTIL_DECL unsigned long get_thread_id();
 YBUTIL_DECL MilliSec get_cur_time_millisec();
+// for measuring intervals, not affected by system time changes
+YBUTIL_DECL MicroSec get_monotonic_microsec();
 YBUTIL_DECL struct tm *localtime_safe(const time_t *clock, struct tm *result);
 
 
@@ -57,7 +60,9 @@ class YBUTIL_DECL LogRecord
 
     static int check_level(int level);
 public:
+    LogRecord();
     LogRecord(int level, const std::string &component, const std::string &msg);
+    void swap(LogRecord &other);
 
     MilliSec get_t() const { return t_; }
     time_t get_sec() const { return t_ / 1000; }
@@ -76,6 +81,9 @@ public:
     virtual void append(const LogRecord &rec) = 0;
     virtual int get_level(const std::string &name) = 0;
     virtual void set_level(const std::string &name, int level) = 0;
+    // incremented on every change of the levels, this lets loggers
+    // cache their level; -1 means levels can't be cached
+    virtual int get_levels_version();
     virtual ~ILogAppender();
 };
 
@@ -89,6 +97,8 @@ public:
     virtual void set_level(int level) = 0;
     virtual void log(int level, const std::string &msg) = 0;
     virtual const std::string get_name() const = 0;
+    // check this before formatting expensive messages
+    virtual bool enabled(int level);
     virtual ~ILogger();
     void trace    (const std::string &msg) { log(ll_TRACE,    msg); }
     void debug    (const std::string &msg) { log(ll_DEBUG,    msg); }
@@ -102,6 +112,8 @@ class YBUTIL_DECL Logger: public ILogger
 {
     ILogAppender *appender_;
     const std::string name_;
+    // levels version * 16 + level, a single word to be read without lock
+    volatile int cached_level_;
 public:
     Logger(ILogAppender *appender, const std::string &name = "");
     ILogger::Ptr new_logger(const std::string &name);
@@ -110,6 +122,7 @@ public:
     void set_level(int level);
     void log(int level, const std::string &msg);
     const std::string get_name() const;
+    bool enabled(int level);
     static bool valid_name(const std::string &name, bool allow_dots=false);
 };
 
@@ -123,6 +136,7 @@ class YBUTIL_DECL LogAppender: public ILogAppender
     const int flush_interval_;
     typedef std::map<std::string, int> LogLevelMap;
     LogLevelMap log_levels_;
+    volatile int levels_version_;
 
     static void output(std::ostream &s, const LogRecord &rec, const char *time_str);
     void do_flush(time_t now);
@@ -133,9 +147,50 @@ public:
     void append(const LogRecord &rec);
     int get_level(const std::string &name);
     void set_level(const std::string &name, int level);
+    int get_levels_version();
     void flush();
 };
 
+#define YB_ASYNC_LOG_CAPACITY 4096
+
+class AsyncLogAppender;
+
+class YBUTIL_DECL AsyncLogWriter: public Thread
+{
+    AsyncLogAppender *appender_;
+public:
+    AsyncLogWriter(AsyncLogAppender *appender);
+    void on_run();
+};
+
+// Callers only put records into a bounded ring buffer, formatting and
+// output is done by a background thread.  When the buffer is full
+// records are either dropped or the caller waits for free space.
+class YBUTIL_DECL AsyncLogAppender: public LogAppender
+{
+    friend class AsyncLogWriter;
+public:
+    enum Overflow { DROP = 0, BLOCK = 1 };
+    AsyncLogAppender(std::ostream &s,
+            size_t capacity = YB_ASYNC_LOG_CAPACITY, int overflow = DROP);
+    ~AsyncLogAppender();
+    void append(const LogRecord &rec);
+    // wait until all the records appended so far are written
+    void flush();
+    LongInt get_dropped();
+private:
+    std::vector<LogRecord> ring_;
+    size_t head_, count_;
+    int overflow_;
+    bool stop_;
+    LongInt appended_, written_, dropped_;
+    Mutex ring_mux_;
+    Condition not_empty_, not_full_, written_cond_;
+    AsyncLogWriter writer_;
+
+    void writer_thread();
+};
+
 } // end of namespace Yb
 
 // vim:ts=4:sts=4:sw=4:et:
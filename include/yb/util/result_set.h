@@ -3,6 +3,7 @@
 #define YB__UTIL__RESULT_SET__INCLUDED
 
 #include <deque>
+#include <vector>
 #include <iterator>
 #include <algorithm>
 #include <cstddef>
@@ -13,43 +14,44 @@ namespace Yb {
 template <class RowType>
 class ResultSetBase
 {
-    std::deque<RowType> rows_;
-    bool finish_;
-
+    // Two row buffers are reused while iterating: the current row
+    // and the previous one, which is returned by the postfix ++.
+    std::vector<RowType> rows_;
+    int cur_;
+    bool ready_, finish_;
+
+    // fills the row in place, overwriting what was left from
+    // the row fetched two steps before
     virtual bool fetch(RowType &row) = 0;
 
-    bool ready() const { return rows_.size() > 1; }
+    bool ready() const { return ready_; }
     RowType &get_current_row() {
         YB_ASSERT(ready());
-        return rows_[1];
+        return rows_[cur_];
     }
     RowType &get_previous_row() {
         YB_ASSERT(!rows_.empty());
-        return rows_[0];
+        return rows_[cur_ ^ 1];
     }
     void step_forward() {
-        YB_ASSERT(!rows_.empty());
-        rows_.pop_front();
+        YB_ASSERT(ready());
+        ready_ = false;
+        cur_ ^= 1;
     }
     bool fetch_next() {
         if (finish_)
             return false;
-        RowType row;
-        finish_ = !fetch(row);
-        if (!finish_) {
-            if (rows_.empty()) {
-                RowType row0;
-                rows_.push_back(row0);
-            }
-            rows_.push_back(row);
-        }
-        return !finish_;
+        if (rows_.empty())
+            rows_.resize(2);
+        finish_ = !fetch(rows_[cur_]);
+        ready_ = !finish_;
+        return ready_;
     }
 public:
     class iterator;
     friend class iterator;
 
-    ResultSetBase(): finish_(false) {}
+    ResultSetBase(): cur_(0), ready_(false), finish_(false) {}
     virtual ~ResultSetBase() {}
 
     class iterator: public std::iterator<std::input_iterator_tag,
@@ -134,6 +136,32 @@ inline OutputIterator
     return result;
 }
 
+//! Take no more than n rows (all if n < 0) from a result set
+/** Unlike copy_no_more_than_n() the rows are swapped out of the result
+ * set's buffers, RowType must have a swap() found by the argument
+ * dependent lookup, or else std::swap() is used.
+ */
+template<class RowType, class Size>
+inline void
+    swap_no_more_than_n(ResultSetBase<RowType> &rs, Size n,
+                        std::vector<RowType> &out)
+{
+    using std::swap;
+    // deque never relocates the rows already taken
+    std::deque<RowType> taken;
+    typename ResultSetBase<RowType>::iterator
+        first = rs.begin(), last = rs.end();
+    for (Size count = 0; first != last &&
+             (n < 0? true: count < n); ++first, ++count) {
+        taken.push_back(RowType());
+        swap(taken.back(), *first);
+    }
+    size_t base = out.size();
+    out.resize(base + taken.size());
+    for (size_t i = 0; i < taken.size(); ++i)
+        swap(out[base + i], taken[i]);
+}
+
 } // namespace Yb
 
 // vim:ts=4:sts=4:sw=4:et:
@@ -38,9 +38,16 @@ template <class T__> struct ValueTraits {};
 #define YB_MAX(x, y) ((x) > (y)? (x): (y))
 #define YB_NULL ::Yb::Value()
 
+//! Size of the in-place storage for any payload of a Value object
+#define YB_VALUE_BUF_SIZE YB_MAX(YB_MAX(sizeof(::Yb::String), \
+            sizeof(::Yb::Blob)), YB_MAX(YB_MAX(sizeof(::Yb::Decimal), \
+            sizeof(::Yb::DateTime)), sizeof(::Yb::LongInt)))
+
 //! Variant data type for communication to the database layer
-/** Value class objects can hold NULL values.  Copying such objects
- * is cheap because of shared pointer.
+/** Value class objects can hold NULL values.
+ * The payload is always constructed in place, so copying a Value
+ * of a numeric, decimal or date-time type never touches the heap,
+ * and a short string costs no more than the string copy itself.
  * Value class also supports casting to several strict types.
  *
  * @remark Value class should not be implemented upon boost::any because of massive
@@ -48,7 +55,7 @@ template <class T__> struct ValueTraits {};
  */
 class YBUTIL_DECL Value
 {
-    void init();
+    void init(const Value &other);
     void destroy();
     void assign(const Value &other);
 
@@ -102,7 +109,12 @@ public:
 
 private:
     int type_;
-    LongInt data_;
+    union {
+        LongInt l_;
+        double d_;
+        void *p_;
+        char buf_[YB_VALUE_BUF_SIZE];
+    } data_;
 };
 
 template <> struct ValueTraits<int> {
@@ -219,6 +231,8 @@ struct Key {
 typedef std::vector<Key> Keys;
 
 YBUTIL_DECL int key_cmp(const Key &x, const Key &y);
+//! Hash function that agrees with key_cmp() on equal keys
+YBUTIL_DECL size_t key_hash(const Key &key);
 inline bool operator == (const Key &x, const Key &y) { return !key_cmp(x, y); }
 inline bool operator != (const Key &x, const Key &y) { return !(x == y); }
 inline bool operator < (const Key &x, const Key &y) { return key_cmp(x, y) < 0; }
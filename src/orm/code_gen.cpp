@@ -338,7 +338,8 @@ SqlSchemaGenerator::SqlSchemaGenerator(
             end = schema_.tbl_end();
         for (; it != end; ++it)
             if (!str_empty(it->second->seq_name()))
-                sequences_.insert(it->second->seq_name());
+                sequences_[it->second->seq_name()] =
+                    it->second->seq_increment();
     }
     seq_it_ = sequences_.begin();
 }
@@ -415,7 +416,8 @@ bool SqlSchemaGenerator::generate_next_statement(String &out_str)
         }
     }
     if (seq_it_ != sequences_.end()) {
-        out_str = dialect_->create_sequence(*seq_it_);
+        out_str = dialect_->create_sequence(seq_it_->first,
+                seq_it_->second);
         ++seq_it_;
         need_commit_ = true;
         return true;
@@ -691,6 +693,13 @@ void CppCodeGenerator::write_cpp_create_table_meta(ostream &out)
         << "\"), _T(\"" << xml_name << "\"), _T(\"" << class_name_ << "\")));\n";
     if (!str_empty(table_.seq_name()))
         out << "\tt->set_seq_name(_T(\"" << NARROW(table_.seq_name()) << "\"));\n";
+    if (table_.seq_increment() != 1)
+        out << "\tt->set_seq_increment(" << table_.seq_increment() << ");\n";
+    if (table_.batch_size() != 1)
+        out << "\tt->set_batch_size(" << table_.batch_size() << ");\n";
+    if (table_.cache_mode() != Table::NoCache)
+        out << "\tt->set_cache(" << table_.cache_mode() << ", "
+            << table_.cache_ttl() << ");\n";
     out << "\tc.fill_table(*t);\n"
         << "\ttbls.push_back(t);\n"
         << "}\n";
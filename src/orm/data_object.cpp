@@ -60,32 +60,106 @@ DataObjectAlreadyInSession::DataObjectAlreadyInSession(
                   "in the identity map: ") + key2str(key))
 {}
 
-bool DataObjectResultSet::fetch(DataObjectList &row)
+ReadOnlyCachedTable::ReadOnlyCachedTable(const String &table_name)
+    : ORMError(_T("Can't change rows of table cached read-only: ")
+               + table_name)
+{}
+
+PrefetchRelationNotFound::PrefetchRelationNotFound(
+        const String &relation_name)
+    : ORMError(_T("No one-to-many relation to prefetch: ") + relation_name)
+{}
+
+bool DataObjectResultSet::fetch_row(DataObjectList &row)
 {
     if (!it_.get())
         it_.reset(new SqlResultSet::iterator(rs_.begin()));
     if (rs_.end() == *it_)
         return false;
-    DataObjectList new_row;
     Row &cur = **it_;
     size_t pos = 0;
+    if (untracked_) {
+        // the row holds the objects fetched two steps before
+        row.resize(tables_.size());
+        for (size_t i = 0; i < tables_.size(); ++i) {
+            if (!row[i].get() || &row[i]->table() != tables_[i] ||
+                    !row[i]->recyclable())
+                row[i] = DataObject::create_new(
+                        *tables_[i], DataObject::Sync);
+            pos = row[i]->fill_from_row(cur, pos);
+        }
+        ++*it_;
+        return true;
+    }
+    // the row keeps its capacity from the previous use
+    row.clear();
     for (size_t i = 0; i < tables_.size(); ++i) {
         DataObject::Ptr d = DataObject::create_new
             (*tables_[i], DataObject::Sync);
         pos = d->fill_from_row(cur, pos);
-        DataObject::Ptr e = session_.save_or_update(d);
-        new_row.push_back(e);
+        row.push_back(session_.save_or_update(d));
     }
-    row.swap(new_row);
     ++*it_;
 
     return true;
 }
 
+void DataObjectResultSet::fetch_all_and_prefetch()
+{
+    // the relations to prefetch with the position of their master table
+    std::vector<std::pair<const Relation *, size_t> > rels;
+    Strings::const_iterator i = prefetch_.begin(), iend = prefetch_.end();
+    for (; i != iend; ++i) {
+        size_t found = rels.size();
+        for (size_t j = 0; j < tables_.size(); ++j) {
+            const Table &tbl = *tables_[j];
+            const Relation *rel = session_.schema().find_relation(
+                    tbl.class_name(), *i, _T(""), 0);
+            if (rel && rel->side(0) == tbl.class_name())
+                rels.push_back(std::make_pair(rel, j));
+        }
+        if (rels.size() == found)
+            throw PrefetchRelationNotFound(*i);
+    }
+    DataObjectList row;
+    while (fetch_row(row))
+        rows_.push_back(row);
+    for (size_t j = 0; j < rels.size(); ++j) {
+        DataObjectList masters;
+        masters.reserve(rows_.size());
+        for (size_t k = 0; k < rows_.size(); ++k)
+            masters.push_back(rows_[k][rels[j].second]);
+        session_.prefetch_slaves(masters, *rels[j].first);
+    }
+    prefetched_ = true;
+}
+
+bool DataObjectResultSet::fetch(DataObjectList &row)
+{
+    if (prefetch_.empty())
+        return fetch_row(row);
+    if (!prefetched_)
+        fetch_all_and_prefetch();
+    if (pos_ == rows_.size())
+        return false;
+    row.swap(rows_[pos_++]);
+    return true;
+}
+
+void DataObjectResultSet::prefetch(const String &relation_name)
+{
+    YB_ASSERT(!it_.get());
+    YB_ASSERT(!untracked_);
+    prefetch_.push_back(relation_name);
+}
+
 DataObjectResultSet::DataObjectResultSet(const SqlResultSet &rs, Session &session,
-                                         const Strings &tables)
+                                         const Strings &tables, bool untracked)
     : rs_(rs)
     , session_(session)
+    , pos_(0)
+    , prefetched_(false)
+    , untracked_(untracked)
 {
     const Schema &schema = session.schema();
     Strings::const_iterator i = tables.begin(), iend = tables.end();
@@ -97,10 +171,153 @@ DataObjectResultSet::DataObjectResultSet(const DataObjectResultSet &obj)
     : rs_(obj.rs_)
     , tables_(obj.tables_)
     , session_(obj.session_)
+    , prefetch_(obj.prefetch_)
+    , pos_(0)
+    , prefetched_(false)
+    , untracked_(obj.untracked_)
 {
     YB_ASSERT(!obj.it_.get());
 }
 
+size_t IdentityMap::lookup(const Key &key, size_t hash) const
+{
+    size_t mask = slots_.size() - 1, i = hash & mask;
+    while (slots_[i].obj &&
+            (slots_[i].hash != hash || key_cmp(slots_[i].key, key)))
+        i = (i + 1) & mask;
+    return i;
+}
+
+void IdentityMap::grow()
+{
+    Slots old_slots(slots_.size()? 2 * slots_.size(): 16);
+    slots_.swap(old_slots);
+    size_t mask = slots_.size() - 1;
+    Slots::iterator j = old_slots.begin(), jend = old_slots.end();
+    for (; j != jend; ++j)
+        if (j->obj) {
+            size_t i = j->hash & mask;
+            while (slots_[i].obj)
+                i = (i + 1) & mask;
+            Slot &slot = slots_[i];
+            slot.key.swap(j->key);
+            slot.hash = j->hash;
+            slot.obj = j->obj;
+        }
+}
+
+DataObject *IdentityMap::find(const Key &key) const
+{
+    if (!size_)
+        return NULL;
+    return slots_[lookup(key, key_hash(key))].obj;
+}
+
+DataObject *IdentityMap::insert(const Key &key, DataObject *obj)
+{
+    YB_ASSERT(obj != NULL);
+    size_t hash = key_hash(key);
+    if (size_) {
+        DataObject *found = slots_[lookup(key, hash)].obj;
+        if (found)
+            return found;
+    }
+    // keep the load factor under 3/4
+    if (4 * (size_ + 1) > 3 * slots_.size())
+        grow();
+    Slot &slot = slots_[lookup(key, hash)];
+    slot.key = key;
+    slot.hash = hash;
+    slot.obj = obj;
+    ++size_;
+    return NULL;
+}
+
+bool IdentityMap::erase(const Key &key)
+{
+    if (!size_)
+        return false;
+    size_t mask = slots_.size() - 1, i = lookup(key, key_hash(key));
+    if (!slots_[i].obj)
+        return false;
+    // shift back the following slots of the cluster, which would
+    // become unreachable otherwise, so no tombstones are needed
+    for (size_t j = (i + 1) & mask; slots_[j].obj; j = (j + 1) & mask) {
+        size_t home = slots_[j].hash & mask;
+        if (i <= j? (home <= i || home > j): (home <= i && home > j)) {
+            Slot &slot = slots_[i];
+            slot.key.swap(slots_[j].key);
+            slot.hash = slots_[j].hash;
+            slot.obj = slots_[j].obj;
+            i = j;
+        }
+    }
+    Slot empty_slot;
+    slots_[i].key.swap(empty_slot.key);
+    slots_[i].hash = 0;
+    slots_[i].obj = NULL;
+    --size_;
+    return true;
+}
+
+void IdentityMap::clear()
+{
+    IdentityMap empty_map;
+    swap(empty_map);
+}
+
+void IdentityMap::swap(IdentityMap &other)
+{
+    slots_.swap(other.slots_);
+    std::swap(size_, other.size_);
+}
+
+void WorkList::push(DataObject *obj)
+{
+    YB_ASSERT(!obj->work_prev_ && !obj->work_next_ && head_ != obj);
+    obj->work_prev_ = tail_;
+    if (tail_)
+        tail_->work_next_ = obj;
+    else
+        head_ = obj;
+    tail_ = obj;
+    ++size_;
+}
+
+void WorkList::remove(DataObject *obj)
+{
+    if (!obj->work_prev_ && head_ != obj)
+        return;
+    if (obj->work_prev_)
+        obj->work_prev_->work_next_ = obj->work_next_;
+    else
+        head_ = obj->work_next_;
+    if (obj->work_next_)
+        obj->work_next_->work_prev_ = obj->work_prev_;
+    else
+        tail_ = obj->work_prev_;
+    obj->work_prev_ = obj->work_next_ = NULL;
+    --size_;
+}
+
+void WorkList::clear()
+{
+    while (head_) {
+        DataObject *obj = head_;
+        head_ = obj->work_next_;
+        obj->work_prev_ = obj->work_next_ = NULL;
+    }
+    tail_ = NULL;
+    size_ = 0;
+}
+
+void WorkList::copy_to(std::vector<DataObject *> &out) const
+{
+    out.reserve(out.size() + size_);
+    for (DataObject *obj = head_; obj; obj = obj->work_next_)
+        out.push_back(obj);
+}
+
 void Session::clone_engine(EngineSource *src_engine)
 {
     if (src_engine) {
@@ -165,8 +382,9 @@ void Session::clear()
         (*i)->forget_session();
     Objects empty_objects;
     objects_.swap(empty_objects);
-    IdentityMap empty_map;
-    identity_map_.swap(empty_map);
+    identity_map_.clear();
+    clear_work_lists();
+    changed_cached_tables_.clear();
     if (engine_.get())
         engine_->rollback();
 }
@@ -174,18 +392,110 @@ void Session::clear()
 DataObject *Session::add_to_identity_map(DataObject *obj, bool return_found)
 {
     if (obj->assigned_key()) {
-        const Key &key = obj->key();
-        IdentityMap::iterator i = identity_map_.find(key);
-        if (i != identity_map_.end()) {
+        DataObject *found = identity_map_.insert(obj->key(), obj);
+        if (found) {
             if (return_found)
-                return i->second;
+                return found;
             throw DataObjectAlreadyInSession(obj->key());
         }
-        identity_map_[key] = obj;
     }
     return obj;
 }
 
+// Only the statuses flush() has to act upon are tracked
+static inline bool is_work_status(int status)
+{
+    return status == DataObject::New || status == DataObject::Dirty ||
+        status == DataObject::ToBeDeleted || status == DataObject::Deleted;
+}
+
+void Session::link_work(DataObject *obj)
+{
+    if (is_work_status(obj->status_))
+        work_lists_[obj->status_].push(obj);
+    else if (obj->status_ == DataObject::Ghost &&
+            obj->table_.batch_size() > 1)
+        ghost_lists_[&obj->table_].push(obj);
+}
+
+void Session::unlink_work(DataObject *obj)
+{
+    if (is_work_status(obj->status_))
+        work_lists_[obj->status_].remove(obj);
+    else if (obj->status_ == DataObject::Ghost) {
+        GhostLists::iterator i = ghost_lists_.find(&obj->table_);
+        if (i != ghost_lists_.end())
+            i->second.remove(obj);
+    }
+}
+
+void Session::clear_work_lists()
+{
+    for (size_t i = 0; i < sizeof(work_lists_) / sizeof(work_lists_[0]); ++i)
+        work_lists_[i].clear();
+    GhostLists::iterator j = ghost_lists_.begin(), jend = ghost_lists_.end();
+    for (; j != jend; ++j)
+        j->second.clear();
+}
+
+// Load the object along with up to batch_size - 1 other
+// ghosts of the same table, using a single query
+void Session::load_ghosts(DataObject *obj)
+{
+    const Table &tbl = obj->table();
+    size_t batch_size = tbl.batch_size(),
+           max_keys = engine_->get_dialect()->max_params() /
+               (tbl.pk_fields().size()? tbl.pk_fields().size(): 1);
+    if (max_keys > (size_t)engine_->get_dialect()->max_in_list())
+        max_keys = engine_->get_dialect()->max_in_list();
+    if (batch_size > max_keys)
+        batch_size = max_keys > 1? max_keys: 1;
+    ObjectPtrs batch(1, obj);
+    Keys keys(1, obj->key());
+    DataObject *x = ghost_lists_[&tbl].head();
+    for (; x && batch.size() < batch_size; x = x->work_next_)
+        if (x != obj) {
+            batch.push_back(x);
+            keys.push_back(x->key());
+        }
+    IdentityMap batch_map;
+    for (size_t i = 0; i < batch.size(); ++i)
+        batch_map.insert(keys[i], batch[i]);
+    ExpressionList cols;
+    Columns::const_iterator it = tbl.begin(), end = tbl.end();
+    for (; it != end; ++it)
+        cols << ColumnExpr(tbl.name(), it->name());
+    EntityCache *cache = entity_cache_for(tbl);
+    LongInt generation = cache? cache->generation(tbl): 0;
+    RowsPtr result = engine_->select(
+            cols, ColumnExpr(tbl.name()), filter_by_keys(keys));
+    bool found = false;
+    Rows::iterator r = result->begin(), rend = result->end();
+    for (; r != rend; ++r) {
+        Key key;
+        tbl.mk_key(*r, key);
+        if (cache)
+            cache->put(tbl, key, r->values(), generation);
+        DataObject *loaded = batch_map.find(key);
+        if (loaded && loaded->status() == DataObject::Ghost) {
+            loaded->fill_from_row(*r);
+            if (loaded == obj)
+                found = true;
+        }
+    }
+    if (!found)
+        throw ObjectNotFoundByKey(tbl.name() + _T("(")
+                                  + KeyFilter(obj->key()).get_sql() + _T(")"));
+}
+
+EntityCache *Session::entity_cache_for(const Table &tbl)
+{
+    if (tbl.cache_mode() == Table::NoCache || !engine_.get() ||
+            changed_cached_tables_.count(tbl.name()))
+        return NULL;
+    return engine_->entity_cache();
+}
+
 void Session::save(DataObjectPtr obj0)
 {
     DataObject *obj = add_to_identity_map(shptr_get(obj0), true);
@@ -207,18 +517,16 @@ DataObjectPtr Session::save_or_update(DataObjectPtr obj0)
     for (size_t i = 0; i < table.size(); ++i)
         if (!table[i].is_pk())
             obj->values_[i] = obj0->values_[i];
-    obj->status_ = obj0->status_;
+    // all the columns are replaced, so a dirty object gets a full update
+    obj->modified_.clear();
+    obj->set_status(obj0->status_);
     return DataObjectPtr(obj);
 }
 
 void Session::detach(DataObjectPtr obj)
 {
-    if (obj->assigned_key()) {
-        const Key &key = obj->key();
-        IdentityMap::iterator i = identity_map_.find(key);
-        if (i != identity_map_.end())
-            identity_map_.erase(i);
-    }
+    if (obj->assigned_key())
+        identity_map_.erase(obj->key());
     Objects::iterator i = objects_.find(obj);
     if (i != objects_.end()) {
         objects_.erase(i);
@@ -243,26 +551,129 @@ DataObjectResultSet Session::load_collection(
         const Expression &from,
         const Expression &filter,
         const Expression &order_by,
-        bool for_update_flag)
+        bool for_update_flag,
+        bool untracked)
 {
     Strings tables;
     SelectExpr select = make_select(
         schema_, from, filter, order_by, for_update_flag, 0, 0, &tables);
-    return load_collection(tables, select);
+    return load_collection(tables, select, untracked);
 }
 
 DataObjectResultSet Session::load_collection(
-        const Strings &tables, const SelectExpr &select_expr)
+        const Strings &tables, const SelectExpr &select_expr,
+        bool untracked)
 {
     SqlResultSet rs = engine_->select_iter(select_expr);
-    return DataObjectResultSet(rs, *this, tables);
+    return DataObjectResultSet(rs, *this, tables, untracked);
+}
+
+// The key of the master a row of the slave table refers to
+static void master_key_from_row(const Relation &rel, const Row &row,
+                                Key &key)
+{
+    const Table &master_tbl = rel.table(0), &slave_tbl = rel.table(1);
+    const Strings &parts = rel.fk_fields();
+    if (master_tbl.pk_fields().size() == 1) {
+        const String &pk_name = master_tbl.pk_fields()[0];
+        int col_type = master_tbl.column(pk_name).type();
+        if (col_type == Value::INTEGER || col_type == Value::LONGINT) {
+            const Value &x = row[slave_tbl.idx_by_name(parts[0])];
+            key.reset(&master_tbl.name(), &pk_name,
+                      x.is_null()? 0: x.as_longint(), x.is_null());
+            return;
+        }
+    }
+    key.reset(&master_tbl.name());
+    key.fields.reserve(master_tbl.pk_fields().size());
+    Strings::const_iterator i = parts.begin(), iend = parts.end(),
+        j = master_tbl.pk_fields().begin(),
+        jend = master_tbl.pk_fields().end();
+    for (; i != iend && j != jend; ++i, ++j)
+        key.fields.push_back(std::make_pair(
+                    &*j, row[slave_tbl.idx_by_name(*i)]));
+}
+
+void Session::prefetch_slaves(const DataObjectList &masters,
+                              const Relation &rel)
+{
+    const Table &slave_tbl = rel.table(1);
+    IdentityMap masters_by_key;
+    std::vector<RelationObject *> ros;
+    Keys fkeys;
+    DataObjectList::const_iterator i = masters.begin(), iend = masters.end();
+    for (; i != iend; ++i) {
+        DataObject *master = shptr_get(*i);
+        if (!master || master->status() == DataObject::New)
+            continue;
+        RelationObject *ro = master->get_slaves(rel);
+        if (ro->status() == RelationObject::Sync ||
+                masters_by_key.insert(master->key(), master))
+            continue;
+        ros.push_back(ro);
+        fkeys.push_back(ro->gen_fkey());
+    }
+    if (fkeys.empty())
+        return;
+    ExpressionList cols;
+    Columns::const_iterator j = slave_tbl.begin(), jend = slave_tbl.end();
+    for (; j != jend; ++j)
+        cols << ColumnExpr(slave_tbl.name(), j->name());
+    size_t chunk_size = engine_->get_dialect()->max_params() /
+        rel.fk_fields().size();
+    if (chunk_size > (size_t)engine_->get_dialect()->max_in_list())
+        chunk_size = engine_->get_dialect()->max_in_list();
+    if (chunk_size < 1)
+        chunk_size = 1;
+    for (size_t start = 0; start < fkeys.size(); start += chunk_size) {
+        size_t end = std::min(start + chunk_size, fkeys.size());
+        Keys chunk(fkeys.begin() + start, fkeys.begin() + end);
+        SelectExpr select_expr = SelectExpr(cols)
+            .from_(ColumnExpr(slave_tbl.name()))
+            .where_(filter_by_keys(chunk));
+        if (rel.has_attr(1, _T("order-by")) &&
+                !str_empty(rel.attr(1, _T("order-by"))))
+            select_expr.order_by_(Expression(rel.attr(1, _T("order-by"))));
+        select_expr.add_aliases();
+        SqlResultSet rs = engine_->select_iter(select_expr);
+        SqlResultSet::iterator k = rs.begin(), kend = rs.end();
+        for (; k != kend; ++k) {
+            Key master_key;
+            master_key_from_row(rel, *k, master_key);
+            DataObject *master = masters_by_key.find(master_key);
+            Key pkey;
+            slave_tbl.mk_key(*k, pkey);
+            DataObject::Ptr o = get_lazy(pkey);
+            if (o->status() == DataObject::Ghost)
+                o->fill_from_row(*k);
+            if (master && o->status() != DataObject::ToBeDeleted
+                    && o->status() != DataObject::Deleted)
+                DataObject::link(master, o, rel);
+        }
+    }
+    std::vector<RelationObject *>::iterator r = ros.begin(), rend = ros.end();
+    for (; r != rend; ++r)
+        (*r)->status(RelationObject::Sync);
+}
+
+void Session::prefetch_master_relations(const DataObjectList &objs)
+{
+    if (objs.empty())
+        return;
+    const Table &tbl = objs[0]->table();
+    Schema::RelMap::const_iterator
+        it = schema_.rels_lower_bound(tbl.class_name()),
+        end = schema_.rels_upper_bound(tbl.class_name());
+    for (; it != end; ++it)
+        if (it->second->get_table(0) == &tbl)
+            prefetch_slaves(objs, *it->second);
 }
 
 DataObject::Ptr Session::get_lazy(const Key &key)
 {
-    IdentityMap::iterator i = identity_map_.find(key);
-    if (i != identity_map_.end())
-        return DataObject::Ptr(i->second);
+    DataObject *found = identity_map_.find(key);
+    if (found)
+        return DataObject::Ptr(found);
     bool empty = empty_key(key);
     if (empty)
         return DataObject::Ptr(NULL);
@@ -279,18 +690,18 @@ DataObject::Ptr Session::get_lazy(const Key &key)
     }
     objects_.insert(new_obj);
     new_obj->set_session(this);
-    identity_map_[key] = shptr_get(new_obj);
+    identity_map_.insert(key, shptr_get(new_obj));
     return new_obj;
 }
 
 typedef std::map<String, Rows> RowsByTable;
-typedef std::map<String, RowsData> RowsDataByTable;
+typedef std::map<std::pair<String, ColumnMask>, RowsData> RowsDataByColumns;
 
-template <class Row__, class Rows__>
-void add_row_to_rows_by_table(std::map<String, Rows__> &rows_by_table,
-                              const String &tbl_name, const Row__ &row)
+template <class Key__, class Row__, class Rows__>
+void add_row_to_rows_by_table(std::map<Key__, Rows__> &rows_by_table,
+                              const Key__ &tbl_name, const Row__ &row)
 {
-    typename std::map<String, Rows__>::iterator k = rows_by_table.find(tbl_name);
+    typename std::map<Key__, Rows__>::iterator k = rows_by_table.find(tbl_name);
     if (k == rows_by_table.end()) {
         Rows__ rows(1);
         rows[0] = row;
@@ -336,7 +747,7 @@ void Session::flush_tbl_new_unkeyed(const Table &tbl, Objects &unkeyed_objs)
     if (use_seq) {
         String pk = tbl.get_surrogate_pk();
         for (i = unkeyed_objs.begin(); i != iend; ++i)
-            (*i)->set(pk, Value(engine_->get_next_value(tbl.seq_name())));
+            (*i)->set(pk, Value(engine_->get_next_id(tbl)));
     }
     RowsData rows;
     rows.reserve(unkeyed_objs.size());
@@ -361,22 +772,18 @@ void Session::flush_tbl_new_unkeyed(const Table &tbl, Objects &unkeyed_objs)
 
 void Session::flush_new()
 {
-    SqlDialect *dialect = engine_->get_dialect();
-    bool sql_seq = dialect->has_sequences();
-    Objects::iterator i = objects_.begin(), iend = objects_.end();
+    ObjectPtrs new_objs;
+    work_lists_[DataObject::New].copy_to(new_objs);
+    ObjectPtrs::iterator i = new_objs.begin(), iend = new_objs.end();
     for (; i != iend; ++i)
-        if ((*i)->status() == DataObject::New)
-            (*i)->depth(-1);
-    for (i = objects_.begin(); i != iend; ++i)
-        if ((*i)->status() == DataObject::New)
-            (*i)->calc_depth(0);
+        (*i)->depth(-1);
+    for (i = new_objs.begin(); i != iend; ++i)
+        (*i)->calc_depth(0);
     int max_depth = -1;
     typedef std::map<String, Objects> ObjectsByTable;
     typedef std::map<int, ObjectsByTable> GroupsByDepth;
     GroupsByDepth groups_by_depth;
-    for (i = objects_.begin(); i != iend; ++i)
-        if ((*i)->status() == DataObject::New)
-    {
+    for (i = new_objs.begin(); i != iend; ++i) {
         int d = (*i)->depth();
         if (d > max_depth)
             max_depth = d;
@@ -397,7 +804,7 @@ void Session::flush_new()
             q = res.first;
         }
         Objects &objs = q->second;
-        objs.insert(*i);
+        objs.insert(DataObjectPtr(*i));
     }
     for (int d = 0; d <= max_depth; ++d) {
         GroupsByDepth::iterator k = groups_by_depth.find(d);
@@ -419,40 +826,64 @@ void Session::flush_new()
             flush_tbl_new_unkeyed(tbl, unkeyed_objs);
         }
     }
-    for (i = objects_.begin(); i != iend; ++i)
+    for (i = new_objs.begin(); i != iend; ++i)
         if ((*i)->status() == DataObject::New)
             (*i)->set_status(DataObject::Ghost);
 }
 
-void Session::flush_update(IdentityMap &idmap_copy)
+struct ObjectKeyLess
 {
-    RowsDataByTable rows_by_table;
-    IdentityMap::iterator i = idmap_copy.begin(), iend = idmap_copy.end();
-    for (; i != iend; ++i)
-        if (i->second->status() == DataObject::Dirty) {
-            const String &tbl_name = i->second->table().name();
-            i->second->refresh_master_fkeys();
-            add_row_to_rows_by_table(rows_by_table, tbl_name,
-                                     &i->second->raw_values());
-            i->second->set_status(DataObject::Ghost);
-        }
-    RowsDataByTable::iterator j = rows_by_table.begin(), jend = rows_by_table.end();
+    bool operator() (DataObject *a, DataObject *b) const
+    {
+        return a->key() < b->key();
+    }
+};
+
+// Work lists keep the order of status changes, so sort the affected
+// objects by key to issue statements in a stable order.
+static void sorted_by_key(const WorkList &work_list,
+                          std::vector<DataObject *> &out)
+{
+    work_list.copy_to(out);
+    std::sort(out.begin(), out.end(), ObjectKeyLess());
+}
+
+void Session::flush_update()
+{
+    // Group the rows by the set of changed columns, each group
+    // gets its own UPDATE statement, setting just those columns
+    RowsDataByColumns rows_by_columns;
+    ObjectPtrs dirty;
+    sorted_by_key(work_lists_[DataObject::Dirty], dirty);
+    ObjectPtrs::iterator i = dirty.begin(), iend = dirty.end();
+    for (; i != iend; ++i) {
+        DataObject *obj = *i;
+        obj->refresh_master_fkeys();
+        add_row_to_rows_by_table(rows_by_columns,
+                std::make_pair(obj->table().name(), obj->modified_columns()),
+                &obj->raw_values());
+        obj->set_status(DataObject::Ghost);
+    }
+    RowsDataByColumns::iterator j = rows_by_columns.begin(),
+        jend = rows_by_columns.end();
     for (; j != jend; ++j)
-        engine_->update(schema_[j->first], j->second);
+        engine_->update(schema_[j->first.first], j->second,
+                        &j->first.second);
 }
 
-void Session::flush_delete(IdentityMap &idmap_copy)
+void Session::flush_delete()
 {
     typedef std::vector<Key> Keys;
     typedef std::map<String, Keys> KeysByTable;
     typedef std::map<int, KeysByTable> GroupsByDepth;
     int max_depth = -1;
     GroupsByDepth groups_by_depth;
-    IdentityMap::iterator i = idmap_copy.begin(), iend = idmap_copy.end();
-    for (; i != iend; ++i)
-        if (i->second->status() == DataObject::ToBeDeleted)
-    {
-        int d = i->second->depth();
+    ObjectPtrs to_delete;
+    sorted_by_key(work_lists_[DataObject::ToBeDeleted], to_delete);
+    ObjectPtrs::iterator i = to_delete.begin(), iend = to_delete.end();
+    for (; i != iend; ++i) {
+        DataObject *obj = *i;
+        int d = obj->depth();
         if (d > max_depth)
             max_depth = d;
         GroupsByDepth::iterator k = groups_by_depth.find(d);
@@ -463,7 +894,7 @@ void Session::flush_delete(IdentityMap &idmap_copy)
             k = res.first;
         }
         KeysByTable &keys_by_table = k->second;
-        const String &tbl_name = i->second->table().name();
+        const String &tbl_name = obj->table().name();
         KeysByTable::iterator q = keys_by_table.find(tbl_name);
         if (keys_by_table.end() == q) {
             std::pair<KeysByTable::iterator, bool> res =
@@ -472,8 +903,8 @@ void Session::flush_delete(IdentityMap &idmap_copy)
             q = res.first;
         }
         Keys &keys = q->second;
-        keys.push_back(i->second->key());
-        i->second->set_status(DataObject::Deleted);
+        keys.push_back(obj->key());
+        obj->set_status(DataObject::Deleted);
     }
 
     for (int d = max_depth; d >= 0; --d) {
@@ -491,24 +922,44 @@ void Session::flush_delete(IdentityMap &idmap_copy)
     }
 }
 
+// Remember the cached tables about to be changed, until the end
+// of the transaction reading them from the cache could give stale
+// rows and putting them could leak uncommitted ones
+void Session::note_cached_changes()
+{
+    static const int statuses[] = {
+        DataObject::New, DataObject::Dirty, DataObject::ToBeDeleted };
+    for (size_t i = 0; i < sizeof(statuses) / sizeof(statuses[0]); ++i) {
+        DataObject *obj = work_lists_[statuses[i]].head();
+        for (; obj; obj = obj->work_next_) {
+            const Table &tbl = obj->table();
+            if (tbl.cache_mode() == Table::NoCache)
+                continue;
+            if (tbl.cache_mode() == Table::ReadOnlyCache &&
+                    statuses[i] != DataObject::New)
+                throw ReadOnlyCachedTable(tbl.name());
+            changed_cached_tables_.insert(tbl.name());
+        }
+    }
+}
+
 void Session::flush()
 {
     debug(_T("flush started"));
     try {
-        IdentityMap idmap_copy = identity_map_;
+        note_cached_changes();
         flush_new();
-        flush_update(idmap_copy);
-        flush_delete(idmap_copy);
+        flush_update();
+        flush_delete();
         // Delete the deleted objects
-        Objects obj_copy = objects_;
-        Objects::iterator i = obj_copy.begin(), iend = obj_copy.end();
-        for (; i != iend; ++i)
-            if ((*i)->status() == DataObject::Deleted) {
-                IdentityMap::iterator k = identity_map_.find((*i)->key());
-                if (k != identity_map_.end())
-                    identity_map_.erase(k);
-                objects_.erase(objects_.find(*i));
-            }
+        ObjectPtrs deleted;
+        work_lists_[DataObject::Deleted].copy_to(deleted);
+        work_lists_[DataObject::Deleted].clear();
+        ObjectPtrs::iterator i = deleted.begin(), iend = deleted.end();
+        for (; i != iend; ++i) {
+            identity_map_.erase((*i)->key());
+            objects_.erase(DataObjectPtr(*i));
+        }
         debug(_T("flush finished OK"));
     }
     catch (...) {
@@ -521,30 +972,56 @@ void Session::commit()
 {
     flush();
     engine_->commit();
+    EntityCache *cache = engine_->entity_cache();
+    if (cache) {
+        std::set<String>::const_iterator i = changed_cached_tables_.begin(),
+            iend = changed_cached_tables_.end();
+        for (; i != iend; ++i)
+            cache->invalidate(*i);
+    }
+    changed_cached_tables_.clear();
 }
 
 void Session::rollback()
 {
     //purge();
     engine_->rollback();
+    changed_cached_tables_.clear();
 }
 
 void DataObject::set_session(Session *session)
 {
     YB_ASSERT(session && (!session_ || session_ == session));
-    session_ = session;
+    if (!session_) {
+        session_ = session;
+        session_->link_work(this);
+    }
 }
 
 void DataObject::forget_session()
 {
     YB_ASSERT(session_);
+    session_->unlink_work(this);
     session_ = NULL;
 }
 
+void DataObject::set_status(Status st)
+{
+    if (st == status_)
+        return;
+    if (st != Dirty)
+        modified_.clear();
+    if (session_)
+        session_->unlink_work(this);
+    status_ = st;
+    if (session_)
+        session_->link_work(this);
+}
+
 void DataObject::touch()
 {
     if (status_ == Sync)
-        status_ = Dirty;
+        set_status(Dirty);
 }
 
 void DataObject::set(int i, const Value &v)
@@ -571,8 +1048,14 @@ void DataObject::set(int i, const Value &v)
     values_[i].swap(new_v);
     if (c.is_pk())
         update_key();
-    else
+    else {
+        // an object touched as a whole keeps the empty mask
+        if (status_ == Sync || (status_ == Dirty && !modified_.empty())) {
+            modified_.resize(values_.size());
+            modified_[i] = true;
+        }
         touch();
+    }
 }
 
 void DataObject::update_key()
@@ -597,16 +1080,31 @@ bool DataObject::assigned_key()
 void DataObject::load()
 {
     YB_ASSERT(session_ != NULL);
+    EntityCache *cache = session_->entity_cache_for(table_);
+    if (cache) {
+        Row row;
+        if (cache->get(table_, key(), row.values())) {
+            fill_from_row(row);
+            return;
+        }
+    }
+    if (table_.batch_size() > 1) {
+        session_->load_ghosts(this);
+        return;
+    }
     ExpressionList cols;
     Columns::const_iterator it = table_.begin(), end = table_.end();
     for (; it != end; ++it)
         cols << ColumnExpr(table_.name(), it->name());
     KeyFilter f(key());
+    LongInt generation = cache? cache->generation(table_): 0;
     RowsPtr result = session_->engine()->select
         (cols, ColumnExpr(table_.name()), f);
     if (result->size() != 1)
         throw ObjectNotFoundByKey(table_.name() + _T("(")
                                   + f.get_sql() + _T(")"));
+    if (cache)
+        cache->put(table_, key(), result->begin()->values(), generation);
     fill_from_row(*result->begin());
 }
 
@@ -791,11 +1289,11 @@ size_t DataObject::fill_from_row(Row &r, size_t pos)
 {
     size_t i = 0;
     for (; i < table_.size(); ++i) {
-        values_[i].swap(r[pos + i].second);
+        values_[i].swap(r[pos + i]);
         values_[i].fix_type(table_[i].type());
     }
     update_key();
-    status_ = Sync;
+    set_status(Sync);
     return pos + i;
 }
 
@@ -836,11 +1334,11 @@ void DataObject::delete_object(DeletionMode mode, int depth)
         delete_master_relations(DelUnchecked, depth + 1);
         exclude_from_slave_relations();
         if (status_ == New) {
-            status_ = Deleted;
+            set_status(Deleted);
         }
         else {
             //depth_ = depth; // why the hell I did that?
-            status_ = ToBeDeleted;
+            set_status(ToBeDeleted);
         }
     }
 }
@@ -949,6 +1447,10 @@ void RelationObject::delete_master(DeletionMode mode, int depth)
     }
     else if (relation_info_.cascade() == Relation::Delete) {
         SlaveObjects slaves_copy = slave_objects_;
+        // load the next level of the subtree with a few queries,
+        // so that the slaves need not be loaded one by one
+        if (mode == DelDryRun && master_object_->session())
+            master_object_->session()->prefetch_master_relations(slaves_copy);
         SlaveObjects::iterator i = slaves_copy.begin(),
             iend = slaves_copy.end();
         for (; i != iend; ++i)
@@ -1004,7 +1506,7 @@ size_t RelationObject::count_slaves()
     if (result->size() != 1)
         throw ObjectNotFoundByKey(_T("COUNT(*) FOR ") + slave_tbl.name()
                 + _T("(") + f.get_sql() + _T(")"));
-    return static_cast<int>(result->begin()->begin()->second.as_longint());
+    return static_cast<int>((*result->begin())[0].as_longint());
 }
 
 void RelationObject::lazy_load_slaves()
@@ -27,6 +27,15 @@ InterbaseDialect::select_next_value(const String &seq_name)
     return _T("GEN_ID(") + seq_name + _T(", 1)");
 }
 
+const String
+InterbaseDialect::select_next_block(const String &seq_name, int increment)
+{
+    if (increment == 1)
+        return select_next_value(seq_name);
+    String n = to_string(increment);
+    return _T("GEN_ID(") + seq_name + _T(", ") + n + _T(") - ") + n + _T(" + 1");
+}
+
 const String
 InterbaseDialect::sql_value(const Value &x)
 {
@@ -53,7 +62,9 @@ InterbaseDialect::type2sql(int t)
     throw SqlDialectError(_T("Bad type"));
 }
 
-const String InterbaseDialect::create_sequence(const String &seq_name)
+// generators have no stored step, see select_next_block()
+const String InterbaseDialect::create_sequence(const String &seq_name,
+        int increment)
 {
     return _T("CREATE GENERATOR ") + seq_name;
 }
@@ -70,6 +81,32 @@ InterbaseDialect::pager_model()
     return (int)PAGER_INTERBASE;
 }
 
+int
+InterbaseDialect::insert_model()
+{
+    return (int)INSERT_SINGLE_ROW;
+}
+
+int
+InterbaseDialect::returning_model(SqlConnection &conn)
+{
+    const String &source_id = conn.get_source().id();
+    {
+        ScopedLock lock(mux_);
+        std::map<String, int>::const_iterator i =
+            returning_models_.find(source_id);
+        if (i != returning_models_.end())
+            return i->second;
+    }
+    // InterBase has no INSERT ... RETURNING, Firebird has it since 2.0,
+    // tell them apart by the monitoring tables of Firebird 2.1+
+    int model = table_exists(conn, _T("MON$DATABASE"))?
+        (int)RETURNING_CLAUSE: (int)RETURNING_NONE;
+    ScopedLock lock(mux_);
+    returning_models_[source_id] = model;
+    return model;
+}
+
 // schema introspection
 
 bool
@@ -118,7 +155,7 @@ InterbaseDialect::really_get_tables(SqlConnection &conn,
     SqlResultSet rs = cursor->exec(params);
     for (SqlResultSet::iterator i = rs.begin(); i != rs.end(); ++i)
     {
-        tables.push_back(trim_trailing_space((*i)[0].second.as_string()));
+        tables.push_back(trim_trailing_space((*i)[0].as_string()));
     }
     return tables;
 }
@@ -266,7 +303,7 @@ InterbaseDialect::get_columns(SqlConnection &conn, const String &table)
     for (SqlResultSet::iterator i = rs3.begin(); i != rs3.end(); ++i)
     {
         String key_name = str_to_upper(
-                trim_trailing_space((*i)[0].second.as_string()));
+                trim_trailing_space((*i)[0].as_string()));
         for (ColumnsInfo::iterator k = col_mass.begin(); k != col_mass.end(); ++k)
         {
             if (key_name == k->name)
@@ -62,7 +62,7 @@ MssqlDialect::type2sql(int t)
 }
 
 const String
-MssqlDialect::create_sequence(const String &seq_name)
+MssqlDialect::create_sequence(const String &seq_name, int increment)
 {
     throw SqlDialectError(_T("No sequences, please"));
 }
@@ -97,6 +97,22 @@ MssqlDialect::pager_model()
     return (int)PAGER_ORACLE;
 }
 
+int
+MssqlDialect::max_params()
+{
+    // the server accepts less than 2100 parameters per request
+    return 2000;
+}
+
+int
+MssqlDialect::returning_model(SqlConnection &conn)
+{
+    // OUTPUT INSERTED without INTO is rejected for the tables
+    // having triggers, and with INTO it takes a batch of statements,
+    // so the ids are selected after each row
+    return (int)RETURNING_NONE;
+}
+
 // schema introspection
 
 bool
@@ -141,7 +157,7 @@ MssqlDialect::really_get_tables(SqlConnection &conn,
     SqlResultSet rs = cursor->exec(params);
     for (SqlResultSet::iterator i = rs.begin(); i != rs.end(); ++i)
     {
-        tables.push_back((*i)[0].second.as_string());
+        tables.push_back((*i)[0].as_string());
     }
     return tables;
 }
@@ -228,9 +244,9 @@ MssqlDialect::get_columns(SqlConnection &conn, const String &table)
     SqlResultSet rs2 = cursor->exec(params2);
     for (SqlResultSet::iterator i = rs2.begin(); i != rs2.end(); ++i)
     {
-        String key_name = str_to_upper((*i)[0].second.as_string()),
-            key_type = str_to_upper((*i)[1].second.as_string()),
-            fk_table = (*i)[2].second.nvl(String()).as_string();
+        String key_name = str_to_upper((*i)[0].as_string()),
+            key_type = str_to_upper((*i)[1].as_string()),
+            fk_table = (*i)[2].nvl(String()).as_string();
         for (ColumnsInfo::iterator j = ci.begin(); j != ci.end(); ++j)
         {
             if (j->name == key_name)
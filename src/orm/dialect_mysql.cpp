@@ -55,7 +55,7 @@ MysqlDialect::type2sql(int t)
 }
 
 const String
-MysqlDialect::create_sequence(const String &seq_name)
+MysqlDialect::create_sequence(const String &seq_name, int increment)
 {
     throw SqlDialectError(_T("No sequences, please"));
 }
@@ -101,6 +101,12 @@ MysqlDialect::pager_model()
     return (int)PAGER_MYSQL;
 }
 
+int
+MysqlDialect::max_params()
+{
+    return 65535;
+}
+
 // schema introspection
 
 bool
@@ -146,7 +152,7 @@ MysqlDialect::really_get_tables(SqlConnection &conn,
     for (SqlResultSet::iterator i = rs.begin(); i != rs.end(); ++i)
     {
         // do not force upper case here:
-        tables.push_back((*i)[0].second.as_string());
+        tables.push_back((*i)[0].as_string());
     }
     return tables;
 }
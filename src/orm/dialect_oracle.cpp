@@ -49,9 +49,12 @@ OracleDialect::type2sql(int t) {
 }
 
 const String
-OracleDialect::create_sequence(const String &seq_name)
+OracleDialect::create_sequence(const String &seq_name, int increment)
 {
-    return _T("CREATE SEQUENCE ") + seq_name;
+    String sql = _T("CREATE SEQUENCE ") + seq_name;
+    if (increment != 1)
+        sql += _T(" INCREMENT BY ") + to_string(increment);
+    return sql;
 }
 
 const String
@@ -72,6 +75,18 @@ OracleDialect::pager_model()
     return (int)PAGER_ORACLE;
 }
 
+int
+OracleDialect::insert_model()
+{
+    return (int)INSERT_ALL;
+}
+
+int
+OracleDialect::max_params()
+{
+    return 65535;
+}
+
 // schema introspection
 
 bool
@@ -105,7 +120,7 @@ OracleDialect::get_tables(SqlConnection &conn)
     SqlResultSet rs = cursor->exec(params);
     for (SqlResultSet::iterator i = rs.begin(); i != rs.end(); ++i)
     {
-        table.push_back((*i)[0].second.as_string());
+        table.push_back((*i)[0].as_string());
     }
     return table;
 }
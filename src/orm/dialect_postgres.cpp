@@ -50,8 +50,11 @@ PostgresDialect::type2sql(int t)
 }
 
 const String
-PostgresDialect::create_sequence(const String &seq_name) {
-    return _T("CREATE SEQUENCE ") + seq_name;
+PostgresDialect::create_sequence(const String &seq_name, int increment) {
+    String sql = _T("CREATE SEQUENCE ") + seq_name;
+    if (increment != 1)
+        sql += _T(" INCREMENT BY ") + to_string(increment);
+    return sql;
 }
 
 const String
@@ -59,6 +62,11 @@ PostgresDialect::drop_sequence(const String &seq_name) {
     return _T("DROP SEQUENCE ") + seq_name;
 }
 
+int
+PostgresDialect::returning_model(SqlConnection &conn) {
+    return (int)RETURNING_CLAUSE;
+}
+
 // schema introspection
 bool
 PostgresDialect::table_exists(SqlConnection &conn, const String &table)
@@ -92,7 +100,7 @@ PostgresDialect::get_tables(SqlConnection &conn)
     SqlResultSet rs = cursor->exec(params);
     for (SqlResultSet::iterator i = rs.begin(); i != rs.end(); ++i)
     {
-        table.push_back(str_to_upper((*i)[0].second.as_string()));
+        table.push_back(str_to_upper((*i)[0].as_string()));
     }
     return table;
 }
@@ -195,7 +203,7 @@ PostgresDialect::get_columns(SqlConnection &conn, const String &table)
     SqlResultSet rs2 = cursor->exec(params);
     for (SqlResultSet::iterator i = rs2.begin(); i != rs2.end(); ++i)
     {
-        String pk_name = (*i)[0].second.as_string();
+        String pk_name = (*i)[0].as_string();
         for (ColumnsInfo::iterator j = ci.begin(); j != ci.end(); ++j)
             if (pk_name == j->name) {
                 j->pk = true;
@@ -4,6 +4,10 @@
 #include <algorithm>
 #include "dialect_sqlite.h"
 #include "util/string_utils.h"
+#include "orm/expression.h"
+#if defined(YB_USE_SQLITE3)
+#include <sqlite3.h>
+#endif
 
 namespace Yb {
 
@@ -72,7 +76,7 @@ SQLite3Dialect::has_for_update()
 }
 
 const String
-SQLite3Dialect::create_sequence(const String &seq_name)
+SQLite3Dialect::create_sequence(const String &seq_name, int increment)
 {
     throw SqlDialectError(_T("No sequences, please"));
 }
@@ -95,6 +99,32 @@ SQLite3Dialect::autoinc_flag()
     return _T("AUTOINCREMENT");
 }
 
+int
+SQLite3Dialect::max_params()
+{
+    // SQLITE_MAX_VARIABLE_NUMBER in builds prior to 3.32.0
+    return 999;
+}
+
+int
+SQLite3Dialect::max_insert_rows()
+{
+    return 500;
+}
+
+int
+SQLite3Dialect::returning_model(SqlConnection &conn)
+{
+#if defined(YB_USE_SQLITE3)
+    // RETURNING has appeared in SQLite 3.35.0, the version of the
+    // library linked here is only known to be used by the native driver
+    if (conn.get_driver()->get_name() == _T("SQLITE") &&
+            sqlite3_libversion_number() >= 3035000)
+        return (int)RETURNING_CLAUSE;
+#endif
+    return (int)RETURNING_NONE;
+}
+
 // schema introspection
 
 static Strings
@@ -114,7 +144,7 @@ really_get_tables(SqlConnection &conn, const String &type,
     SqlResultSet rs = cursor->exec(params);
     for (SqlResultSet::iterator i = rs.begin(); i != rs.end(); ++i)
     {
-        tables.push_back(str_to_upper((*i)[0].second.as_string()));
+        tables.push_back(str_to_upper((*i)[0].as_string()));
     }
     return tables;
 }
@@ -9,12 +9,25 @@
 #endif // _MSC_VER
 
 using namespace std;
-using Yb::StrUtils::str_to_upper;
 
 namespace Yb {
 
-OdbcCursorBackend::OdbcCursorBackend(tiodbc::connection *conn)
+static void
+set_date_time(TIMESTAMP_STRUCT &ts, const DateTime &t)
+{
+    ts.year = dt_year(t);
+    ts.month = dt_month(t);
+    ts.day = dt_day(t);
+    ts.hour = (SQLUSMALLINT)dt_hour(t);
+    ts.minute = (SQLUSMALLINT)dt_minute(t);
+    ts.second = (SQLUSMALLINT)dt_second(t);
+    ts.fraction = dt_millisec(t) * 1000000;
+}
+
+OdbcCursorBackend::OdbcCursorBackend(tiodbc::connection *conn,
+        int fetch_array_size)
     : conn_(conn)
+    , fetch_array_size_(fetch_array_size)
 {}
 
 void
@@ -22,6 +35,8 @@ OdbcCursorBackend::exec_direct(const String &sql)
 {
     stmt_.reset(NULL);
     stmt_.reset(new tiodbc::statement());
+    stmt_->set_row_array_size(fetch_array_size_);
+    descr_ = RowDescr::Ptr();
     if (!stmt_->execute_direct(*conn_, sql))
         throw DBError(stmt_->last_error_ex());
 }
@@ -31,6 +46,8 @@ OdbcCursorBackend::prepare(const String &sql)
 {
     stmt_.reset(NULL);
     stmt_.reset(new tiodbc::statement());
+    stmt_->set_row_array_size(fetch_array_size_);
+    descr_ = RowDescr::Ptr();
     if (!stmt_->prepare(*conn_, sql))
         throw DBError(stmt_->last_error_ex());
 }
@@ -39,6 +56,8 @@ void
 OdbcCursorBackend::exec(const Values &params)
 {
     try {
+        // a re-executed statement must not have a pending result set
+        stmt_->free_results();
         really_exec(params);
     }
     catch (const tiodbc::bind_error &) {
@@ -56,15 +75,8 @@ OdbcCursorBackend::really_exec(const Values &params)
                 break;
             }
             case Value::DATETIME: {
-                const DateTime &t = params[i].read_as<DateTime>();
                 TIMESTAMP_STRUCT ts;
-                ts.year = dt_year(t);
-                ts.month = dt_month(t);
-                ts.day = dt_day(t);
-                ts.hour = (SQLUSMALLINT)dt_hour(t);
-                ts.minute = (SQLUSMALLINT)dt_minute(t);
-                ts.second = (SQLUSMALLINT)dt_second(t);
-                ts.fraction = dt_millisec(t) * 1000000;
+                set_date_time(ts, params[i].read_as<DateTime>());
                 stmt_->param(i + 1).set_as_date_time(ts, false);
                 break;
             }
@@ -98,18 +110,134 @@ OdbcCursorBackend::really_exec(const Values &params)
         throw DBError(stmt_->last_error_ex());
 }
 
+// INTEGER widens to LONGINT, then to FLOAT, any other mix to STRING
+static int
+wider_type(int a, int b)
+{
+    if (a == Value::INVALID || a == b)
+        return b;
+    if ((a == Value::INTEGER || a == Value::LONGINT) &&
+            (b == Value::INTEGER || b == Value::LONGINT))
+        return Value::LONGINT;
+    if ((a == Value::INTEGER || a == Value::LONGINT || a == Value::FLOAT) &&
+            (b == Value::INTEGER || b == Value::LONGINT || b == Value::FLOAT))
+        return Value::FLOAT;
+    return Value::STRING;
+}
+
+void
+OdbcCursorBackend::exec_many(const std::vector<Values> &params_set)
+{
+    size_t rows = params_set.size();
+    if (rows < 2 || params_set[0].empty() ||
+            !stmt_->set_paramset_size(rows))
+    {
+        SqlCursorBackend::exec_many(params_set);
+        return;
+    }
+    bool ok = false;
+    String err;
+    try {
+        stmt_->free_results();
+        size_t cols = params_set[0].size();
+        for (size_t j = 0; j < cols; ++j) {
+            // the column is bound with a type fitting all its values
+            int type = Value::INVALID;
+            for (size_t i = 0; i < rows; ++i)
+                if (!params_set[i][j].is_null())
+                    type = wider_type(type, params_set[i][j].get_type());
+            tiodbc::param_array &p = stmt_->array_param(j + 1);
+            for (size_t i = 0; i < rows; ++i) {
+                const Value &x = params_set[i][j];
+                if (x.is_null()) {
+                    p.set_as_null(i);
+                    continue;
+                }
+                switch (type) {
+                    case Value::DATETIME: {
+                        TIMESTAMP_STRUCT ts;
+                        set_date_time(ts, x.as_date_time());
+                        p.set_as_date_time(i, ts);
+                        break;
+                    }
+                    case Value::INTEGER:
+                        p.set_as_long(i, x.as_integer());
+                        break;
+                    case Value::LONGINT:
+                        p.set_as_long_long(i, x.as_longint());
+                        break;
+                    case Value::FLOAT:
+                        p.set_as_double(i, x.as_float());
+                        break;
+                    default:
+                        p.set_as_string(i, x.as_string());
+                }
+            }
+        }
+        ok = stmt_->execute_arrays();
+        if (!ok) {
+            err = stmt_->last_error_ex();
+            int failed = stmt_->failed_paramset();
+            if (failed >= 0)
+                err += _T(" (parameter set #") + to_string(failed + 1) +
+                    _T(" of ") + to_string(rows) + _T(" failed)");
+        }
+    }
+    catch (const tiodbc::bind_error &) {
+        err = stmt_->last_error_ex();
+    }
+    stmt_->reset_parameters();
+    if (!ok)
+        throw DBError(err);
+}
+
 RowPtr
 OdbcCursorBackend::fetch_row()
 {
-    if (!stmt_->fetch_next())
-        return RowPtr();
-    int col_count = stmt_->count_columns();
     RowPtr row(new Row);
-    row->reserve(col_count);
+    if (!fetch_into(*row))
+        return RowPtr();
+    return row;
+}
+
+static tiodbc::field_impl
+get_field(tiodbc::statement &stmt, int col_num)
+{
+    try {
+        return stmt.field(col_num);
+    }
+    catch (const tiodbc::fetch_error &e) {
+        // a value has been truncated and could not be read again
+        throw DBError(String(WIDEN(e.what())) + _T(": ") + stmt.last_error_ex());
+    }
+}
+
+bool
+OdbcCursorBackend::fetch_into(Row &row)
+{
+    try {
+        if (!stmt_->fetch_next())
+            return false;
+    }
+    catch (const tiodbc::row_error &e) {
+        // the driver has reported an error for a row within a block
+        throw DBError(String(WIDEN(e.what())) + _T(": ") + stmt_->last_error_ex());
+    }
+    if (!descr_.get()) {
+        // column names are known only after the statement is executed
+        int col_count = stmt_->count_columns();
+        descr_ = RowDescr::Ptr(new RowDescr);
+        for (int i = 0; i < col_count; ++i)
+            descr_->add_column(stmt_->field(i + 1).get_name());
+    }
+    if (row.descr().get() != descr_.get()) {
+        Row new_row(descr_);
+        row.swap(new_row);
+    }
+    int col_count = (int)row.size();
     for (int i = 0; i < col_count; ++i) {
-        tiodbc::field_impl f = stmt_->field(i + 1);
-        row->push_back(make_pair(str_to_upper(f.get_name()), Value()));
-        Value &v = (*row)[row->size() - 1].second;
+        tiodbc::field_impl f = get_field(*stmt_, i + 1);
+        Value &v = row[i];
         switch (f.get_type()) {
             case SQL_DATE:
             case SQL_TIMESTAMP:
@@ -117,59 +245,64 @@ OdbcCursorBackend::fetch_row()
             case SQL_TYPE_TIME:
             case SQL_TYPE_TIMESTAMP: {
                 TIMESTAMP_STRUCT ts = f.as_date_time();
-                if (!f.is_null())
-                    v = Value(dt_make(ts.year, ts.month, ts.day,
-                                       ts.hour, ts.minute, ts.second,
-                                       ts.fraction/1000000));
+                v = f.is_null()? Value():
+                    Value(dt_make(ts.year, ts.month, ts.day,
+                                  ts.hour, ts.minute, ts.second,
+                                  ts.fraction/1000000));
                 break;
             }
             case SQL_INTEGER:
             case SQL_SMALLINT:
             case SQL_TINYINT: {
                 int x = f.as_long();
-                if (!f.is_null())
-                    v = Value(x);
+                v = f.is_null()? Value(): Value(x);
                 break;
             }
             case SQL_BIGINT: {
                 LongInt x = f.as_long_long();
-                if (!f.is_null())
-                    v = Value(x);
+                v = f.is_null()? Value(): Value(x);
                 break;
             }
             case SQL_REAL:
             case SQL_FLOAT:
             case SQL_DOUBLE: {
                 double x = f.as_double();
-                if (!f.is_null())
-                    v = Value(x);
+                v = f.is_null()? Value(): Value(x);
                 break;
             }
             case SQL_DECIMAL:
             case SQL_NUMERIC: {
                 String x = f.as_string();
-                if (!f.is_null())
-                    v = Value(Decimal(x));
+                v = f.is_null()? Value(): Value(Decimal(x));
                 break;
             }
             default: {
                 String x = f.as_string();
-                if (!f.is_null())
-                    v = Value(x);
+                v = f.is_null()? Value(): Value(x);
             }
         }
     }
-    return row;
+    return true;
+}
+
+void
+OdbcCursorBackend::reset()
+{
+    if (stmt_.get())
+        stmt_->free_results();
 }
 
 OdbcConnectionBackend::OdbcConnectionBackend(OdbcDriver *drv)
     : drv_(drv)
+    , fetch_array_size_(YB_ODBC_FETCH_ARRAY_SIZE)
 {}
 
 void
 OdbcConnectionBackend::open(SqlDialect *dialect, const SqlSource &source)
 {
     close();
+    fetch_array_size_ = source.get_as<int>(String(_T("fetch_array_size")),
+            YB_ODBC_FETCH_ARRAY_SIZE);
     conn_.reset(new tiodbc::connection());
     if (!conn_->connect(source.db(), source.user(), source.passwd(),
                 source.get_as<int>(String(_T("timeout")), 10),
@@ -195,7 +328,8 @@ auto_ptr<SqlCursorBackend>
 OdbcConnectionBackend::new_cursor()
 {
     auto_ptr<SqlCursorBackend> p(
-            (SqlCursorBackend *)new OdbcCursorBackend(conn_.get()));
+            (SqlCursorBackend *)new OdbcCursorBackend(conn_.get(),
+                fetch_array_size_));
     return p;
 }
 
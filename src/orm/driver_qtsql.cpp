@@ -5,7 +5,6 @@
 #include "util/string_utils.h"
 
 using namespace std;
-using Yb::StrUtils::str_to_upper;
 
 namespace Yb {
 
@@ -18,6 +17,7 @@ QtSqlCursorBackend::clear()
 {
     bound_.clear();
     rec_.reset(NULL);
+    descr_ = RowDescr::Ptr();
     if (stmt_.get())
         stmt_->clear();
     stmt_.reset(NULL);
@@ -73,13 +73,16 @@ QtSqlCursorBackend::fetch_row()
 {
     if (!stmt_->next())
         return RowPtr();
-    if (!rec_.get())
+    if (!rec_.get()) {
         rec_.reset(new QSqlRecord(stmt_->record()));
+        descr_ = RowDescr::Ptr(new RowDescr);
+        for (int i = 0; i < rec_->count(); ++i)
+            descr_->add_column(rec_->fieldName(i));
+    }
     int col_count = rec_->count();
-    RowPtr row(new Row);
+    RowPtr row(new Row(descr_));
     for (int i = 0; i < col_count; ++i) {
-        String name = str_to_upper(rec_->fieldName(i));
-        Value v;
+        Value &v = (*row)[i];
         if (!stmt_->value(i).isNull()) {
             QVariant::Type t = rec_->field(i).type();
             if (t == QVariant::Bool || t == QVariant::Int ||
@@ -94,11 +97,17 @@ QtSqlCursorBackend::fetch_row()
             else
                 v = Value(stmt_->value(i).toString());
         }
-        row->push_back(RowItem(name, v));
     }
     return row;
 }
 
+void
+QtSqlCursorBackend::reset()
+{
+    if (stmt_.get())
+        stmt_->finish();
+}
+
 QtSqlConnectionBackend::QtSqlConnectionBackend(QtSqlDriver *drv)
     : drv_(drv)
     , own_handle_(false)
@@ -13,6 +13,18 @@ using namespace Yb::StrUtils;
 
 namespace Yb {
 
+static void
+set_tm(std::tm &x, const DateTime &d)
+{
+    memset(&x, 0, sizeof(x));
+    x.tm_year = dt_year(d) - 1900;
+    x.tm_mon = dt_month(d) - 1;
+    x.tm_mday = dt_day(d);
+    x.tm_hour = dt_hour(d);
+    x.tm_min = dt_minute(d);
+    x.tm_sec = dt_second(d);
+}
+
 SOCICursorBackend::SOCICursorBackend(soci::session *conn)
     : conn_(conn), stmt_(NULL), is_select_(false)
     , bound_first_(false), executed_(false)
@@ -34,6 +46,7 @@ SOCICursorBackend::close()
             bound_first_ = false;
             executed_ = false;
             sql_ = _T("");
+            descr_ = RowDescr::Ptr();
         }
     }
     catch (const soci::soci_error &e) {
@@ -168,14 +181,7 @@ SOCICursorBackend::exec(const Values &params)
                 }
                 case Value::DATETIME: {
                     std::tm &x = *(std::tm *)&(in_params_[i][0]);
-                    memset(&x, 0, sizeof(x));
-                    const DateTime &d = param.as_date_time();
-                    x.tm_year = dt_year(d) - 1900;
-                    x.tm_mon = dt_month(d) - 1;
-                    x.tm_mday = dt_day(d);
-                    x.tm_hour = dt_hour(d);
-                    x.tm_min = dt_minute(d);
-                    x.tm_sec = dt_second(d);
+                    set_tm(x, param.as_date_time());
                     break;
                 }
                 default: {
@@ -190,6 +196,92 @@ SOCICursorBackend::exec(const Values &params)
     }
 }
 
+struct SOCIParamArray
+{
+    int type;
+    std::vector<int> ints;
+    std::vector<long long> longs;
+    std::vector<double> doubles;
+    std::vector<std::tm> dates;
+    std::vector<string> strings;
+    std::vector<soci::indicator> flags;
+};
+
+void
+SOCICursorBackend::exec_many(const std::vector<Values> &params_set)
+{
+    size_t rows = params_set.size();
+    if (is_select_ || rows < 2 || params_set[0].empty()) {
+        SqlCursorBackend::exec_many(params_set);
+        return;
+    }
+    size_t cols = params_set[0].size();
+    // one vector per parameter, they must not move until executed
+    std::vector<SOCIParamArray> arrays(cols);
+    try {
+        soci::statement st(*conn_);
+        st.alloc();
+        st.prepare(sql_);
+        for (size_t j = 0; j < cols; ++j) {
+            SOCIParamArray &a = arrays[j];
+            if (param_types_.size() == cols)
+                a.type = param_types_[j];
+            else {
+                a.type = Value::INVALID;
+                for (size_t i = 0; i < rows && a.type == Value::INVALID; ++i)
+                    if (!params_set[i][j].is_null())
+                        a.type = params_set[i][j].get_type();
+            }
+            a.flags.resize(rows, soci::i_ok);
+            switch (a.type) {
+                case Value::INTEGER: a.ints.resize(rows); break;
+                case Value::LONGINT: a.longs.resize(rows); break;
+                case Value::FLOAT: a.doubles.resize(rows); break;
+                case Value::DATETIME: a.dates.resize(rows); break;
+                default: a.strings.resize(rows);
+            }
+            for (size_t i = 0; i < rows; ++i) {
+                const Value &param = params_set[i][j];
+                if (param.is_null()) {
+                    a.flags[i] = soci::i_null;
+                    if (a.type == Value::DATETIME)
+                        memset(&a.dates[i], 0, sizeof(std::tm));
+                    continue;
+                }
+                switch (a.type) {
+                    case Value::INTEGER:
+                        a.ints[i] = param.as_integer(); break;
+                    case Value::LONGINT:
+                        a.longs[i] = param.as_longint(); break;
+                    case Value::FLOAT:
+                        a.doubles[i] = param.as_float(); break;
+                    case Value::DATETIME:
+                        set_tm(a.dates[i], param.as_date_time()); break;
+                    default:
+                        a.strings[i] = NARROW(param.as_string());
+                }
+            }
+            switch (a.type) {
+                case Value::INTEGER:
+                    st.exchange(soci::use(a.ints, a.flags)); break;
+                case Value::LONGINT:
+                    st.exchange(soci::use(a.longs, a.flags)); break;
+                case Value::FLOAT:
+                    st.exchange(soci::use(a.doubles, a.flags)); break;
+                case Value::DATETIME:
+                    st.exchange(soci::use(a.dates, a.flags)); break;
+                default:
+                    st.exchange(soci::use(a.strings, a.flags));
+            }
+        }
+        st.define_and_bind();
+        st.execute(true);
+    }
+    catch (const soci::soci_error &e) {
+        throw DBError(WIDEN(e.what()));
+    }
+}
+
 RowPtr SOCICursorBackend::fetch_row()
 {
     try {
@@ -199,15 +291,19 @@ RowPtr SOCICursorBackend::fetch_row()
 #endif
             return RowPtr();
         }
-        RowPtr result(new Row);
+        if (!descr_.get()) {
+            descr_ = RowDescr::Ptr(new RowDescr);
+            for (size_t i = 0; i < row_.size(); ++i)
+                descr_->add_column(WIDEN(row_.get_properties(i).get_name()));
+        }
+        RowPtr result(new Row(descr_));
         int col_count = row_.size();
 #ifdef YB_SOCI_DEBUG
         cerr << "fetch(): col_count=" << col_count << endl;
 #endif
         for (int i = 0; i < col_count; ++i) {
             const soci::column_properties &props = row_.get_properties(i);
-            String name = str_to_upper(WIDEN(props.get_name()));
-            Value v;
+            Value &v = (*result)[i];
             if (row_.get_indicator(i) != soci::i_null) {
                 std::tm when;
                 unsigned long long x;
@@ -248,7 +344,6 @@ RowPtr SOCICursorBackend::fetch_row()
                 << " type=" << props.get_data_type()
                 << " value=" << NARROW(v.sql_str()) << endl;
 #endif
-            result->push_back(make_pair(name, v));
         }
         return result;
     }
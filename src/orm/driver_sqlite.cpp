@@ -5,7 +5,6 @@
 #include "util/string_utils.h"
 
 using namespace std;
-using Yb::StrUtils::str_to_upper;
 
 namespace Yb {
 
@@ -26,6 +25,9 @@ SQLiteCursorBackend::close()
         stmt_ = NULL;
         last_code_ = 0;
         exec_count_ = 0;
+        descr_ = RowDescr::Ptr();
+        real_as_text_.clear();
+        bound_.clear();
     }
 }
 
@@ -48,38 +50,87 @@ SQLiteCursorBackend::prepare(const String &sql)
         const char *err = sqlite3_errmsg(conn_);
         throw DBError(WIDEN(err));
     }
+    int col_count = sqlite3_column_count(stmt_);
+    descr_ = RowDescr::Ptr(new RowDescr);
+    real_as_text_.assign(col_count, 0);
+    for (int i = 0; i < col_count; ++i) {
+        descr_->add_column(WIDEN(sqlite3_column_name(stmt_, i)));
+        // NUMERIC affinity stores decimals as REAL, take
+        // their text form to avoid binary rounding on the way back
+        const char *decl_type = sqlite3_column_decltype(stmt_, i);
+        if (decl_type) {
+            String t = StrUtils::str_to_upper(WIDEN(decl_type));
+            if (StrUtils::starts_with(t, _T("NUMERIC"))
+                    || StrUtils::starts_with(t, _T("DECIMAL")))
+                real_as_text_[i] = 1;
+        }
+    }
+}
+
+static void
+check_bind(SQLiteDatabase *conn, int rc)
+{
+    if (SQLITE_OK != rc)
+        throw DBError(WIDEN(sqlite3_errmsg(conn)));
 }
 
 void
 SQLiteCursorBackend::exec(const Values &params)
+{
+    bind_and_step(params);
+}
+
+void
+SQLiteCursorBackend::exec_many(const std::vector<Values> &params_set)
+{
+    std::vector<Values>::const_iterator i = params_set.begin(),
+        iend = params_set.end();
+    for (; i != iend; ++i)
+        bind_and_step(*i);
+}
+
+void
+SQLiteCursorBackend::bind_and_step(const Values &params)
 {
     if (exec_count_)
         sqlite3_reset(stmt_);
     ++exec_count_;
-    vector<string> str_params(params.size());
+    // the previous buffers are not used after the reset
+    bound_.resize(params.size());
     for (size_t i = 0; i < params.size(); ++i) {
-        if (params[i].get_type() == Value::INTEGER
-                || params[i].get_type() == Value::LONGINT)
-        {
-            sqlite3_bind_int(stmt_, i + 1, params[i].as_integer());
-            if (SQLITE_OK != sqlite3_errcode(conn_)) {
-                const char *err = sqlite3_errmsg(conn_);
-                throw DBError(WIDEN(err));
-            }
-        } else if (params[i].is_null()) {
-            sqlite3_bind_null(stmt_, i + 1);
-            if (SQLITE_OK != sqlite3_errcode(conn_)) {
-                const char *err = sqlite3_errmsg(conn_);
-                throw DBError(WIDEN(err));
-            }
-        } else {
-            str_params[i] = NARROW(params[i].as_string());
-            sqlite3_bind_text(stmt_, i + 1,
-                    str_params[i].c_str(), str_params[i].size(), SQLITE_STATIC);
-            if (SQLITE_OK != sqlite3_errcode(conn_)) {
-                const char *err = sqlite3_errmsg(conn_);
-                throw DBError(WIDEN(err));
+        const Value &x = params[i];
+        int n = (int)i + 1;
+        switch (x.get_type()) {
+        case Value::INVALID:
+            check_bind(conn_, sqlite3_bind_null(stmt_, n));
+            break;
+        case Value::INTEGER:
+            check_bind(conn_, sqlite3_bind_int(stmt_, n,
+                        x.read_as_integer()));
+            break;
+        case Value::LONGINT:
+            check_bind(conn_, sqlite3_bind_int64(stmt_, n,
+                        x.read_as_longint()));
+            break;
+        case Value::FLOAT:
+            check_bind(conn_, sqlite3_bind_double(stmt_, n,
+                        x.read_as_float()));
+            break;
+        case Value::BLOB:
+            {
+                const Blob &b = x.read_as_blob();
+                bound_[i].assign(b.begin(), b.end());
+                check_bind(conn_, sqlite3_bind_blob(stmt_, n,
+                            bound_[i].data(), (int)bound_[i].size(),
+                            SQLITE_STATIC));
             }
+            break;
+        default:
+            // DECIMAL and DATETIME go as text to keep them exact
+            bound_[i] = NARROW(x.as_string());
+            check_bind(conn_, sqlite3_bind_text(stmt_, n,
+                        bound_[i].c_str(), (int)bound_[i].size(),
+                        SQLITE_STATIC));
         }
     }
     last_code_ = sqlite3_step(stmt_);
@@ -90,22 +141,62 @@ SQLiteCursorBackend::exec(const Values &params)
 
 RowPtr SQLiteCursorBackend::fetch_row()
 {
-    if (SQLITE_DONE == last_code_ || SQLITE_OK == last_code_)
+    RowPtr row(new Row);
+    if (!fetch_into(*row))
         return RowPtr();
+    return row;
+}
+
+bool SQLiteCursorBackend::fetch_into(Row &row)
+{
+    if (SQLITE_DONE == last_code_ || SQLITE_OK == last_code_)
+        return false;
     if (SQLITE_ROW != last_code_)
         throw DBError(WIDEN(sqlite3_errmsg(conn_)));
-    int col_count = sqlite3_column_count(stmt_);
-    RowPtr row(new Row(col_count));
+    if (row.descr().get() != descr_.get()) {
+        Row new_row(descr_);
+        row.swap(new_row);
+    }
+    int col_count = (int)row.size();
     for (int i = 0; i < col_count; ++i) {
-        String name = str_to_upper(WIDEN(sqlite3_column_name(stmt_, i)));
-        int type = sqlite3_column_type(stmt_, i);
-        (*row)[i].first = name;
-        if (SQLITE_NULL != type)
-            (*row)[i].second = Value(
-                    WIDEN((const char *)sqlite3_column_text(stmt_, i)));
+        Value &v = row[i];
+        // pick the accessor by the storage class of the value
+        switch (sqlite3_column_type(stmt_, i)) {
+        case SQLITE_NULL:
+            v = Value();
+            break;
+        case SQLITE_INTEGER:
+            v = Value((LongInt)sqlite3_column_int64(stmt_, i));
+            break;
+        case SQLITE_FLOAT:
+            if (!real_as_text_[i]) {
+                v = Value(sqlite3_column_double(stmt_, i));
+                break;
+            }
+            // fall through
+        case SQLITE_TEXT:
+            v = Value(WIDEN((const char *)sqlite3_column_text(stmt_, i)));
+            break;
+        default:
+            {
+                const char *p = (const char *)sqlite3_column_blob(stmt_, i);
+                int sz = sqlite3_column_bytes(stmt_, i);
+                v = Value(p? Blob(p, p + sz): Blob());
+            }
+        }
     }
     last_code_ = sqlite3_step(stmt_);
-    return row;
+    return true;
+}
+
+void
+SQLiteCursorBackend::reset()
+{
+    // release the read lock held by an unfinished statement
+    if (stmt_ && exec_count_) {
+        sqlite3_reset(stmt_);
+        last_code_ = 0;
+    }
 }
 
 SQLiteConnectionBackend::SQLiteConnectionBackend(SQLiteDriver *drv)
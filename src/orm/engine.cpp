@@ -1,8 +1,10 @@
 // -*- Mode: C++; c-basic-offset: 4; tab-width: 4; indent-tabs-mode: nil; -*-
 #define YBORM_SOURCE
 
+#include <stdio.h>
 #include <sstream>
 #include <algorithm>
+#include <deque>
 #include "util/string_utils.h"
 #include "orm/engine.h"
 #include "orm/code_gen.h"
@@ -22,15 +24,49 @@ SqlResultSet
 EngineBase::exec_select(const String &sql, const Values &params)
 {
     touch();
-    auto_ptr<SqlCursor> cursor = get_conn()->new_cursor();
-    cursor->prepare(sql);
+    auto_ptr<SqlCursor> cursor = get_conn()->get_prepared_cursor(sql);
     SqlResultSet rs = cursor->exec(params);
-    rs.own(cursor);
+    rs.own(cursor, true);
     return rs;
 }
 
+// The exact text of a parameter, as_string() rounds floats
+// to 6 digits and drops the milliseconds.
+static const String
+query_cache_param(const Value &p)
+{
+    if (p.get_type() == Value::FLOAT) {
+        char buf[40];
+        sprintf(buf, "%.17g", p.read_as_float());
+        return WIDEN(buf);
+    }
+    if (p.get_type() == Value::DATETIME)
+        return to_string(p.read_as_datetime(), true);
+    return p.as_string();
+}
+
+// Each part is prefixed with its length, so that different queries
+// can't give the same key.
+static const String
+query_cache_key(const String &sql, const Values &params)
+{
+    String key = to_string(str_length(sql)) + _T(":") + sql;
+    Values::const_iterator p = params.begin(), pend = params.end();
+    for (; p != pend; ++p) {
+        key += _T("\n") + to_string(p->get_type()) + _T(":");
+        if (p->is_null()) {
+            key += _T("NULL");
+        }
+        else {
+            String s = query_cache_param(*p);
+            key += to_string(str_length(s)) + _T(":") + s;
+        }
+    }
+    return key;
+}
+
 SqlResultSet
-EngineBase::select_iter(const Expression &select_expr)
+EngineBase::select_iter(const Expression &select_expr, bool use_cache)
 {
     SqlGeneratorOptions options(NO_QUOTES,
             get_dialect()->has_for_update(),
@@ -39,17 +75,94 @@ EngineBase::select_iter(const Expression &select_expr)
             (Yb::SqlPagerModel)get_dialect()->pager_model());
     SqlGeneratorContext ctx;
     String sql = select_expr.generate_sql(options, &ctx);
+    QueryCache *cache = query_cache();
+    Strings tables;
+    if (!use_cache || !cache ||
+            !query_cache_tables(select_expr, ctx.params_, tables))
+        return exec_select_or_reconnect(sql, ctx.params_);
+    String key = query_cache_key(sql, ctx.params_);
+    RowsPtr rows(new Rows);
+    if (cache->get(key, *rows))
+        return SqlResultSet(rows);
+    LongInt generation = cache->generation(tables);
+    SqlResultSet rs = exec_select_or_reconnect(sql, ctx.params_);
+    // read no more than the cache can hold, a bigger result
+    // is not cached and the rest of it is streamed from the cursor
+    size_t bytes = str_length(key) * sizeof(Char);
+    std::deque<Row> taken;
+    SqlResultSet::iterator i = rs.begin(), iend = rs.end();
+    // the limit is checked first, i != iend fetches the next row
+    while (bytes <= cache->max_bytes() && i != iend) {
+        taken.push_back(Row());
+        taken.back().swap(*i);
+        bytes += QueryCache::row_bytes(taken.back().values());
+        ++i;
+    }
+    rows->resize(taken.size());
+    for (size_t j = 0; j < taken.size(); ++j)
+        (*rows)[j].swap(taken[j]);
+    if (bytes > cache->max_bytes())
+        return SqlResultSet(rows, rs);
+    cache->put(key, tables, *rows, generation);
+    return SqlResultSet(rows);
+}
+
+SqlResultSet
+EngineBase::exec_select_or_reconnect(const String &sql, const Values &params)
+{
     if (get_conn()->activity())
-        return exec_select(sql, ctx.params_);
+        return exec_select(sql, params);
     MilliSec t0 = get_cur_time_millisec();
     try {
-        return exec_select(sql, ctx.params_);
+        return exec_select(sql, params);
     }
     catch (const DBError &) {
         if (get_cur_time_millisec() - t0 > 500 || !reconnect())
             throw;
-        return exec_select(sql, ctx.params_);
+        return exec_select(sql, params);
+    }
+}
+
+bool
+EngineBase::query_cache_tables(const Expression &select_expr,
+        const Values &params, Strings &tables)
+{
+    SelectExprBackend *select =
+        dynamic_cast<SelectExprBackend *>(select_expr.backend());
+    if (!select || !str_empty(select->lock_mode()))
+        return false;
+    try {
+        find_all_tables(select->from_expr(), tables);
     }
+    catch (const RunTimeError &) {
+        return false;
+    }
+    // sequence values are selected from the dual table
+    String dual = str_to_upper(get_dialect()->dual_name());
+    Strings::iterator t = tables.begin(), tend = tables.end();
+    for (; t != tend; ++t) {
+        *t = str_to_upper(*t);
+        if (str_empty(*t) || *t == dual ||
+                changed_tables_.find(*t) != changed_tables_.end())
+            return false;
+    }
+    if (tables.empty())
+        return false;
+    Values::const_iterator p = params.begin(), pend = params.end();
+    for (; p != pend; ++p)
+        if (p->get_type() == Value::BLOB)
+            return false;
+    return true;
+}
+
+void
+EngineBase::table_changed(const Table &table)
+{
+    QueryCache *cache = query_cache();
+    if (!cache)
+        return;
+    cache->invalidate(table.name());
+    changed_tables_.insert(str_to_upper(table.name()));
 }
 
 RowsPtr
@@ -61,13 +174,23 @@ EngineBase::select(const Expression &what,
     Expression select = SelectExpr(what).from_(from).
             where_(where).group_by_(group_by).having_(having).
             order_by_(order_by).for_update(for_update).add_aliases();
-    SqlResultSet rs = select_iter(select);
+    // a result cut short is not worth caching
+    SqlResultSet rs = select_iter(select, max_rows < 0);
     RowsPtr rows(new Rows);
-    copy_no_more_than_n(rs.begin(), rs.end(), max_rows,
-            back_inserter(*rows));
+    swap_no_more_than_n(rs, max_rows, *rows);
     return rows;
 }
 
+static void
+fill_params(Values &params, size_t offset, const ParamNums &param_nums,
+        const Table &table, const Values &row)
+{
+    ParamNums::const_iterator f = param_nums.begin(),
+        fend = param_nums.end();
+    for (; f != fend; ++f)
+        params[offset + f->second] = row[table.idx_by_name(f->first)];
+}
+
 const vector<LongInt>
 EngineBase::insert(const Table &table, const RowsData &rows,
         bool collect_new_ids)
@@ -79,38 +202,92 @@ EngineBase::insert(const Table &table, const RowsData &rows,
     if (!rows.size())
         return ids;
     touch();
+    table_changed(table);
     String sql;
     TypeCodes type_codes;
     ParamNums param_nums;
     gen_sql_insert(sql, type_codes, param_nums, table,
             !collect_new_ids, get_conn()->get_driver()->numbered_params());
+    bool returning = collect_new_ids &&
+        get_dialect()->returning_model(*get_conn()) != RETURNING_NONE;
+    if (!collect_new_ids || returning) {
+        // the order of the ids returned for a multi-row INSERT is not
+        // guaranteed, so there is one row per statement when collecting
+        size_t batch_size = 1;
+        if (!returning && rows.size() > 1 && type_codes.size() &&
+                get_dialect()->insert_model() != INSERT_SINGLE_ROW)
+        {
+            batch_size = get_dialect()->max_params() / type_codes.size();
+            if (batch_size > (size_t)get_dialect()->max_insert_rows())
+                batch_size = get_dialect()->max_insert_rows();
+            if (batch_size > rows.size())
+                batch_size = rows.size();
+            if (batch_size < 1)
+                batch_size = 1;
+        }
+        RowsData::const_iterator r = rows.begin();
+        vector<LongInt> *new_ids = returning? &ids: NULL;
+        insert_chunks(table, r, rows.size() / batch_size, batch_size,
+                new_ids);
+        insert_chunks(table, r, 1, rows.size() % batch_size, new_ids);
+        return ids;
+    }
     Values params(type_codes.size());
-    auto_ptr<SqlCursor> cursor = get_conn()->new_cursor();
-    cursor->prepare(sql);
+    auto_ptr<SqlCursor> cursor = get_conn()->get_prepared_cursor(sql);
     cursor->bind_params(type_codes);
-    auto_ptr<SqlCursor> cursor2;
-    if (collect_new_ids)
-        cursor2.reset(get_conn()->new_cursor().release());
+    auto_ptr<SqlCursor> cursor2 = get_conn()->get_prepared_cursor(
+            get_dialect()->select_last_inserted_id(table.name()));
     RowsData::const_iterator r = rows.begin(), rend = rows.end();
     for (; r != rend; ++r) {
-        ParamNums::const_iterator f = param_nums.begin(),
-            fend = param_nums.end();
-        for (; f != fend; ++f)
-            params[f->second] = (**r)[table.idx_by_name(f->first)];
+        fill_params(params, 0, param_nums, table, **r);
         cursor->exec(params);
-        if (collect_new_ids) {
-            cursor2->prepare(get_dialect()->
-                    select_last_inserted_id(table.name()));
-            cursor2->exec(Values());
-            RowsPtr id_rows = cursor2->fetch_rows();
-            ids.push_back((*id_rows)[0][0].second.as_longint());
-        }
+        cursor2->exec(Values());
+        RowsPtr id_rows = cursor2->fetch_rows();
+        ids.push_back((*id_rows)[0][0].as_longint());
     }
+    get_conn()->put_prepared_cursor(cursor);
+    get_conn()->put_prepared_cursor(cursor2);
     return ids;
 }
 
 void
-EngineBase::update(const Table &table, const RowsData &rows)
+EngineBase::insert_chunks(const Table &table, RowsData::const_iterator &r,
+        size_t chunk_count, size_t chunk_size, vector<LongInt> *new_ids)
+{
+    if (!chunk_count || !chunk_size)
+        return;
+    String sql;
+    TypeCodes type_codes;
+    ParamNums param_nums;
+    gen_sql_insert(sql, type_codes, param_nums, table, !new_ids,
+            get_conn()->get_driver()->numbered_params(), chunk_size,
+            (SqlInsertModel)get_dialect()->insert_model(),
+            new_ids? (SqlReturningModel)get_dialect()->returning_model(
+                    *get_conn()): RETURNING_NONE);
+    size_t width = type_codes.size() / chunk_size;
+    std::vector<Values> params_set(chunk_count, Values(type_codes.size()));
+    for (size_t i = 0; i < chunk_count; ++i)
+        for (size_t k = 0; k < chunk_size; ++k, ++r)
+            fill_params(params_set[i], k * width, param_nums, table, **r);
+    auto_ptr<SqlCursor> cursor = get_conn()->get_prepared_cursor(sql);
+    cursor->bind_params(type_codes);
+    if (!new_ids)
+        cursor->exec_many(params_set);
+    else {
+        YB_ASSERT(chunk_size == 1);
+        for (size_t i = 0; i < chunk_count; ++i) {
+            cursor->exec(params_set[i]);
+            RowsPtr id_rows = cursor->fetch_rows();
+            YB_ASSERT(id_rows->size() == 1);
+            new_ids->push_back((*id_rows)[0][0].as_longint());
+        }
+    }
+    get_conn()->put_prepared_cursor(cursor);
+}
+
+void
+EngineBase::update(const Table &table, const RowsData &rows,
+        const ColumnMask *columns)
 {
     if (get_mode() == READ_ONLY)
         throw BadOperationInMode(
@@ -118,27 +295,33 @@ EngineBase::update(const Table &table, const RowsData &rows)
     if (!rows.size())
         return;
     touch();
-    String sql;
-    TypeCodes type_codes;
-    ParamNums param_nums;
-    SqlGeneratorOptions options(NO_QUOTES,
-            get_dialect()->has_for_update(),
-            true,
-            get_conn()->get_driver()->numbered_params(),
-            (Yb::SqlPagerModel)get_dialect()->pager_model());
-    gen_sql_update(sql, type_codes, param_nums, table, options);
-    auto_ptr<SqlCursor> cursor = get_conn()->new_cursor();
-    cursor->prepare(sql);
-    cursor->bind_params(type_codes);
-    Values params(type_codes.size());
-    RowsData::const_iterator r = rows.begin(), rend = rows.end();
-    for (; r != rend; ++r) {
-        ParamNums::const_iterator f = param_nums.begin(),
-            fend = param_nums.end();
-        for (; f != fend; ++f)
-            params[f->second] = (**r)[table.idx_by_name(f->first)];
-        cursor->exec(params);
+    table_changed(table);
+    std::pair<String, ColumnMask> cache_key(table.name(),
+            columns? *columns: ColumnMask());
+    UpdateSqlCache::iterator u = update_sql_cache_.find(cache_key);
+    if (u == update_sql_cache_.end()) {
+        SqlGeneratorOptions options(NO_QUOTES,
+                get_dialect()->has_for_update(),
+                true,
+                get_conn()->get_driver()->numbered_params(),
+                (Yb::SqlPagerModel)get_dialect()->pager_model());
+        UpdateSql update_sql;
+        gen_sql_update(update_sql.sql, update_sql.type_codes,
+                update_sql.param_nums, table, options, columns);
+        u = update_sql_cache_.insert(
+                std::make_pair(cache_key, update_sql)).first;
     }
+    const UpdateSql &update_sql = u->second;
+    auto_ptr<SqlCursor> cursor =
+        get_conn()->get_prepared_cursor(update_sql.sql);
+    cursor->bind_params(update_sql.type_codes);
+    std::vector<Values> params_set(rows.size(),
+            Values(update_sql.type_codes.size()));
+    for (size_t i = 0; i < rows.size(); ++i)
+        fill_params(params_set[i], 0, update_sql.param_nums,
+                table, *rows[i]);
+    cursor->exec_many(params_set);
+    get_conn()->put_prepared_cursor(cursor);
 }
 
 void
@@ -150,6 +333,28 @@ EngineBase::delete_from(const Table &table, const Keys &keys)
     if (!keys.size())
         return;
     touch();
+    table_changed(table);
+    size_t batch_size = 1;
+    if (keys.size() > 1 && table.pk_fields().size()) {
+        batch_size = get_dialect()->max_params() / table.pk_fields().size();
+        if (batch_size > (size_t)get_dialect()->max_in_list())
+            batch_size = get_dialect()->max_in_list();
+        if (batch_size > keys.size())
+            batch_size = keys.size();
+        if (batch_size < 1)
+            batch_size = 1;
+    }
+    Keys::const_iterator k = keys.begin();
+    delete_chunks(table, k, keys.size() / batch_size, batch_size);
+    delete_chunks(table, k, 1, keys.size() % batch_size);
+}
+
+void
+EngineBase::delete_chunks(const Table &table, Keys::const_iterator &k,
+        size_t chunk_count, size_t chunk_size)
+{
+    if (!chunk_count || !chunk_size)
+        return;
     String sql;
     TypeCodes type_codes;
     SqlGeneratorOptions options(NO_QUOTES,
@@ -157,20 +362,22 @@ EngineBase::delete_from(const Table &table, const Keys &keys)
             true,
             get_conn()->get_driver()->numbered_params(),
             (Yb::SqlPagerModel)get_dialect()->pager_model());
-    gen_sql_delete(sql, type_codes, table, options);
-    auto_ptr<SqlCursor> cursor = get_conn()->new_cursor();
-    cursor->prepare(sql);
-    cursor->bind_params(type_codes);
-    Values params(type_codes.size());
-    Keys::const_iterator k = keys.begin(), kend = keys.end();
-    for (; k != kend; ++k) {
-        if (k->id_name)
-            params[0] = k->id_value;
-        else
-            for (size_t i = 0; i < k->fields.size(); ++i)
-                params[i] = k->fields[i].second;
-        cursor->exec(params);
+    gen_sql_delete(sql, type_codes, table, options, chunk_size);
+    std::vector<Values> params_set(chunk_count, Values(type_codes.size()));
+    for (size_t j = 0; j < chunk_count; ++j) {
+        size_t pos = 0;
+        for (size_t n = 0; n < chunk_size; ++n, ++k) {
+            if (k->id_name)
+                params_set[j][pos++] = k->id_value;
+            else
+                for (size_t i = 0; i < k->fields.size(); ++i)
+                    params_set[j][pos++] = k->fields[i].second;
+        }
     }
+    auto_ptr<SqlCursor> cursor = get_conn()->get_prepared_cursor(sql);
+    cursor->bind_params(type_codes);
+    cursor->exec_many(params_set);
+    get_conn()->put_prepared_cursor(cursor);
 }
 
 void
@@ -202,7 +409,7 @@ EngineBase::select1(const Expression &what,
     RowPtr row = select_row(what, from, where);
     if (row->size() != 1)
         throw BadSQLOperation(_T("Unable to fetch exactly one column!"));
-    return row->begin()->second;
+    return (*row)[0];
 }
 
 LongInt
@@ -219,12 +426,34 @@ EngineBase::get_next_value(const String &seq_name)
             Expression(get_dialect()->dual_name()), Expression()).as_longint();
 }
 
+IdAllocator *EngineBase::id_allocator() { return NULL; }
+EntityCache *EngineBase::entity_cache() { return NULL; }
+QueryCache *EngineBase::query_cache() { return NULL; }
+
+LongInt
+EngineBase::get_next_id(const Table &table)
+{
+    IdAllocator *allocator = id_allocator();
+    if (allocator)
+        return allocator->next_id(*this, table);
+    return get_next_value(table.seq_name());
+}
+
 void
 EngineBase::commit()
 {
     //if (logger())
     //    logger()->debug("engine: commit");
     get_conn()->commit();
+    // drop what has been read by others before the changes got visible
+    QueryCache *cache = query_cache();
+    if (cache) {
+        std::set<String>::const_iterator t = changed_tables_.begin(),
+            tend = changed_tables_.end();
+        for (; t != tend; ++t)
+            cache->invalidate(*t);
+    }
+    changed_tables_.clear();
 }
 
 void
@@ -233,6 +462,7 @@ EngineBase::rollback()
     //if (logger())
     //    logger()->debug("engine: rollback");
     get_conn()->rollback();
+    changed_tables_.clear();
 }
 
 void
@@ -316,44 +546,68 @@ EngineBase::drop_schema(const Schema &schema, bool ignore_errors)
 void
 EngineBase::gen_sql_insert(String &sql, TypeCodes &type_codes_out,
         ParamNums &param_nums_out, const Table &table,
-        bool include_pk, bool numbered_params)
+        bool include_pk, bool numbered_params,
+        int row_count, SqlInsertModel insert_model,
+        SqlReturningModel returning_model)
 {
-    int count = 1, *pcount = NULL;
-    if (numbered_params)
-        pcount = &count;
-    String sql_query;
-    sql_query = _T("INSERT INTO ") + table.name() + _T(" (");
+    YB_ASSERT(row_count == 1 ||
+            (row_count > 1 && insert_model != INSERT_SINGLE_ROW));
+    YB_ASSERT(returning_model == RETURNING_NONE ||
+            insert_model != INSERT_ALL);
+    int count = 1;
     TypeCodes type_codes;
-    type_codes.reserve(table.size());
     ParamNums param_nums;
-    Strings names, pholders;
+    Strings names;
     size_t i;
     for (i = 0; i < table.size(); ++i) {
         const Column &col = table[i];
         if ((!col.is_ro() || col.is_pk()) &&
                 (!col.is_pk() || include_pk))
         {
-            if (pcount)
-                pholders.push_back(_T(":") + to_string(count));
-            else
-                pholders.push_back(_T("?"));
-            ++count;
             param_nums[col.name()] = type_codes.size();
             type_codes.push_back(col.type());
             names.push_back(col.name());
         }
     }
-    sql_query += ExpressionList(names).get_sql() + _T(") VALUES (") +
-        ExpressionList(pholders).get_sql() + _T(")");
+    String into = table.name() + _T(" (") +
+        ExpressionList(names).get_sql() + _T(")");
+    // param_nums hold the positions within a row, rows follow each other
+    TypeCodes all_type_codes;
+    all_type_codes.reserve(type_codes.size() * row_count);
+    String sql_query;
+    if (insert_model == INSERT_ALL)
+        sql_query = _T("INSERT ALL");
+    else
+        sql_query = _T("INSERT INTO ") + into + _T(" VALUES");
+    for (int r = 0; r < row_count; ++r) {
+        Strings pholders;
+        for (i = 0; i < type_codes.size(); ++i, ++count) {
+            if (numbered_params)
+                pholders.push_back(_T(":") + to_string(count));
+            else
+                pholders.push_back(_T("?"));
+        }
+        all_type_codes.insert(all_type_codes.end(),
+                type_codes.begin(), type_codes.end());
+        if (insert_model == INSERT_ALL)
+            sql_query += _T(" INTO ") + into + _T(" VALUES");
+        else if (r)
+            sql_query += _T(",");
+        sql_query += _T(" (") + ExpressionList(pholders).get_sql() + _T(")");
+    }
+    if (insert_model == INSERT_ALL)
+        sql_query += _T(" SELECT * FROM DUAL");
+    else if (returning_model == RETURNING_CLAUSE)
+        sql_query += _T(" RETURNING ") + table.get_surrogate_pk();
     str_swap(sql, sql_query);
-    type_codes_out.swap(type_codes);
+    type_codes_out.swap(all_type_codes);
     param_nums_out.swap(param_nums);
 }
 
 void
 EngineBase::gen_sql_update(String &sql, TypeCodes &type_codes_out,
         ParamNums &param_nums_out, const Table &table,
-        const SqlGeneratorOptions &options)
+        const SqlGeneratorOptions &options, const ColumnMask *columns)
 {
     if (!table.pk_fields().size())
         throw BadSQLOperation(_T("cannot build update statement: no key in table"));
@@ -362,10 +616,19 @@ EngineBase::gen_sql_update(String &sql, TypeCodes &type_codes_out,
     TypeCodes type_codes;
     type_codes.reserve(table.size());
     ParamNums param_nums;
+    bool all_columns = true;
     size_t i;
+    if (columns && !columns->empty()) {
+        YB_ASSERT(columns->size() == table.size());
+        for (i = 0; i < table.size() && all_columns; ++i)
+            if ((*columns)[i] && !table[i].is_pk() && !table[i].is_ro())
+                all_columns = false;
+    }
     for (i = 0; i < table.size(); ++i) {
         const Column &col = table[i];
-        if (!col.is_pk() && !col.is_ro()) {
+        if (!col.is_pk() && !col.is_ro() &&
+                (all_columns || (*columns)[i]))
+        {
             if (!type_codes.empty())
                 sql_query += _T(", ");
             sql_query += col.name() + _T(" = ");
@@ -394,21 +657,392 @@ EngineBase::gen_sql_update(String &sql, TypeCodes &type_codes_out,
 
 void
 EngineBase::gen_sql_delete(String &sql, TypeCodes &type_codes_out,
-        const Table &table, const SqlGeneratorOptions &options)
+        const Table &table, const SqlGeneratorOptions &options,
+        int key_count)
 {
     if (!table.pk_fields().size())
         throw BadSQLOperation(_T("cannot build update statement: no key in table"));
     SqlGeneratorContext ctx;
     String sql_query = _T("DELETE FROM ") + table.name();
     TypeCodes type_codes;
-    Key sample_key;
-    table.mk_sample_key(type_codes, sample_key);
+    Keys sample_keys(key_count);
+    for (int i = 0; i < key_count; ++i)
+        table.mk_sample_key(type_codes, sample_keys[i]);
     sql_query += _T(" WHERE ")
-        + KeyFilter(sample_key).generate_sql(options, &ctx);
+        + filter_by_keys(sample_keys).generate_sql(options, &ctx);
     type_codes_out.swap(type_codes);
     str_swap(sql, sql_query);
 }
 
+IdAllocator::~IdAllocator() {}
+
+LongInt
+BlockIdAllocator::fetch_block(EngineBase &engine,
+        const String &seq_name, int increment)
+{
+    SqlDialect *dialect = engine.get_dialect();
+    return engine.select1(
+            Expression(dialect->select_next_block(seq_name, increment)),
+            Expression(dialect->dual_name()), Expression()).as_longint();
+}
+
+BlockIdAllocator::BlockIdAllocator()
+    : fetched_(mux_)
+{}
+
+LongInt
+BlockIdAllocator::next_id(EngineBase &engine, const Table &table)
+{
+    const String &seq_name = table.seq_name();
+    int increment = table.seq_increment();
+    {
+        ScopedLock lock(mux_);
+        // only the users of the same sequence wait for its fetch,
+        // the block is looked up again as reset() may drop it
+        while (blocks_[seq_name].next_ >= blocks_[seq_name].end_ &&
+                blocks_[seq_name].fetching_)
+            fetched_.wait(lock);
+        Block &block = blocks_[seq_name];
+        if (block.next_ < block.end_)
+            return block.next_++;
+        block.fetching_ = true;
+    }
+    // the database round-trip is made with the mutex released
+    LongInt first;
+    try {
+        first = fetch_block(engine, seq_name, increment);
+    }
+    catch (...) {
+        ScopedLock lock(mux_);
+        blocks_[seq_name].fetching_ = false;
+        fetched_.notify_all();
+        throw;
+    }
+    ScopedLock lock(mux_);
+    // sequence values are not transactional, so the block
+    // survives a rollback of the current session
+    Block &block = blocks_[seq_name];
+    block.next_ = first;
+    block.end_ = first + increment;
+    block.fetching_ = false;
+    fetched_.notify_all();
+    return block.next_++;
+}
+
+void
+BlockIdAllocator::reset()
+{
+    ScopedLock lock(mux_);
+    blocks_.clear();
+}
+
+EntityCache::EntityCache(size_t max_entries)
+    : max_entries_(max_entries)
+    , size_(0)
+    , last_purge_(0)
+{}
+
+void
+EntityCache::erase(TableCache &tc, Entries::iterator e)
+{
+    lru_.erase(e->second.lru_pos);
+    tc.entries.erase(e);
+    --size_;
+}
+
+void
+EntityCache::make_room()
+{
+    // a full scan for the expired rows at most once a second,
+    // a cache kept full by fresh rows is served by the LRU order
+    time_t now = time(NULL);
+    if (now != last_purge_) {
+        last_purge_ = now;
+        TableCaches::iterator t = tables_.begin(), tend = tables_.end();
+        for (; t != tend; ++t) {
+            Entries::iterator e = t->second.entries.begin(),
+                eend = t->second.entries.end();
+            while (e != eend) {
+                Entries::iterator cur = e++;
+                if (cur->second.expires_at && cur->second.expires_at <= now)
+                    erase(t->second, cur);
+            }
+        }
+    }
+    while (size_ >= max_entries_ && !lru_.empty()) {
+        TableCache &tc = tables_[lru_.back().first];
+        erase(tc, tc.entries.find(lru_.back().second));
+        ++stats_.evictions;
+    }
+}
+
+LongInt
+EntityCache::generation(const Table &table)
+{
+    ScopedLock lock(mux_);
+    return tables_[table.name()].generation;
+}
+
+bool
+EntityCache::get(const Table &table, const Key &key, Values &values)
+{
+    String key_str = key2str(key);
+    ScopedLock lock(mux_);
+    TableCaches::iterator t = tables_.find(table.name());
+    if (t != tables_.end()) {
+        Entries::iterator e = t->second.entries.find(key_str);
+        if (e != t->second.entries.end()) {
+            if (!e->second.expires_at || e->second.expires_at > time(NULL)) {
+                ++stats_.hits;
+                lru_.splice(lru_.begin(), lru_, e->second.lru_pos);
+                // a copy, the cached snapshot is never handed out
+                values = e->second.values;
+                return true;
+            }
+            erase(t->second, e);
+        }
+    }
+    ++stats_.misses;
+    return false;
+}
+
+void
+EntityCache::put(const Table &table, const Key &key, const Values &values,
+        LongInt generation)
+{
+    String key_str = key2str(key);
+    ScopedLock lock(mux_);
+    TableCache &tc = tables_[table.name()];
+    if (tc.generation != generation)
+        return;
+    if (!max_entries_)
+        return;
+    Entries::iterator i = tc.entries.find(key_str);
+    if (i == tc.entries.end()) {
+        if (size_ >= max_entries_)
+            make_room();
+        i = tc.entries.insert(std::make_pair(key_str, Entry())).first;
+        lru_.push_front(std::make_pair(table.name(), key_str));
+        i->second.lru_pos = lru_.begin();
+        ++size_;
+    }
+    else
+        lru_.splice(lru_.begin(), lru_, i->second.lru_pos);
+    Entry &e = i->second;
+    e.values = values;
+    e.expires_at = table.cache_ttl()? time(NULL) + table.cache_ttl(): 0;
+    ++stats_.puts;
+}
+
+void
+EntityCache::invalidate(const String &table_name)
+{
+    ScopedLock lock(mux_);
+    TableCache &tc = tables_[table_name];
+    ++tc.generation;
+    Entries::iterator e = tc.entries.begin(), eend = tc.entries.end();
+    for (; e != eend; ++e)
+        lru_.erase(e->second.lru_pos);
+    size_ -= tc.entries.size();
+    tc.entries.clear();
+    ++stats_.invalidations;
+}
+
+void
+EntityCache::clear()
+{
+    ScopedLock lock(mux_);
+    TableCaches::iterator t = tables_.begin(), tend = tables_.end();
+    for (; t != tend; ++t) {
+        ++t->second.generation;
+        t->second.entries.clear();
+    }
+    lru_.clear();
+    size_ = 0;
+}
+
+size_t
+EntityCache::size()
+{
+    ScopedLock lock(mux_);
+    return size_;
+}
+
+const EntityCacheStats
+EntityCache::get_stats()
+{
+    ScopedLock lock(mux_);
+    return stats_;
+}
+
+QueryCache::QueryCache(size_t max_bytes)
+    : max_bytes_(max_bytes)
+    , bytes_(0)
+{}
+
+void
+QueryCache::erase(Entries::iterator e)
+{
+    Strings::const_iterator t = e->tables.begin(), tend = e->tables.end();
+    for (; t != tend; ++t)
+        keys_by_table_[*t].erase(e->key);
+    index_.erase(e->key);
+    bytes_ -= e->bytes;
+    entries_.erase(e);
+}
+
+size_t
+QueryCache::row_bytes(const Values &values)
+{
+    size_t bytes = 0;
+    Values::const_iterator v = values.begin(), vend = values.end();
+    for (; v != vend; ++v) {
+        bytes += sizeof(Value);
+        if (v->get_type() == Value::STRING)
+            bytes += v->read_as_string().size() * sizeof(Char);
+        else if (v->get_type() == Value::BLOB)
+            bytes += v->read_as_blob().size();
+    }
+    return bytes;
+}
+
+LongInt
+QueryCache::generation(const Strings &tables)
+{
+    // generations only grow, so does their sum
+    LongInt sum = 0;
+    ScopedLock lock(mux_);
+    Strings::const_iterator t = tables.begin(), tend = tables.end();
+    for (; t != tend; ++t)
+        sum += generations_[str_to_upper(*t)];
+    return sum;
+}
+
+bool
+QueryCache::get(const String &key, Rows &rows)
+{
+    ScopedLock lock(mux_);
+    std::map<String, Entries::iterator>::iterator i = index_.find(key);
+    if (i == index_.end()) {
+        ++stats_.misses;
+        return false;
+    }
+    ++stats_.hits;
+    entries_.splice(entries_.begin(), entries_, i->second);
+    const Entry &e = *i->second;
+    // a copy with its own descriptor, nothing cached is handed out
+    RowDescr::Ptr descr(new RowDescr);
+    Strings::const_iterator n = e.names.begin(), nend = e.names.end();
+    for (; n != nend; ++n)
+        descr->add_column(*n);
+    rows.clear();
+    rows.reserve(e.rows.size());
+    std::vector<Values>::const_iterator r = e.rows.begin(),
+        rend = e.rows.end();
+    for (; r != rend; ++r) {
+        rows.push_back(Row(descr));
+        rows.back().values() = *r;
+    }
+    return true;
+}
+
+void
+QueryCache::put(const String &key, const Strings &tables, const Rows &rows,
+        LongInt generation)
+{
+    size_t bytes = sizeof(Entry) + key.size() * sizeof(Char);
+    Rows::const_iterator r = rows.begin(), rend = rows.end();
+    for (; r != rend && bytes <= max_bytes_; ++r)
+        bytes += row_bytes(r->values());
+    if (bytes > max_bytes_)
+        return;
+    // the entry is built in a list of its own to be spliced in, not copied
+    Entries added(1);
+    Entry &entry = added.front();
+    entry.key = key;
+    entry.bytes = bytes;
+    Strings::const_iterator t = tables.begin(), tend = tables.end();
+    for (; t != tend; ++t)
+        entry.tables.push_back(str_to_upper(*t));
+    if (rows.size() && rows[0].descr().get())
+        for (size_t i = 0; i < rows[0].size(); ++i)
+            entry.names.push_back(rows[0].name(i));
+    entry.rows.reserve(rows.size());
+    for (r = rows.begin(); r != rend; ++r)
+        entry.rows.push_back(r->values());
+    ScopedLock lock(mux_);
+    LongInt sum = 0;
+    for (t = entry.tables.begin(), tend = entry.tables.end(); t != tend; ++t)
+        sum += generations_[*t];
+    if (sum != generation)
+        return;
+    std::map<String, Entries::iterator>::iterator i = index_.find(key);
+    if (i != index_.end())
+        erase(i->second);
+    while (bytes_ + entry.bytes > max_bytes_ && entries_.size()) {
+        erase(--entries_.end());
+        ++stats_.evictions;
+    }
+    entries_.splice(entries_.begin(), added);
+    index_[key] = entries_.begin();
+    for (t = entry.tables.begin(), tend = entry.tables.end(); t != tend; ++t)
+        keys_by_table_[*t].insert(key);
+    bytes_ += entry.bytes;
+    ++stats_.puts;
+}
+
+void
+QueryCache::invalidate(const String &table_name)
+{
+    String name = str_to_upper(table_name);
+    ScopedLock lock(mux_);
+    ++generations_[name];
+    std::set<String> keys;
+    keys.swap(keys_by_table_[name]);
+    std::set<String>::const_iterator k = keys.begin(), kend = keys.end();
+    for (; k != kend; ++k) {
+        std::map<String, Entries::iterator>::iterator i = index_.find(*k);
+        if (i != index_.end())
+            erase(i->second);
+    }
+    ++stats_.invalidations;
+}
+
+void
+QueryCache::clear()
+{
+    ScopedLock lock(mux_);
+    std::map<String, LongInt>::iterator g = generations_.begin(),
+        gend = generations_.end();
+    for (; g != gend; ++g)
+        ++g->second;
+    entries_.clear();
+    index_.clear();
+    keys_by_table_.clear();
+    bytes_ = 0;
+}
+
+size_t
+QueryCache::size()
+{
+    ScopedLock lock(mux_);
+    return entries_.size();
+}
+
+size_t
+QueryCache::bytes()
+{
+    ScopedLock lock(mux_);
+    return bytes_;
+}
+
+const QueryCacheStats
+QueryCache::get_stats()
+{
+    ScopedLock lock(mux_);
+    return stats_;
+}
+
 EngineCloned::~EngineCloned()
 {
     if (pool_)
@@ -416,6 +1050,9 @@ EngineCloned::~EngineCloned()
 }
 
 int EngineCloned::get_mode() { return mode_; }
+IdAllocator *EngineCloned::id_allocator() { return id_allocator_; }
+EntityCache *EngineCloned::entity_cache() { return entity_cache_; }
+QueryCache *EngineCloned::query_cache() { return query_cache_; }
 SqlConnection *EngineCloned::get_conn() { return conn_; }
 
 bool EngineCloned::reconnect()
@@ -475,6 +1112,7 @@ Engine::Engine(int mode)
     , conn_(new SqlConnection(sql_source_from_env()))
     , dialect_(conn_->get_dialect())
     , conn_ptr_(NULL)
+    , id_allocator_(new BlockIdAllocator)
 {}
 
 Engine::Engine(int mode, auto_ptr<SqlConnection> conn)
@@ -484,6 +1122,7 @@ Engine::Engine(int mode, auto_ptr<SqlConnection> conn)
     , conn_(conn)
     , dialect_(conn_->get_dialect())
     , conn_ptr_(NULL)
+    , id_allocator_(new BlockIdAllocator)
 {}
 
 Engine::Engine(int mode, auto_ptr<SqlPool> pool,
@@ -495,6 +1134,7 @@ Engine::Engine(int mode, auto_ptr<SqlPool> pool,
     , timeout_(timeout)
     , dialect_(NULL)
     , conn_ptr_(NULL)
+    , id_allocator_(new BlockIdAllocator)
 {}
 
 Engine::~Engine()
@@ -504,6 +1144,26 @@ Engine::~Engine()
 }
 
 int Engine::get_mode() { return mode_; }
+IdAllocator *Engine::id_allocator() { return id_allocator_.get(); }
+
+void Engine::set_id_allocator(auto_ptr<IdAllocator> id_allocator)
+{
+    id_allocator_ = id_allocator;
+}
+
+EntityCache *Engine::entity_cache() { return entity_cache_.get(); }
+
+void Engine::set_entity_cache(auto_ptr<EntityCache> entity_cache)
+{
+    entity_cache_ = entity_cache;
+}
+
+QueryCache *Engine::query_cache() { return query_cache_.get(); }
+
+void Engine::set_query_cache(auto_ptr<QueryCache> query_cache)
+{
+    query_cache_ = query_cache;
+}
 
 SqlConnection *Engine::get_conn()
 {
@@ -529,10 +1189,14 @@ auto_ptr<EngineCloned> Engine::clone()
 {
     if (conn_.get())
         return auto_ptr<EngineCloned>(new EngineCloned(
-                    mode_, conn_.get(), dialect_, logger_.get()));
+                    mode_, conn_.get(), dialect_, logger_.get(),
+                    NULL, id_allocator_.get(), entity_cache_.get(),
+                    query_cache_.get()));
     SqlConnection *conn = get_from_pool();
     return auto_ptr<EngineCloned>(new EngineCloned(
-                mode_, conn, dialect_, logger_.get(), pool_.get()));
+                mode_, conn, dialect_, logger_.get(), pool_.get(),
+                id_allocator_.get(), entity_cache_.get(),
+                query_cache_.get()));
 }
 
 void Engine::set_echo(bool echo)
@@ -557,7 +1221,10 @@ SqlConnection *Engine::get_from_pool()
 {
     if (!pool_.get())
         throw PoolError(_T("Engine with no connection"));
-    SqlConnection *conn = pool_->get(source_id_, timeout_);
+    // read-only engines are served by replicas, if there are any
+    SqlConnection *conn = mode_ == READ_ONLY?
+        pool_->get_for_read(source_id_, timeout_):
+        pool_->get(source_id_, timeout_);
     if (!conn)
         throw PoolError(_T("Can't get connection"));
     dialect_ = conn->get_dialect();
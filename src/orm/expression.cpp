@@ -1043,6 +1043,41 @@ KeyFilter::expr()
     return checked_dynamic_cast<FilterBackendByPK *>(backend_.get())->expr();
 }
 
+// OR the filters in a balanced tree to keep the nesting depth
+// of the generated SQL logarithmic in the number of keys
+static const Expression
+or_key_filters(Keys::const_iterator begin, Keys::const_iterator end)
+{
+    if (end - begin == 1)
+        return KeyFilter(*begin);
+    Keys::const_iterator middle = begin + (end - begin) / 2;
+    return or_key_filters(begin, middle) || or_key_filters(middle, end);
+}
+
+YBORM_DECL const Expression
+filter_by_keys(const Keys &keys)
+{
+    YB_ASSERT(!keys.empty());
+    if (keys.size() == 1)
+        return KeyFilter(keys[0]);
+    const Key &key0 = keys[0];
+    if (key0.id_name) {
+        ExpressionList ids;
+        Keys::const_iterator i = keys.begin(), iend = keys.end();
+        for (; i != iend; ++i)
+            ids << ConstExpr(Value(i->id_value));
+        return ColumnExpr(*key0.table, *key0.id_name).in_(ids);
+    }
+    if (key0.fields.size() == 1) {
+        ExpressionList values;
+        Keys::const_iterator i = keys.begin(), iend = keys.end();
+        for (; i != iend; ++i)
+            values << ConstExpr(i->fields[0].second);
+        return ColumnExpr(*key0.table, *key0.fields[0].first).in_(values);
+    }
+    return or_key_filters(keys.begin(), keys.end());
+}
+
 YBORM_DECL void
 find_all_tables(const Expression &expr, Strings &tables)
 {
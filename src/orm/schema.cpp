@@ -134,6 +134,10 @@ Table::Table(const String &name, const String &xml_name,
     : name_(name)
     , xml_name_(mk_xml_name(name, xml_name))
     , class_name_(class_name)
+    , seq_increment_(1)
+    , batch_size_(1)
+    , cache_mode_(NoCache)
+    , cache_ttl_(0)
     , autoinc_(false)
     , depth_(0)
     , schema_(NULL)
@@ -178,6 +182,37 @@ Table::set_seq_name(const String &seq_name)
     seq_name_ = seq_name;
 }
 
+void
+Table::set_seq_increment(int seq_increment)
+{
+    if (seq_increment < 1)
+        throw MetaDataError(_T("Invalid sequence increment for table '")
+                + name() + _T("': ") + to_string(seq_increment));
+    seq_increment_ = seq_increment;
+}
+
+void
+Table::set_batch_size(int batch_size)
+{
+    if (batch_size < 1)
+        throw MetaDataError(_T("Invalid batch size for table '")
+                + name() + _T("': ") + to_string(batch_size));
+    batch_size_ = batch_size;
+}
+
+void
+Table::set_cache(int cache_mode, int cache_ttl)
+{
+    if (cache_mode < NoCache || cache_mode > ReadWriteCache)
+        throw MetaDataError(_T("Invalid cache mode for table '")
+                + name() + _T("': ") + to_string(cache_mode));
+    if (cache_ttl < 0)
+        throw MetaDataError(_T("Invalid cache ttl for table '")
+                + name() + _T("': ") + to_string(cache_ttl));
+    cache_mode_ = cache_mode;
+    cache_ttl_ = cache_ttl;
+}
+
 const String &
 Table::get_surrogate_pk() const
 {
@@ -276,7 +311,7 @@ Table::mk_key(const Row &row_values, Key &key) const
         const String &pk_name = pk_fields()[0];
         int col_type = column(pk_name).type();
         if (col_type == Value::INTEGER || col_type == Value::LONGINT) {
-            const Value &x = row_values[idx_by_name(pk_name)].second;
+            const Value &x = row_values[idx_by_name(pk_name)];
             key.reset(&name(), &pk_name,
                       x.is_null()? 0: x.as_longint(), x.is_null());
             return !x.is_null();
@@ -288,7 +323,7 @@ Table::mk_key(const Row &row_values, Key &key) const
     key_values.reserve(pk_fields().size());
     Strings::const_iterator i = pk_fields().begin(), iend = pk_fields().end();
     for (; i != iend; ++i) {
-        const Value &x = row_values[idx_by_name(*i)].second;
+        const Value &x = row_values[idx_by_name(*i)];
         key_values.push_back(make_pair(&*i, x));
         if (x.is_null())
             assigned_key = false;
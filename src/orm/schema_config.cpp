@@ -104,6 +104,8 @@ void MetaDataConfig::parse(Schema &reg)
 Table::Ptr MetaDataConfig::parse_table(ElementTree::ElementPtr node)
 {
     String sequence_name, name, xml_name, class_name;
+    int sequence_increment = 1, batch_size = 1,
+        cache_mode = Table::NoCache, cache_ttl = 0;
     bool autoinc = false;
 
     if (!node->has_attr(_T("name")))
@@ -113,6 +115,27 @@ Table::Ptr MetaDataConfig::parse_table(ElementTree::ElementPtr node)
     if (node->has_attr(_T("sequence")))
         sequence_name = node->get_attr(_T("sequence"));
 
+    if (node->has_attr(_T("sequence-increment")))
+        from_string(node->get_attr(_T("sequence-increment")),
+                sequence_increment);
+
+    if (node->has_attr(_T("batch-size")))
+        from_string(node->get_attr(_T("batch-size")), batch_size);
+
+    if (node->has_attr(_T("cache"))) {
+        String cache = node->get_attr(_T("cache"));
+        if (cache == _T("read-only"))
+            cache_mode = Table::ReadOnlyCache;
+        else if (cache == _T("read-write"))
+            cache_mode = Table::ReadWriteCache;
+        else if (cache != _T("none"))
+            throw XMLConfigError(_T("Invalid cache mode for table '")
+                    + name + _T("': ") + cache);
+    }
+
+    if (node->has_attr(_T("ttl")))
+        from_string(node->get_attr(_T("ttl")), cache_ttl);
+
     if (node->has_attr(_T("autoinc")))
         autoinc = true;
 
@@ -128,6 +151,9 @@ Table::Ptr MetaDataConfig::parse_table(ElementTree::ElementPtr node)
 
     Table::Ptr table_meta(new Table(name, xml_name, class_name));
     table_meta->set_seq_name(sequence_name);
+    table_meta->set_seq_increment(sequence_increment);
+    table_meta->set_batch_size(batch_size);
+    table_meta->set_cache(cache_mode, cache_ttl);
     table_meta->set_autoinc(autoinc);
 
     parse_column(node, *table_meta);
@@ -375,6 +401,18 @@ ElementTree::ElementPtr MetaDataConfig::table_to_tree(const Table &table)
         node->attrib_[_T("class")] = table.class_name();
     if (!str_empty(table.seq_name()))
         node->attrib_[_T("sequence")] = table.seq_name();
+    if (table.seq_increment() != 1)
+        node->attrib_[_T("sequence-increment")] =
+            to_string(table.seq_increment());
+    if (table.batch_size() != 1)
+        node->attrib_[_T("batch-size")] = to_string(table.batch_size());
+    if (table.cache_mode() != Table::NoCache) {
+        node->attrib_[_T("cache")] =
+            table.cache_mode() == Table::ReadOnlyCache?
+                _T("read-only"): _T("read-write");
+        if (table.cache_ttl())
+            node->attrib_[_T("ttl")] = to_string(table.cache_ttl());
+    }
     if (!str_empty(table.xml_name()) && table.xml_name() != table.class_name())
         node->attrib_[_T("xml-name")] = table.xml_name();
     else if (table.autoinc())
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include "util/string_utils.h"
 #include "util/singleton.h"
 #include "orm/sql_driver.h"
@@ -90,6 +91,13 @@ SqlDialect::parse_url_tail(const String &url_tail, StringDict &source)
 
 bool SqlDialect::native_driver_eats_slash() { return true; }
 
+const String
+SqlDialect::select_next_block(const String &seq_name, int increment)
+{
+    // the sequence itself is created with INCREMENT BY increment
+    return select_next_value(seq_name);
+}
+
 const String
 SqlDialect::select_last_inserted_id(const String &table_name)
 {
@@ -100,6 +108,14 @@ bool SqlDialect::commit_ddl() { return false; }
 
 bool SqlDialect::has_for_update() { return true; }
 
+const String
+SqlDialect::ping_query()
+{
+    if (str_empty(dual_))
+        return _T("SELECT 1");
+    return _T("SELECT 1 FROM ") + dual_;
+}
+
 bool SqlDialect::fk_internal() { return false; }
 
 const String SqlDialect::suffix_create_table() { return String(); }
@@ -118,6 +134,23 @@ SqlDialect::pager_model() {
     return (int)PAGER_POSTGRES;
 }
 
+int
+SqlDialect::insert_model() {
+    return (int)INSERT_VALUES_LIST;
+}
+
+int SqlDialect::max_params() { return 32767; }
+
+int SqlDialect::max_insert_rows() { return 1000; }
+
+// Oracle rejects longer lists with ORA-01795
+int SqlDialect::max_in_list() { return 1000; }
+
+int
+SqlDialect::returning_model(SqlConnection &conn) {
+    return (int)RETURNING_NONE;
+}
+
 const String
 SqlDialect::grant_insert_id_statement(const String &table_name, bool on)
 {
@@ -272,6 +305,28 @@ SqlCursorBackend::~SqlCursorBackend() {}
 void
 SqlCursorBackend::bind_params(const TypeCodes &types) {}
 
+void
+SqlCursorBackend::exec_many(const std::vector<Values> &params_set)
+{
+    std::vector<Values>::const_iterator i = params_set.begin(),
+        iend = params_set.end();
+    for (; i != iend; ++i)
+        exec(*i);
+}
+
+bool
+SqlCursorBackend::fetch_into(Row &row)
+{
+    RowPtr p = fetch_row();
+    if (!p.get())
+        return false;
+    row.swap(*p);
+    return true;
+}
+
+void
+SqlCursorBackend::reset() {}
+
 SqlConnectionBackend::~SqlConnectionBackend() {}
 
 SqlDriver::~SqlDriver() {}
@@ -396,21 +451,145 @@ SqlSource::options() const
     return options;
 }
 
+void
+RowDescr::add_column(const String &name)
+{
+    String uname = str_to_upper(name);
+    index_.insert(std::make_pair(uname, (int)names_.size()));
+    names_.push_back(uname);
+}
+
+int
+RowDescr::find(const String &name) const
+{
+    std::map<String, int>::const_iterator it = index_.find(name);
+    if (it == index_.end()) {
+        it = index_.find(str_to_upper(name));
+        if (it == index_.end())
+            return -1;
+    }
+    return it->second;
+}
+
+Row::Row(const RowItems &items)
+    : descr_(new RowDescr)
+{
+    values_.reserve(items.size());
+    RowItems::const_iterator i = items.begin(), iend = items.end();
+    for (; i != iend; ++i) {
+        descr_->add_column(i->first);
+        values_.push_back(i->second);
+    }
+}
+
+const RowItems
+Row::items() const
+{
+    RowItems result;
+    result.reserve(values_.size());
+    for (size_t i = 0; i < values_.size(); ++i)
+        result.push_back(RowItem(descr_->name(i), values_[i]));
+    return result;
+}
+
 bool
 SqlResultSet::fetch(Row &row)
 {
-    RowPtr p = cursor_.fetch_row();
-    if (!p.get())
-        return false;
-    row.swap(*p);
-    return true;
+    if (rows_.get()) {
+        if (pos_ < rows_->size()) {
+            row.swap((*rows_)[pos_++]);
+            return true;
+        }
+        if (!cursor_)
+            return false;
+        rows_.reset(NULL);
+    }
+    return cursor_->fetch_into(row);
+}
+
+SqlResultSet::~SqlResultSet()
+{
+    if (recycle_ && owned_cursor_.get()) {
+        try {
+            owned_cursor_->get_connection().put_prepared_cursor(owned_cursor_);
+        }
+        catch (const std::exception &) {}
+    }
 }
 
 void
-SqlResultSet::own(std::auto_ptr<SqlCursor> cursor)
+SqlResultSet::own(std::auto_ptr<SqlCursor> cursor, bool recycle)
 {
     owned_cursor_.reset(NULL);
     owned_cursor_.reset(cursor.release());
+    recycle_ = recycle;
+}
+
+const char *
+SqlStatementEvent::phase_name(int phase)
+{
+    switch (phase) {
+    case STMT_PREPARE: return "prepare";
+    case STMT_EXEC: return "exec";
+    case STMT_EXEC_DIRECT: return "exec_direct";
+    case STMT_EXEC_MANY: return "exec_many";
+    case STMT_FETCH: return "fetch";
+    }
+    return "unknown";
+}
+
+SqlStatementObserver::~SqlStatementObserver() {}
+
+SlowQueryLog::SlowQueryLog(ILogger *parent, MilliSec threshold,
+        int sample_every)
+    : threshold_(threshold * 1000)
+    , sample_every_(sample_every)
+    , seen_(0)
+    , slow_(0)
+{
+    if (parent)
+        log_.reset(parent->new_logger("slow_query").release());
+}
+
+void
+SlowQueryLog::on_statement(SqlConnection &conn,
+        const SqlStatementEvent &event)
+{
+    bool slow = event.elapsed >= threshold_, sampled = false;
+    {
+        ScopedLock lock(mux_);
+        ++seen_;
+        if (slow)
+            ++slow_;
+        else if (sample_every_ > 0 && seen_ % sample_every_ == 0)
+            sampled = true;
+    }
+    if (!(slow || sampled) || !log_.get())
+        return;
+    std::ostringstream out;
+    out << (slow? "slow ": "sampled ")
+        << SqlStatementEvent::phase_name(event.phase)
+        << (event.failed? " failed": "")
+        << ": " << event.elapsed / 1000 << "."
+        << std::setw(3) << std::setfill('0') << event.elapsed % 1000
+        << " ms";
+    if (event.rows >= 0)
+        out << ", rows: " << event.rows;
+    out << ", source: " << NARROW(conn.get_source().id())
+        << ", sql: " << NARROW(event.sql);
+    if (event.params) {
+        for (size_t i = 0; i < event.params->size(); ++i)
+            out << " p" << (i + 1) << "=\""
+                << NARROW((*event.params)[i].sql_str()) << "\"";
+    }
+    log_->log(slow? ll_WARNING: ll_INFO, out.str());
+}
+
+LongInt
+SlowQueryLog::slow_count()
+{
+    ScopedLock lock(mux_);
+    return slow_;
 }
 
 SqlCursor::SqlCursor(SqlConnection &connection)
@@ -418,49 +597,108 @@ SqlCursor::SqlCursor(SqlConnection &connection)
     , backend_(connection.backend_->new_cursor().release())
     , echo_(connection.echo_)
     , conv_params_(connection.conv_params_)
+    , bound_(false)
     , log_(connection.log_.get())
+    , fetch_time_(0)
+    , fetched_rows_(0)
+    , fetch_pending_(false)
 {}
 
+SqlCursor::~SqlCursor()
+{
+    if (fetch_pending_)
+        flush_fetch_stats();
+}
+
+void
+SqlCursor::notify(SqlStatementObserver *observer, int phase,
+        const String &sql, const Values *params, MicroSec t0,
+        LongInt rows, bool failed)
+{
+    try {
+        SqlStatementEvent event(phase, sql, params,
+                get_monotonic_microsec() - t0, rows, failed);
+        observer->on_statement(connection_, event);
+    }
+    catch (...) {}
+}
+
+void
+SqlCursor::flush_fetch_stats()
+{
+    fetch_pending_ = false;
+    SqlStatementObserver *observer = connection_.observer_;
+    if (observer) {
+        try {
+            SqlStatementEvent event(STMT_FETCH, sql_, NULL,
+                    fetch_time_, fetched_rows_, false);
+            observer->on_statement(connection_, event);
+        }
+        catch (...) {}
+    }
+    fetch_time_ = 0;
+    fetched_rows_ = 0;
+}
+
 void
 SqlCursor::exec_direct(const String &sql)
 {
+    SqlStatementObserver *observer = connection_.observer_;
+    MicroSec t0 = observer? get_monotonic_microsec(): 0;
     try {
-        if (echo_)
+        if (echo_on(ll_INFO))
             debug(_T("exec_direct: ") + sql, ll_INFO);
         connection_.activity_ = true;
         backend_->exec_direct(sql);
     }
     catch (const std::exception &e) {
         connection_.mark_bad(e);
+        if (observer)
+            notify(observer, STMT_EXEC_DIRECT, sql, NULL, t0, -1, true);
         throw;
     }
+    if (observer)
+        notify(observer, STMT_EXEC_DIRECT, sql, NULL, t0, -1, false);
 }
 
-
-
 void
 SqlCursor::prepare(const String &sql)
 {
+    if (fetch_pending_)
+        flush_fetch_stats();
+    SqlStatementObserver *observer = connection_.observer_;
+    MicroSec t0 = observer? get_monotonic_microsec(): 0;
     try {
         String fixed_sql = sql;
         if (conv_params_ && connection_.driver_->numbered_params())
             fixed_sql = SqlDriver::convert_to_numbered_params(sql);
-        if (echo_)
+        if (echo_on(ll_INFO))
             debug(_T("prepare: ") + fixed_sql, ll_INFO);
         connection_.activity_ = true;
+        sql_ = String();
+        bound_ = false;
+        bound_types_.clear();
         backend_->prepare(fixed_sql);
+        sql_ = sql;
     }
     catch (const std::exception &e) {
         connection_.mark_bad(e);
+        if (observer)
+            notify(observer, STMT_PREPARE, sql, NULL, t0, -1, true);
         throw;
     }
+    if (observer)
+        notify(observer, STMT_PREPARE, sql_, NULL, t0, -1, false);
 }
 
 void
 SqlCursor::bind_params(const TypeCodes &types)
 {
+    // a cursor taken from the statement cache is already bound
+    if (bound_ && bound_types_ == types)
+        return;
     try {
-        if (echo_) {
+        if (echo_on(ll_TRACE)) {
             String type_names;
             for (size_t i = 0; i < types.size(); ++i) {
                 if (i)
@@ -470,6 +708,8 @@ SqlCursor::bind_params(const TypeCodes &types)
             debug(_T("bind: (") + type_names + _T(")"), ll_TRACE);
         }
         backend_->bind_params(types);
+        bound_types_ = types;
+        bound_ = true;
     }
     catch (const std::exception &e) {
         connection_.mark_bad(e);
@@ -480,8 +720,12 @@ SqlCursor::bind_params(const TypeCodes &types)
 SqlResultSet
 SqlCursor::exec(const Values &params)
 {
+    if (fetch_pending_)
+        flush_fetch_stats();
+    SqlStatementObserver *observer = connection_.observer_;
+    MicroSec t0 = observer? get_monotonic_microsec(): 0;
     try {
-        if (echo_) {
+        if (echo_on(ll_DEBUG)) {
             std::ostringstream out;
             out << "exec prepared:";
             for (size_t i = 0; i < params.size(); ++i)
@@ -491,42 +735,91 @@ SqlCursor::exec(const Values &params)
         }
         connection_.activity_ = true;
         backend_->exec(params);
-        return SqlResultSet(*this);
     }
     catch (const std::exception &e) {
         connection_.mark_bad(e);
+        if (observer)
+            notify(observer, STMT_EXEC, sql_, &params, t0, -1, true);
+        throw;
+    }
+    if (observer) {
+        notify(observer, STMT_EXEC, sql_, &params, t0, -1, false);
+        fetch_pending_ = true;
+    }
+    return SqlResultSet(*this);
+}
+
+void
+SqlCursor::exec_many(const std::vector<Values> &params_set)
+{
+    if (fetch_pending_)
+        flush_fetch_stats();
+    SqlStatementObserver *observer = connection_.observer_;
+    MicroSec t0 = observer? get_monotonic_microsec(): 0;
+    try {
+        if (echo_on(ll_DEBUG)) {
+            std::ostringstream out;
+            out << "exec prepared " << params_set.size() << " times:";
+            for (size_t j = 0; j < params_set.size(); ++j) {
+                out << " (";
+                const Values &params = params_set[j];
+                for (size_t i = 0; i < params.size(); ++i)
+                    out << (i? " ": "") << "p" << (i + 1) << "=\""
+                        << NARROW(params[i].sql_str()) << "\"";
+                out << ")";
+            }
+            debug(WIDEN(out.str()));
+        }
+        connection_.activity_ = true;
+        backend_->exec_many(params_set);
+    }
+    catch (const std::exception &e) {
+        connection_.mark_bad(e);
+        if (observer)
+            notify(observer, STMT_EXEC_MANY, sql_, NULL, t0,
+                    params_set.size(), true);
         throw;
     }
+    if (observer)
+        notify(observer, STMT_EXEC_MANY, sql_, NULL, t0,
+                params_set.size(), false);
 }
 
 RowPtr
 SqlCursor::fetch_row()
 {
+    RowPtr row(new Row);
+    if (!fetch_into(*row))
+        return RowPtr();
+    return row;
+}
+
+bool
+SqlCursor::fetch_into(Row &row)
+{
+    MicroSec t0 = fetch_pending_? get_monotonic_microsec(): 0;
     try {
-        RowPtr row = backend_->fetch_row();
-        if (row.get()) {
-            Row::iterator j = row->begin(), jend = row->end();
-            for (; j != jend; ++j) {
-                String uname = str_to_upper(j->first);
-                using namespace std;
-                swap(j->first, uname);
-            }
+        bool found = backend_->fetch_into(row);
+        if (fetch_pending_) {
+            fetch_time_ += get_monotonic_microsec() - t0;
+            if (found)
+                ++fetched_rows_;
+            else
+                flush_fetch_stats();
         }
-        if (echo_) {
-            if (row.get()) {
+        if (echo_on(ll_DEBUG)) {
+            if (found) {
                 std::ostringstream out;
                 out << "fetch: ";
-                Row::const_iterator j = row->begin(),
-                                    jend = row->end();
-                for (; j != jend; ++j)
-                    out << NARROW(j->first) << "="
-                        << NARROW(j->second.sql_str()) << " ";
+                for (size_t j = 0; j < row.size(); ++j)
+                    out << NARROW(row.name(j)) << "="
+                        << NARROW(row[j].sql_str()) << " ";
                 debug(WIDEN(out.str()));
             }
             else
                 debug(_T("fetch: no more rows"));
         }
-        return row;
+        return found;
     }
     catch (const std::exception &e) {
         connection_.mark_bad(e);
@@ -540,8 +833,7 @@ SqlCursor::fetch_rows(int max_rows)
     try {
         RowsPtr rows(new Rows);
         SqlResultSet result(*this);
-        copy_no_more_than_n(result.begin(), result.end(),
-                            max_rows, back_inserter(*rows));
+        swap_no_more_than_n(result, max_rows, *rows);
         return rows;
     }
     catch (const std::exception &e) {
@@ -550,9 +842,24 @@ SqlCursor::fetch_rows(int max_rows)
     }
 }
 
+void
+SqlCursor::reset()
+{
+    if (fetch_pending_)
+        flush_fetch_stats();
+    try {
+        backend_->reset();
+    }
+    catch (const std::exception &e) {
+        connection_.mark_bad(e);
+        throw;
+    }
+}
+
 void
 SqlConnection::mark_bad(const std::exception &e)
 {
+    ++stats_.bad_marks;
     if (!bad_) {
         std::string s = e.what();
         size_t pos = s.find('\n');
@@ -576,10 +883,15 @@ SqlConnection::SqlConnection(const String &driver_name,
     , bad_(false)
     , explicit_trans_started_(false)
     , free_since_(0)
+    , checked_at_(0)
+    , checked_out_at_(0)
+    , stmt_cache_size_(source_.stmt_cache_size())
+    , observer_(NULL)
 {
     source_[_T("&driver")] = driver_->get_name();
     backend_.reset(driver_->create_backend().release());
     backend_->open(dialect_, source_);
+    stats_.opened_at = time(NULL);
 }
 
 SqlConnection::SqlConnection(const String &driver_name,
@@ -594,10 +906,15 @@ SqlConnection::SqlConnection(const String &driver_name,
     , bad_(false)
     , explicit_trans_started_(false)
     , free_since_(0)
+    , checked_at_(0)
+    , checked_out_at_(0)
+    , stmt_cache_size_(source_.stmt_cache_size())
+    , observer_(NULL)
 {
     source_[_T("&driver")] = driver_->get_name();
     backend_.reset(driver_->create_backend().release());
     backend_->use_raw(dialect_, raw_connection);
+    stats_.opened_at = time(NULL);
 }
 
 SqlConnection::SqlConnection(const SqlSource &source)
@@ -610,10 +927,15 @@ SqlConnection::SqlConnection(const SqlSource &source)
     , bad_(false)
     , explicit_trans_started_(false)
     , free_since_(0)
+    , checked_at_(0)
+    , checked_out_at_(0)
+    , stmt_cache_size_(source_.stmt_cache_size())
+    , observer_(NULL)
 {
     source_[_T("&driver")] = driver_->get_name();
     backend_.reset(driver_->create_backend().release());
     backend_->open(dialect_, source_);
+    stats_.opened_at = time(NULL);
 }
 
 SqlConnection::SqlConnection(const String &url)
@@ -626,10 +948,15 @@ SqlConnection::SqlConnection(const String &url)
     , bad_(false)
     , explicit_trans_started_(false)
     , free_since_(0)
+    , checked_at_(0)
+    , checked_out_at_(0)
+    , stmt_cache_size_(source_.stmt_cache_size())
+    , observer_(NULL)
 {
     source_[_T("&driver")] = driver_->get_name();
     backend_.reset(driver_->create_backend().release());
     backend_->open(dialect_, source_);
+    stats_.opened_at = time(NULL);
 }
 
 SqlConnection::~SqlConnection()
@@ -637,6 +964,7 @@ SqlConnection::~SqlConnection()
     bool err = false;
     try {
         clear();
+        clear_stmt_cache();
         if (activity_)
             rollback();
     }
@@ -661,6 +989,75 @@ SqlConnection::new_cursor()
     return std::auto_ptr<SqlCursor>(new SqlCursor(*this));
 }
 
+std::auto_ptr<SqlCursor>
+SqlConnection::get_prepared_cursor(const String &sql)
+{
+    StmtCacheIndex::iterator i = stmt_index_.find(sql);
+    if (i != stmt_index_.end()) {
+        std::auto_ptr<SqlCursor> cursor(*i->second);
+        stmt_lru_.erase(i->second);
+        stmt_index_.erase(i);
+        ++stmt_stats_.hits;
+        // logging settings may have changed since the cursor was cached
+        cursor->echo_ = echo_;
+        cursor->log_ = log_.get();
+        if (echo_)
+            debug(_T("prepare (cached): ") + sql, ll_DEBUG);
+        return cursor;
+    }
+    ++stmt_stats_.misses;
+    std::auto_ptr<SqlCursor> cursor = new_cursor();
+    cursor->prepare(sql);
+    return cursor;
+}
+
+void
+SqlConnection::put_prepared_cursor(std::auto_ptr<SqlCursor> cursor)
+{
+    if (!cursor.get() || bad_ || stmt_cache_size_ <= 0
+            || str_empty(cursor->get_sql())
+            || stmt_index_.find(cursor->get_sql()) != stmt_index_.end())
+        return;
+    try {
+        cursor->reset();
+    }
+    catch (const std::exception &) {
+        return;
+    }
+    stmt_lru_.push_front(cursor.get());
+    stmt_index_[cursor->get_sql()] = stmt_lru_.begin();
+    cursor.release();
+    shrink_stmt_cache(stmt_cache_size_);
+}
+
+void
+SqlConnection::shrink_stmt_cache(int max_size)
+{
+    while (stmt_lru_.size() > (size_t)max_size) {
+        std::auto_ptr<SqlCursor> cursor(stmt_lru_.back());
+        stmt_index_.erase(cursor->get_sql());
+        stmt_lru_.pop_back();
+        ++stmt_stats_.evictions;
+    }
+}
+
+void
+SqlConnection::clear_stmt_cache()
+{
+    while (!stmt_lru_.empty()) {
+        std::auto_ptr<SqlCursor> cursor(stmt_lru_.back());
+        stmt_lru_.pop_back();
+    }
+    stmt_index_.clear();
+}
+
+void
+SqlConnection::set_stmt_cache_size(int stmt_cache_size)
+{
+    stmt_cache_size_ = stmt_cache_size;
+    shrink_stmt_cache(stmt_cache_size_ > 0? stmt_cache_size_: 0);
+}
+
 bool
 SqlConnection::explicit_transaction_control() const
 {
@@ -731,6 +1128,13 @@ SqlConnection::clear()
 {
     try {
         cursor_.reset(NULL);
+        // prepared statements outlive the checkout from a pool,
+        // unless the connection is to be closed
+        if (bad_)
+            clear_stmt_cache();
+        StmtCacheList::iterator i = stmt_lru_.begin(), iend = stmt_lru_.end();
+        for (; i != iend; ++i)
+            (*i)->reset();
     }
     catch (const std::exception &e) {
         mark_bad(e);
@@ -738,6 +1142,43 @@ SqlConnection::clear()
     }
 }
 
+ElementTree::ElementPtr
+SqlConnection::stats_to_json(const String &name) const
+{
+    ElementTree::ElementPtr d = ElementTree::new_json_dict(name);
+    d->add_json_string(_T("source"), source_.id());
+    d->add_json(_T("opened_at"), (LongInt)stats_.opened_at);
+    d->add_json(_T("bad"), String(bad_? _T("true"): _T("false")));
+    d->add_json(_T("bad_marks"), stats_.bad_marks);
+    d->add_json(_T("checkouts"), stats_.checkouts);
+    ElementTree::ElementPtr c = d->add_json_dict(_T("stmt_cache"));
+    c->add_json(_T("size"), (int)stmt_lru_.size());
+    c->add_json(_T("hits"), stmt_stats_.hits);
+    c->add_json(_T("misses"), stmt_stats_.misses);
+    c->add_json(_T("evictions"), stmt_stats_.evictions);
+    return d;
+}
+
+bool
+SqlConnection::ping()
+{
+    if (bad_)
+        return false;
+    try {
+        std::auto_ptr<SqlCursor> cursor = new_cursor();
+        cursor->prepare(dialect_->ping_query());
+        cursor->exec(Values());
+        bool ok = cursor->fetch_rows()->size() == 1;
+        cursor.reset(NULL);
+        rollback();
+        return ok;
+    }
+    catch (const std::exception &e) {
+        mark_bad(e);
+    }
+    return false;
+}
+
 void
 SqlConnection::exec_direct(const String &sql)
 {
@@ -5,6 +5,8 @@
 #include <signal.h>
 #endif
 #include <time.h>
+#include <algorithm>
+#include <vector>
 #include "orm/sql_pool.h"
 
 #ifdef _MSC_VER
@@ -20,6 +22,83 @@ PoolError::PoolError(const String &err)
     : DBError(err)
 {}
 
+SqlPoolStats::SqlPoolStats()
+    : in_use(0), idle(0), opening(0), waiting(0), max_size(0)
+    , longest_hold(0)
+    , checkouts(0), timeouts(0), opened(0), open_errors(0), closed(0)
+    , reconnects(0), bad_closed(0), bad_marks(0)
+    , wait_total(0), wait_max(0), hold_total(0), hold_max(0)
+{
+    std::fill(wait_hist, wait_hist + YB_POOL_WAIT_BUCKETS, 0);
+}
+
+MilliSec
+SqlPoolStats::wait_bucket_bound(int i)
+{
+    // 1ms, 10ms, ..., 10s
+    MilliSec bound = 1;
+    for (; i > 0; --i)
+        bound *= 10;
+    return bound;
+}
+
+void
+SqlPoolStats::add_wait(MilliSec wait)
+{
+    int i = 0;
+    for (; i < YB_POOL_WAIT_BUCKETS - 1; ++i)
+        if (wait < wait_bucket_bound(i))
+            break;
+    ++wait_hist[i];
+    wait_total += wait;
+    if (wait > wait_max)
+        wait_max = wait;
+}
+
+void
+SqlPoolStats::add_hold(MilliSec hold)
+{
+    hold_total += hold;
+    if (hold > hold_max)
+        hold_max = hold;
+}
+
+ElementTree::ElementPtr
+SqlPoolStats::to_json(const String &name) const
+{
+    ElementTree::ElementPtr d = ElementTree::new_json_dict(name);
+    d->add_json(_T("in_use"), in_use);
+    d->add_json(_T("idle"), idle);
+    d->add_json(_T("opening"), opening);
+    d->add_json(_T("waiting"), waiting);
+    d->add_json(_T("max_size"), max_size);
+    d->add_json(_T("longest_hold_ms"), longest_hold);
+    d->add_json(_T("checkouts"), checkouts);
+    d->add_json(_T("timeouts"), timeouts);
+    d->add_json(_T("opened"), opened);
+    d->add_json(_T("open_errors"), open_errors);
+    d->add_json(_T("closed"), closed);
+    d->add_json(_T("reconnects"), reconnects);
+    d->add_json(_T("bad_closed"), bad_closed);
+    d->add_json(_T("bad_marks"), bad_marks);
+    ElementTree::ElementPtr w = d->add_json_dict(_T("wait_ms"));
+    w->add_json(_T("total"), wait_total);
+    w->add_json(_T("max"), wait_max);
+    ElementTree::ElementPtr h = w->add_json_dict(_T("histogram"));
+    for (int i = 0; i < YB_POOL_WAIT_BUCKETS; ++i) {
+        if (i < YB_POOL_WAIT_BUCKETS - 1)
+            h->add_json(_T("lt_") + to_string(wait_bucket_bound(i)),
+                    wait_hist[i]);
+        else
+            h->add_json(_T("ge_") + to_string(wait_bucket_bound(i - 1)),
+                    wait_hist[i]);
+    }
+    ElementTree::ElementPtr hd = d->add_json_dict(_T("hold_ms"));
+    hd->add_json(_T("total"), hold_total);
+    hd->add_json(_T("max"), hold_max);
+    return d;
+}
+
 PoolMonThread::PoolMonThread(SqlPool *pool) : pool_(pool) {}
 
 void PoolMonThread::on_run() { pool_->monitor_thread(); }
@@ -53,10 +132,10 @@ format_stats(const String &source_id, int count = -1, int pool_size = -1)
 const String
 SqlPool::get_stats(const String &source_id)
 {
-    std::map<String, int>::iterator c = counts_.find(source_id);
-    if (counts_.end() == c)
+    std::map<String, SourceState>::iterator i = sources_.find(source_id);
+    if (sources_.end() == i)
         return _T(" [source: ") + source_id + _T(", unknown source]");
-    return format_stats(source_id, c->second, pools_[source_id].size());
+    return format_stats(source_id, i->second.in_use_, i->second.pool_.size());
 }
 
 void *
@@ -65,40 +144,155 @@ SqlPool::monitor_thread()
     block_sigpipe();
     LOG(ll_INFO, _T("monitor thread started"));
     while (sleep_not_stop()) {
-        // processing 'idle close'
+        close_idle();
+        validate_idle();
+        std::vector<String> source_ids;
+        {
+            ScopedLock lock(pool_mux_);
+            std::map<String, SourceState>::iterator i = sources_.begin(),
+                iend = sources_.end();
+            for (; i != iend; ++i)
+                if (i->second.min_idle_ > 0)
+                    source_ids.push_back(i->first);
+        }
+        for (size_t i = 0; i < source_ids.size(); ++i)
+            fill_idle(source_ids[i]);
+    }
+    return NULL;
+}
+
+void
+SqlPool::close_idle()
+{
+    // close all the connections being idle for too long,
+    // keeping min_idle connections open
+    std::vector<SqlConnectionPtr> to_close;
+    {
         ScopedLock lock(pool_mux_);
-        std::map<String, Pool>::iterator i = pools_.begin(), iend = pools_.end();
-        for (bool quit = false; !quit && i != iend; ++i) {
-            Pool::iterator j = i->second.begin(), jend = i->second.end();
-            for (; j != jend; ++j) {
-                if (time(NULL) - (*j)->free_since_ >= idle_time_) {
-                    quit = true;
-                    String del_source_id = i->first;
-                    SqlConnectionPtr del_handle = *j;
-                    int del_count = counts_[del_source_id];
-                    i->second.erase(j);
-                    int del_pool_sz = i->second.size();
-                    LOG(ll_DEBUG, _T("closing idle connection")
-                            + format_stats(del_source_id));
-                    delete del_handle;
-                    LOG(ll_INFO, _T("closed idle connection")
-                            + format_stats(del_source_id, del_count, del_pool_sz));
-                    break;
+        time_t now = time(NULL);
+        std::map<String, SourceState>::iterator i = sources_.begin(),
+            iend = sources_.end();
+        for (; i != iend; ++i) {
+            Pool &pool = i->second.pool_;
+            Pool::iterator j = pool.begin();
+            while (j != pool.end() && (int)pool.size() > i->second.min_idle_) {
+                if (now - (*j)->free_since_ >= idle_time_) {
+                    count_closed(i->second, (*j)->stats_.bad_marks, false);
+                    to_close.push_back(*j);
+                    j = pool.erase(j);
                 }
+                else
+                    ++j;
             }
         }
     }
-    return NULL;
+    for (size_t i = 0; i < to_close.size(); ++i) {
+        const String source_id = to_close[i]->get_source().id();
+        LOG(ll_DEBUG, _T("closing idle connection") + format_stats(source_id));
+        delete to_close[i];
+        LOG(ll_INFO, _T("closed idle connection") + format_stats(source_id));
+    }
+}
+
+void
+SqlPool::validate_idle()
+{
+    // the connections being checked are counted as used
+    std::vector<SqlConnectionPtr> to_check;
+    {
+        ScopedLock lock(pool_mux_);
+        time_t now = time(NULL);
+        std::map<String, SourceState>::iterator i = sources_.begin(),
+            iend = sources_.end();
+        for (; i != iend; ++i) {
+            SourceState &st = i->second;
+            if (st.validate_time_ <= 0)
+                continue;
+            Pool::iterator j = st.pool_.begin();
+            while (j != st.pool_.end()) {
+                if (now - (*j)->checked_at_ >= st.validate_time_) {
+                    to_check.push_back(*j);
+                    ++st.in_use_;
+                    j = st.pool_.erase(j);
+                }
+                else
+                    ++j;
+            }
+        }
+    }
+    for (size_t i = 0; i < to_check.size(); ++i) {
+        SqlConnectionPtr handle = to_check[i];
+        const String source_id = handle->get_source().id();
+        bool ok = handle->ping();
+        int bad_marks = handle->stats_.bad_marks;
+        if (!ok) {
+            LOG(ll_WARNING, _T("closing broken connection")
+                    + format_stats(source_id));
+            delete handle;
+        }
+        ScopedLock lock(pool_mux_);
+        SourceState &st = sources_[source_id];
+        --st.in_use_;
+        if (ok) {
+            handle->checked_at_ = time(NULL);
+            st.pool_.push_back(handle);
+        }
+        else
+            count_closed(st, bad_marks, true);
+        serve_waiters(st);
+    }
+}
+
+void
+SqlPool::fill_idle(const String &source_id)
+{
+    // open connections until there are min_idle of them in the pool,
+    // failing to do so is not fatal
+    while (true) {
+        SqlSource source;
+        {
+            ScopedLock lock(pool_mux_);
+            SourceState &st = sources_[source_id];
+            if ((int)st.pool_.size() + st.opening_ >= st.min_idle_
+                    || !st.waiters_.empty() || !st.has_room())
+                break;
+            ++st.opening_;
+            source = st.source_;
+        }
+        SqlConnectionPtr handle;
+        try {
+            handle = open_connection(source);
+        }
+        catch (const std::exception &e) {
+            LOG(ll_ERROR, String(_T("can't pre-open connection: "))
+                    + WIDEN(e.what()) + format_stats(source_id));
+            break;
+        }
+        ScopedLock lock(pool_mux_);
+        SourceState &st = sources_[source_id];
+        --st.opening_;
+        ++st.stats_.opened;
+        handle->free_since_ = handle->checked_at_ = time(NULL);
+        st.pool_.push_back(handle);
+        serve_waiters(st);
+        LOG(ll_INFO, _T("pre-opened connection") + get_stats(source_id));
+    }
 }
 
 void
 SqlPool::close_all()
 {
     ScopedLock lock(pool_mux_);
-    for (std::map<String, Pool>::iterator i = pools_.begin(); i != pools_.end(); ++i) {
+    std::map<String, SourceState>::iterator i = sources_.begin(),
+        iend = sources_.end();
+    for (; i != iend; ++i) {
         LOG(ll_DEBUG, _T("closing all") + get_stats(i->first));
-        for (Pool::iterator j = i->second.begin(); j != i->second.end(); ++j)
+        Pool &pool = i->second.pool_;
+        for (Pool::iterator j = pool.begin(); j != pool.end(); ++j) {
+            count_closed(i->second, (*j)->stats_.bad_marks, false);
             delete *j;
+        }
+        pool.clear();
         LOG(ll_INFO, _T("closed all") + get_stats(i->first));
     }
 }
@@ -123,14 +317,19 @@ SqlPool::sleep_not_stop(void)
 }
 
 SqlPool::SqlPool(int pool_max_size, int idle_time,
-                 int monitor_sleep, ILogger *logger, bool interlocked_open)
+                 int monitor_sleep, ILogger *logger, bool interlocked_open,
+                 int open_parallelism)
     : stop_cond_(stop_mux_)
+    , open_cond_(open_mux_)
     , pool_max_size_(pool_max_size)
     , idle_time_(idle_time)
     , monitor_sleep_(monitor_sleep)
+    , open_parallelism_(open_parallelism)
+    , opening_now_(0)
     , stop_monitor_flag_(false)
     , interlocked_open_(interlocked_open)
     , monitor_(this)
+    , observer_(NULL)
 {
     if (logger) {
         ILogger::Ptr pool_logger = logger->new_logger("pool");
@@ -149,45 +348,254 @@ SqlPool::~SqlPool()
 void
 SqlPool::add_source(const SqlSource &source)
 {
-    sources_[source.id()] = source;
-    counts_[source.id()] = 0;
-    pools_[source.id()] = Pool();
+    const String &source_id = source.id();
+    {
+        ScopedLock lock(pool_mux_);
+        SourceState &st = sources_[source_id];
+        st.source_ = source;
+        st.max_size_ = source.get_as<int>(
+                String(_T("pool_max_size")), pool_max_size_);
+        st.min_idle_ = source.get_as<int>(
+                String(_T("pool_min_idle")), YB_POOL_MIN_IDLE);
+        if (st.max_size_ > 0 && st.min_idle_ > st.max_size_)
+            st.min_idle_ = st.max_size_;
+        st.validate_time_ = source.get_as<int>(
+                String(_T("pool_validate_time")), YB_POOL_VALIDATE_TIME);
+        st.balancing_ = source.get(_T("pool_balancing"), _T(""))
+            == _T("least_in_use")? LEAST_IN_USE: ROUND_ROBIN;
+    }
+    fill_idle(source_id);
 }
 
-SqlPool::SqlConnectionPtr
-SqlPool::get(const String &source_id, int timeout)
+void
+SqlPool::add_replica(const String &primary_id, const SqlSource &replica)
 {
-    SqlSource src;
     {
         ScopedLock lock(pool_mux_);
-        std::map<String, SqlSource>::iterator source_it = sources_.find(source_id);
-        if (sources_.end() == source_it)
-            throw PoolError(_T("Unknown source ID: ") + source_id);
-        if (pools_[source_id].size()) {
-            SqlConnectionPtr handle = pools_[source_id].front();
-            ++counts_[source_id];
-            pools_[source_id].pop_front();
-            LOG(ll_INFO, _T("got connection") + get_stats(source_id));
-            return handle;
+        SourceState &st = find_source(primary_id);
+        if (replica.id() == primary_id ||
+                std::find(st.replicas_.begin(), st.replicas_.end(),
+                    replica.id()) != st.replicas_.end())
+            throw PoolError(_T("Duplicate replica ID: ") + replica.id());
+        st.replicas_.push_back(replica.id());
+    }
+    add_source(replica);
+}
+
+const Strings
+SqlPool::pick_replicas(const String &primary_id)
+{
+    // the replicas to try in order of preference
+    ScopedLock lock(pool_mux_);
+    SourceState &st = find_source(primary_id);
+    Strings result;
+    if (st.replicas_.empty())
+        return result;
+    time_t now = time(NULL);
+    size_t n = st.replicas_.size(), start = st.next_replica_++ % n;
+    std::vector<std::pair<int, size_t> > order;
+    for (size_t i = 0; i < n; ++i) {
+        const String &replica_id = st.replicas_[(start + i) % n];
+        const SourceState &rst = sources_[replica_id];
+        if (rst.down_until_ > now)
+            continue;
+        // a busy replica would make the caller wait, skip it
+        if (!rst.waiters_.empty() || (rst.pool_.empty() && !rst.has_room()))
+            continue;
+        int load = st.balancing_ == LEAST_IN_USE?
+            rst.in_use_ + rst.opening_: 0;
+        // equally loaded replicas are taken in round-robin order
+        order.push_back(std::make_pair(load, i));
+    }
+    std::sort(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); ++i)
+        result.push_back(st.replicas_[(start + order[i].second) % n]);
+    return result;
+}
+
+SqlPool::SourceState &
+SqlPool::find_source(const String &source_id)
+{
+    std::map<String, SourceState>::iterator i = sources_.find(source_id);
+    if (sources_.end() == i)
+        throw PoolError(_T("Unknown source ID: ") + source_id);
+    return i->second;
+}
+
+void
+SqlPool::serve_waiters(SourceState &st)
+{
+    // should be called with pool_mux_ locked
+    while (!st.waiters_.empty()) {
+        Waiter *w = st.waiters_.front();
+        if (!st.pool_.empty()) {
+            w->handle_ = st.pool_.front();
+            st.pool_.pop_front();
+            checkout(st, w->handle_);
+        }
+        else if (st.has_room()) {
+            w->may_open_ = true;
+            ++st.opening_;
         }
-        src = source_it->second;
+        else
+            break;
+        st.waiters_.pop_front();
+        w->cond_.notify_one();
     }
+}
+
+void
+SqlPool::checkout(SourceState &st, SqlConnectionPtr handle)
+{
+    ++st.in_use_;
+    ++st.stats_.checkouts;
+    ++handle->stats_.checkouts;
+    handle->checked_out_at_ = get_cur_time_millisec();
+    st.checked_out_.insert(handle);
+}
+
+void
+SqlPool::checkin(SourceState &st, SqlConnectionPtr handle,
+        MilliSec checked_out_at)
+{
+    // the handle may be already deleted here
+    --st.in_use_;
+    if (st.checked_out_.erase(handle))
+        st.stats_.add_hold(get_cur_time_millisec() - checked_out_at);
+}
+
+void
+SqlPool::count_closed(SourceState &st, int bad_marks, bool bad)
+{
+    ++st.stats_.closed;
+    st.stats_.bad_marks += bad_marks;
+    if (bad)
+        ++st.stats_.bad_closed;
+}
+
+SqlPool::SqlConnectionPtr
+SqlPool::open_connection(const SqlSource &source)
+{
+    // a slot should have been reserved by incrementing opening_,
+    // it is released here if the connection can't be opened
+    const String &source_id = source.id();
     LOG(ll_DEBUG, _T("opening connection") + format_stats(source_id));
-    SqlConnectionPtr handle;
-    if (interlocked_open_) {
+    bool limited = interlocked_open_ && open_parallelism_ > 0;
+    if (limited) {
         ScopedLock lock(open_mux_);
-        handle = new SqlConnection(src);
+        while (opening_now_ >= open_parallelism_)
+            open_cond_.wait(lock);
+        ++opening_now_;
     }
-    else
-        handle = new SqlConnection(src);
-    LOG(ll_INFO, _T("opened connection") + get_stats(source_id));
+    try {
+        SqlConnectionPtr handle = new SqlConnection(source);
+        {
+            ScopedLock lock(pool_mux_);
+            handle->set_observer(observer_);
+        }
+        if (limited) {
+            ScopedLock lock(open_mux_);
+            --opening_now_;
+            open_cond_.notify_one();
+        }
+        return handle;
+    }
+    catch (...) {
+        if (limited) {
+            ScopedLock lock(open_mux_);
+            --opening_now_;
+            open_cond_.notify_one();
+        }
+        ScopedLock lock(pool_mux_);
+        SourceState &st = sources_[source_id];
+        --st.opening_;
+        ++st.stats_.open_errors;
+        serve_waiters(st);
+        throw;
+    }
+}
+
+SqlPool::SqlConnectionPtr
+SqlPool::get(const String &source_id, int timeout)
+{
+    MilliSec t0 = get_cur_time_millisec();
+    SqlSource src;
     {
         ScopedLock lock(pool_mux_);
-        ++counts_[source_id];
+        SourceState &st = find_source(source_id);
+        if (st.waiters_.empty() && !st.pool_.empty()) {
+            SqlConnectionPtr handle = st.pool_.front();
+            st.pool_.pop_front();
+            checkout(st, handle);
+            st.stats_.add_wait(get_cur_time_millisec() - t0);
+            LOG(ll_INFO, _T("got connection") + get_stats(source_id));
+            return handle;
+        }
+        if (st.waiters_.empty() && st.has_room()) {
+            ++st.opening_;
+        }
+        else {
+            Waiter w(pool_mux_);
+            st.waiters_.push_back(&w);
+            LOG(ll_DEBUG, _T("waiting for connection") + get_stats(source_id));
+            MilliSec deadline = t0 + (MilliSec)timeout * 1000;
+            while (!w.handle_ && !w.may_open_) {
+                MilliSec left = deadline - get_cur_time_millisec();
+                if (left <= 0) {
+                    st.waiters_.erase(std::find(st.waiters_.begin(),
+                                st.waiters_.end(), &w));
+                    ++st.stats_.timeouts;
+                    LOG(ll_ERROR, _T("timed out waiting for connection")
+                            + get_stats(source_id));
+                    throw PoolError(_T("Timed out waiting for connection,"
+                                " source ID: ") + source_id);
+                }
+                w.cond_.wait(lock, (long)left);
+            }
+            if (w.handle_) {
+                st.stats_.add_wait(get_cur_time_millisec() - t0);
+                LOG(ll_INFO, _T("got connection") + get_stats(source_id));
+                return w.handle_;
+            }
+        }
+        src = st.source_;
     }
+    SqlConnectionPtr handle = open_connection(src);
+    ScopedLock lock(pool_mux_);
+    SourceState &st = sources_[source_id];
+    --st.opening_;
+    ++st.stats_.opened;
+    checkout(st, handle);
+    st.stats_.add_wait(get_cur_time_millisec() - t0);
+    LOG(ll_INFO, _T("opened connection") + get_stats(source_id));
     return handle;
 }
 
+SqlPool::SqlConnectionPtr
+SqlPool::get_for_read(const String &primary_id, int timeout)
+{
+    Strings replicas = pick_replicas(primary_id);
+    for (size_t i = 0; i < replicas.size(); ++i) {
+        try {
+            // no waiting here, the timeout is spent on the primary only
+            return get(replicas[i], 0);
+        }
+        catch (const PoolError &e) {
+            // the replica has got busy meanwhile, it's not broken
+            LOG(ll_WARNING, String(_T("replica is not available: "))
+                    + WIDEN(e.what()) + format_stats(replicas[i]));
+        }
+        catch (const std::exception &e) {
+            LOG(ll_ERROR, String(_T("replica failed: "))
+                    + WIDEN(e.what()) + format_stats(replicas[i]));
+            ScopedLock lock(pool_mux_);
+            sources_[replicas[i]].down_until_ =
+                time(NULL) + YB_POOL_REPLICA_RETRY;
+        }
+    }
+    return get(primary_id, timeout);
+}
+
 void
 SqlPool::put(SqlConnectionPtr handle, bool close_now)
 {
@@ -200,18 +608,28 @@ SqlPool::put(SqlConnectionPtr handle, bool close_now)
     if (handle->bad())
         close_now = true;
     const String source_id = handle->get_source().id();
+    MilliSec checked_out_at = handle->checked_out_at_;
+    int bad_marks = handle->stats_.bad_marks;
+    bool bad = handle->bad();
+    if (close_now) {
+        LOG(ll_DEBUG, _T("forced closing connection") + format_stats(source_id));
+        delete handle;
+    }
     ScopedLock lock(pool_mux_);
-    --counts_[source_id];
+    SourceState &st = sources_[source_id];
+    checkin(st, handle, checked_out_at);
     if (!close_now) {
-        handle->free_since_ = time(NULL);
-        pools_[source_id].push_back(handle);
-        LOG(ll_INFO, _T("put connection") + get_stats(source_id));
+        handle->free_since_ = handle->checked_at_ = time(NULL);
+        st.pool_.push_back(handle);
     }
-    else {
-        LOG(ll_DEBUG, _T("forced closing connection") + format_stats(source_id));
-        delete handle;
+    else
+        count_closed(st, bad_marks, bad);
+    // the oldest waiter gets the connection or a free slot
+    serve_waiters(st);
+    if (!close_now)
+        LOG(ll_INFO, _T("put connection") + get_stats(source_id));
+    else
         LOG(ll_INFO, _T("forced closed connection") + get_stats(source_id));
-    }
 }
 
 bool
@@ -219,15 +637,79 @@ SqlPool::reconnect(SqlConnectionPtr &conn)
 {
     const SqlSource source = conn->get_source();
     const String &source_id = source.id();
-    put(conn, true); // close now
+    {
+        // keep the slot reserved while reopening
+        ScopedLock lock(pool_mux_);
+        SourceState &st = sources_[source_id];
+        checkin(st, conn, conn->checked_out_at_);
+        count_closed(st, conn->stats_.bad_marks, conn->bad());
+        ++st.opening_;
+    }
     LOG(ll_DEBUG, _T("reopening connection") + format_stats(source_id));
+    delete conn;
+    conn = NULL;
+    conn = open_connection(source);
     ScopedLock lock(pool_mux_);
-    conn = new SqlConnection(source);
-    ++counts_[source_id];
+    SourceState &st = sources_[source_id];
+    --st.opening_;
+    ++st.stats_.opened;
+    ++st.stats_.reconnects;
+    checkout(st, conn);
     LOG(ll_INFO, _T("reopened connection") + get_stats(source_id));
     return true;
 }
 
+const SqlPoolStats
+SqlPool::get_pool_stats(const String &source_id)
+{
+    ScopedLock lock(pool_mux_);
+    const SourceState &st = find_source(source_id);
+    SqlPoolStats stats = st.stats_;
+    stats.in_use = st.in_use_;
+    stats.idle = st.pool_.size();
+    stats.opening = st.opening_;
+    stats.waiting = st.waiters_.size();
+    stats.max_size = st.max_size_;
+    MilliSec now = get_cur_time_millisec();
+    std::set<SqlConnectionPtr>::const_iterator i = st.checked_out_.begin(),
+        iend = st.checked_out_.end();
+    for (; i != iend; ++i)
+        if (now - (*i)->checked_out_at_ > stats.longest_hold)
+            stats.longest_hold = now - (*i)->checked_out_at_;
+    return stats;
+}
+
+const Strings
+SqlPool::get_source_ids()
+{
+    ScopedLock lock(pool_mux_);
+    Strings ids;
+    std::map<String, SourceState>::const_iterator i = sources_.begin(),
+        iend = sources_.end();
+    for (; i != iend; ++i)
+        ids.push_back(i->first);
+    return ids;
+}
+
+void
+SqlPool::set_statement_observer(SqlStatementObserver *observer)
+{
+    ScopedLock lock(pool_mux_);
+    observer_ = observer;
+}
+
+ElementTree::ElementPtr
+SqlPool::stats_to_json(const String &name)
+{
+    ElementTree::ElementPtr d = ElementTree::new_json_dict(name);
+    Strings ids = get_source_ids();
+    for (size_t i = 0; i < ids.size(); ++i) {
+        // the source's element name becomes the key
+        d->children_.push_back(get_pool_stats(ids[i]).to_json(ids[i]));
+    }
+    return d;
+}
+
 SqlConnectionVar::SqlConnectionVar(const SqlPoolDescr &d)
     : pool_(d.get_pool())
     , handle_(pool_.get(d.get_source_id(), d.get_timeout()))
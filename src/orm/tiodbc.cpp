@@ -29,6 +29,7 @@
 #include "util/string_type.h"
 #include "tiodbc.h"
 #include <memory>
+#include <algorithm>
 
 namespace {
 
@@ -105,6 +106,9 @@ SQLTCHAR_buf ybstring2sqltchar(const Yb::String &src,
 #define TIODBC_SUCCESS_CODE(rc) \
 	((rc==SQL_SUCCESS)||(rc==SQL_SUCCESS_WITH_INFO))
 
+// Wider character columns are not bound for block fetching
+#define TIODBC_MAX_BOUND_CHARS 4000
+
 namespace tiodbc
 {
 	// Current version
@@ -365,17 +369,47 @@ namespace tiodbc
 		return tmp_storage;
 	}
 
+	// Read a number from a block buffer, it's bound as one of the numeric C types
+	template<class T>
+	T __get_bound(const char *_data, SQLSMALLINT _c_type, const T &error_value)
+	{
+		switch (_c_type) {
+		case SQL_C_SLONG: {
+			SQLINTEGER x;
+			std::memcpy(&x, _data, sizeof(x));
+			return (T)x;
+		}
+		case SQL_C_SBIGINT: {
+			LongLong x;
+			std::memcpy(&x, _data, sizeof(x));
+			return (T)x;
+		}
+		case SQL_C_DOUBLE: {
+			double x;
+			std::memcpy(&x, _data, sizeof(x));
+			return (T)x;
+		}
+		}
+		return error_value;
+	}
+
 	//! @endcond
 
 	// Not direct contructable
 	field_impl::field_impl(HSTMT _stmt, int _col_num,
-			const _tstring _name, int _type)
+			const _tstring _name, int _type,
+			const char *_bound_data, SQLSMALLINT _bound_type, SQLLEN _bound_ind)
 		: stmt_h(_stmt)
 		, col_num(_col_num)
 		, name(_name)
 		, type(_type)
 		, is_null_flag(-1)
-	{}
+		, bound_data(_bound_data)
+		, bound_type(_bound_type)
+	{
+		if (bound_data)
+			is_null_flag = _bound_ind == SQL_NULL_DATA? 1: 0;
+	}
 
 	//! Destructor
 	field_impl::~field_impl()
@@ -388,6 +422,8 @@ namespace tiodbc
 		, name(r.name)
 		, type(r.type)
 		, is_null_flag(r.is_null_flag)
+		, bound_data(r.bound_data)
+		, bound_type(r.bound_type)
 	{}
 
 	// Copy operator
@@ -398,12 +434,23 @@ namespace tiodbc
 		name = r.name;
 		type = r.type;
 		is_null_flag = r.is_null_flag;
+		bound_data = r.bound_data;
+		bound_type = r.bound_type;
 		return *this;
 	}
 
 	// Get field as string
 	_tstring field_impl::as_string() const
 	{
+		if (bound_data) {
+			if (is_null_flag)
+				return _tstring();
+			if (bound_type == SQL_C_TCHAR)
+				return sqltchar2ybstring((const SQLTCHAR *)bound_data, "");
+			if (bound_type == SQL_C_DOUBLE)
+				return Yb::to_string(as_double());
+			return Yb::to_string(as_long_long());
+		}
 		if (is_null_flag != -1)
 			return str_buf;
 
@@ -444,42 +491,56 @@ namespace tiodbc
 	// Get field as long
 	long field_impl::as_long() const
 	{
+		if (bound_data)
+			return __get_bound<long>(bound_data, bound_type, 0);
 		return __get_data<long>(stmt_h, col_num, SQL_C_SLONG, 0, is_null_flag);
 	}
 
 	// Get field as unsigned long
 	unsigned long field_impl::as_unsigned_long() const
 	{
+		if (bound_data)
+			return __get_bound<unsigned long>(bound_data, bound_type, 0);
 		return __get_data<unsigned long>(stmt_h, col_num, SQL_C_ULONG, 0, is_null_flag);
 	}
 
 	// Get field as short
 	short field_impl::as_short() const
 	{
+		if (bound_data)
+			return __get_bound<short>(bound_data, bound_type, 0);
 		return __get_data<short>(stmt_h, col_num, SQL_C_SSHORT, 0, is_null_flag);
 	}
 
 	// Get field as unsigned short
 	unsigned short field_impl::as_unsigned_short() const
 	{
+		if (bound_data)
+			return __get_bound<unsigned short>(bound_data, bound_type, 0);
 		return __get_data<unsigned short>(stmt_h, col_num, SQL_C_USHORT, 0, is_null_flag);
 	}
 
 	// Get field as long long
 	LongLong field_impl::as_long_long() const
 	{
+		if (bound_data)
+			return __get_bound<LongLong>(bound_data, bound_type, 0);
 		return __get_data<LongLong>(stmt_h, col_num, SQL_C_SBIGINT, 0, is_null_flag);
 	}
 
 	// Get field as double
 	double field_impl::as_double() const
 	{
+		if (bound_data)
+			return __get_bound<double>(bound_data, bound_type, 0);
 		return __get_data<double>(stmt_h, col_num, SQL_C_DOUBLE, 0, is_null_flag);
 	}
 
 	// Get field as float
 	float field_impl::as_float() const
 	{
+		if (bound_data)
+			return __get_bound<float>(bound_data, bound_type, 0);
 		return __get_data<float>(stmt_h, col_num, SQL_C_FLOAT, 0, is_null_flag);
 	}
 
@@ -488,6 +549,11 @@ namespace tiodbc
 	{
 		TIMESTAMP_STRUCT def_val;
 		std::memset(&def_val, 0, sizeof(def_val));
+		if (bound_data) {
+			if (!is_null_flag && bound_type == SQL_C_TIMESTAMP)
+				std::memcpy(&def_val, bound_data, sizeof(def_val));
+			return def_val;
+		}
 		return __get_data<TIMESTAMP_STRUCT>(stmt_h, col_num, SQL_C_TIMESTAMP, def_val, is_null_flag);
 	}
 
@@ -653,6 +719,129 @@ namespace tiodbc
 		set_as_string(_tstring(), true);
 	}
 
+	///////////////////////////////////////////////////////////////////////////////////
+	// PARAM ARRAY IMPLEMENTATION
+	///////////////////////////////////////////////////////////////////////////////////
+
+	// Constructor
+	param_array::param_array(HSTMT _stmt, int _par_num, size_t _rows)
+		: stmt_h(_stmt)
+		, par_num(_par_num)
+		, rows(_rows)
+		, c_type(0)
+		, elem_sz(0)
+		, ind(_rows, SQL_NULL_DATA)
+	{
+	}
+
+	// Get the place for a value, the first value sets the type
+	char * param_array::slot(size_t _row, SQLSMALLINT _c_type, int _elem_sz)
+	{
+		if (!c_type) {
+			c_type = _c_type;
+			elem_sz = _elem_sz;
+			buffer.resize(rows * elem_sz);
+		}
+		else if (c_type != _c_type || _row >= rows)
+			throw bind_error(par_num);
+		return &buffer[_row * elem_sz];
+	}
+
+	// Set as string
+	void param_array::set_as_string(size_t _row, const _tstring & _str)
+	{
+		if (!c_type) {
+			c_type = SQL_C_TCHAR;
+			strings.resize(rows);
+		}
+		else if (c_type != SQL_C_TCHAR || _row >= rows)
+			throw bind_error(par_num);
+		SQLTCHAR_buf data(ybstring2sqltchar(_str, ""));
+		strings[_row].assign(data.data, data.data + data.len);
+		ind[_row] = SQL_NTS;
+	}
+
+	// Set as long
+	void param_array::set_as_long(size_t _row, const long & _value)
+	{
+		// The array stride is the size of SQL_C_SLONG, not of long
+		SQLINTEGER x = (SQLINTEGER)_value;
+		std::memcpy(slot(_row, SQL_C_SLONG, sizeof(x)), &x, sizeof(x));
+		ind[_row] = 0;
+	}
+
+	// Set as long long
+	void param_array::set_as_long_long(size_t _row, const LongLong & _value)
+	{
+		std::memcpy(slot(_row, SQL_C_SBIGINT, sizeof(_value)),
+				&_value, sizeof(_value));
+		ind[_row] = 0;
+	}
+
+	// Set as double
+	void param_array::set_as_double(size_t _row, const double & _value)
+	{
+		std::memcpy(slot(_row, SQL_C_DOUBLE, sizeof(_value)),
+				&_value, sizeof(_value));
+		ind[_row] = 0;
+	}
+
+	// Set as DateTime
+	void param_array::set_as_date_time(size_t _row,
+			const TIMESTAMP_STRUCT & _value)
+	{
+		std::memcpy(slot(_row, SQL_C_TYPE_TIMESTAMP, sizeof(_value)),
+				&_value, sizeof(_value));
+		ind[_row] = _value.year == 0? SQL_NULL_DATA: 0;
+	}
+
+	// Set as NULL
+	void param_array::set_as_null(size_t _row)
+	{
+		if (_row >= rows)
+			throw bind_error(par_num);
+		ind[_row] = SQL_NULL_DATA;
+	}
+
+	// Bind the whole array
+	void param_array::bind()
+	{
+		// An array of NULLs is bound as strings
+		if (!c_type) {
+			c_type = SQL_C_TCHAR;
+			strings.resize(rows);
+		}
+		SQLSMALLINT sql_type;
+		int col_sz = 0;
+		if (c_type == SQL_C_TCHAR) {
+			// Lay out the strings in fixed size slots
+			size_t max_len = 1;
+			for (size_t i = 0; i < rows; ++i)
+				if (strings[i].size() > max_len)
+					max_len = strings[i].size();
+			elem_sz = max_len * sizeof(SQLTCHAR);
+			buffer.assign(rows * elem_sz, 0);
+			for (size_t i = 0; i < rows; ++i)
+				if (strings[i].size())
+					std::memcpy(&buffer[i * elem_sz], &strings[i][0],
+							strings[i].size() * sizeof(SQLTCHAR));
+			sql_type = SQL_CHAR;
+			col_sz = elem_sz - 1;
+		}
+		else if (c_type == SQL_C_SLONG)
+			sql_type = SQL_INTEGER;
+		else if (c_type == SQL_C_SBIGINT)
+			sql_type = SQL_BIGINT;
+		else if (c_type == SQL_C_DOUBLE)
+			sql_type = SQL_DOUBLE;
+		else {
+			sql_type = SQL_TYPE_TIMESTAMP;
+			col_sz = 23;
+		}
+		__bind_param(stmt_h, par_num, c_type, sql_type,
+				&buffer[0], ind[0], col_sz, elem_sz);
+	}
+
 	///////////////////////////////////////////////////////////////////////////////////
 	// STATEMENT IMPLEMENTATION
 	///////////////////////////////////////////////////////////////////////////////////
@@ -661,7 +850,13 @@ namespace tiodbc
 	statement::statement()
 		:stmt_h(NULL),
 		b_open(false),
-		b_col_info_needed(false)
+		b_col_info_needed(false),
+		m_paramset_size(1),
+		m_params_processed(0),
+		m_row_array_size(1),
+		b_block_mode(false),
+		m_rows_fetched(0),
+		m_block_pos(0)
 	{
 	}
 
@@ -669,7 +864,13 @@ namespace tiodbc
 	statement::statement(connection & _conn, const _tstring & _stmt)
 		:stmt_h(NULL),
 		b_open(false),
-		b_col_info_needed(false)
+		b_col_info_needed(false),
+		m_paramset_size(1),
+		m_params_processed(0),
+		m_row_array_size(1),
+		b_block_mode(false),
+		m_rows_fetched(0),
+		m_block_pos(0)
 	{
 		prepare(_conn, _stmt);
 	}
@@ -706,13 +907,13 @@ namespace tiodbc
 		if (is_open())
 		{
 			// Free parameters
-			param_it it;
-			for(it = m_params.begin();it != m_params.end();it++)
-				delete it->second;
-			m_params.clear();
+			free_params();
+			m_paramset_size = 1;
 
 			// Free result if any
 			free_results();
+			m_bound_cols.clear();
+			b_block_mode = false;
 
 			// Free handle
 			SQLFreeHandle(SQL_HANDLE_STMT, stmt_h);
@@ -724,9 +925,10 @@ namespace tiodbc
 	// Free results (aka SQLCloseCursor)
 	void statement::free_results()
 	{
-		// Close cursor if we have an open connection
+		// Close cursor if we have an open connection,
+		// unlike SQLCloseCursor it's not an error if there is none
 		if (is_open())
-			SQLCloseCursor(stmt_h);
+			SQLFreeStmt(stmt_h, SQL_CLOSE);
 	}
 
 	// Prepare statement
@@ -821,6 +1023,138 @@ namespace tiodbc
 		return true;
 	}
 
+	// Set the number of rows to fetch at once
+	void statement::set_row_array_size(size_t _rows)
+	{
+		if (_rows < 1)
+			_rows = 1;
+		if (_rows != m_row_array_size) {
+			m_row_array_size = _rows;
+			unbind_cols();
+		}
+	}
+
+	// Bind the result set columns to block buffers
+	bool statement::bind_cols()
+	{
+		if (!m_cols.size())
+			return false;
+		std::vector<bound_col> cols(m_cols.size());
+		for (size_t i = 0; i < m_cols.size(); ++i) {
+			bound_col &c = cols[i];
+			SQLULEN chars = m_cols[i].col_size;
+			switch (m_cols[i].type) {
+			case SQL_INTEGER:
+			case SQL_SMALLINT:
+			case SQL_TINYINT:
+				c.c_type = SQL_C_SLONG;
+				c.elem_sz = sizeof(SQLINTEGER);
+				break;
+			case SQL_BIGINT:
+				c.c_type = SQL_C_SBIGINT;
+				c.elem_sz = sizeof(LongLong);
+				break;
+			case SQL_REAL:
+			case SQL_FLOAT:
+			case SQL_DOUBLE:
+				c.c_type = SQL_C_DOUBLE;
+				c.elem_sz = sizeof(double);
+				break;
+			case SQL_DATE:
+			case SQL_TIMESTAMP:
+			case SQL_TYPE_DATE:
+			case SQL_TYPE_TIME:
+			case SQL_TYPE_TIMESTAMP:
+				c.c_type = SQL_C_TIMESTAMP;
+				c.elem_sz = sizeof(TIMESTAMP_STRUCT);
+				break;
+			case SQL_LONGVARCHAR:
+			case SQL_WLONGVARCHAR:
+			case SQL_LONGVARBINARY:
+				// Long data is read with SQLGetData only
+				return false;
+			case SQL_DECIMAL:
+			case SQL_NUMERIC:
+				// Sign and decimal point
+				chars += 2;
+				// fall through
+			default:
+				if (m_cols[i].type == SQL_BINARY || m_cols[i].type == SQL_VARBINARY)
+					chars *= 2;	// Hex digits
+				if (!m_cols[i].col_size || chars > TIODBC_MAX_BOUND_CHARS)
+					return false;
+				c.c_type = SQL_C_TCHAR;
+				{
+					// The size counts characters, while a character may
+					// take up to 4 bytes of UTF-8 or 2 units of UTF-16
+					SQLLEN bytes = chars * (sizeof(SQLTCHAR) == 1? 4: 2 * sizeof(SQLTCHAR));
+					SQLLEN octets = 0;
+					RETCODE rc = SQLColAttribute(stmt_h, i + 1, SQL_DESC_OCTET_LENGTH,
+							NULL, 0, NULL, &octets);
+					if (TIODBC_SUCCESS_CODE(rc) && octets > bytes)
+						bytes = octets;
+					c.elem_sz = bytes + sizeof(SQLTCHAR);
+				}
+			}
+		}
+
+		RETCODE rc;
+		SQLULEN rows = m_row_array_size;
+		rc = SQLSetStmtAttr(stmt_h, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)rows, 0);
+		if (TIODBC_SUCCESS_CODE(rc)) {
+			// The driver may substitute a value it supports
+			rows = 0;
+			rc = SQLGetStmtAttr(stmt_h, SQL_ATTR_ROW_ARRAY_SIZE,
+					&rows, 0, NULL);
+		}
+		if (!TIODBC_SUCCESS_CODE(rc) || rows != m_row_array_size) {
+			// No block cursors, don't try again with this statement
+			SQLSetStmtAttr(stmt_h, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+			m_row_array_size = 1;
+			return false;
+		}
+		rc = SQLSetStmtAttr(stmt_h, SQL_ATTR_ROWS_FETCHED_PTR, &m_rows_fetched, 0);
+		if (!TIODBC_SUCCESS_CODE(rc)) {
+			unbind_cols();
+			return false;
+		}
+		m_row_status.assign(m_row_array_size, SQL_ROW_NOROW);
+		rc = SQLSetStmtAttr(stmt_h, SQL_ATTR_ROW_STATUS_PTR, &m_row_status[0], 0);
+		if (!TIODBC_SUCCESS_CODE(rc)) {
+			unbind_cols();
+			return false;
+		}
+
+		m_bound_cols.swap(cols);
+		for (size_t i = 0; i < m_bound_cols.size(); ++i) {
+			bound_col &c = m_bound_cols[i];
+			c.buffer.assign(m_row_array_size * c.elem_sz, 0);
+			c.ind.assign(m_row_array_size, SQL_NULL_DATA);
+			rc = SQLBindCol(stmt_h, i + 1, c.c_type,
+					&c.buffer[0], c.elem_sz, &c.ind[0]);
+			if (!TIODBC_SUCCESS_CODE(rc)) {
+				unbind_cols();
+				return false;
+			}
+		}
+		b_block_mode = true;
+		return true;
+	}
+
+	// Get back to fetching rows one by one
+	void statement::unbind_cols()
+	{
+		if (is_open() && (b_block_mode || m_bound_cols.size())) {
+			SQLFreeStmt(stmt_h, SQL_UNBIND);
+			SQLSetStmtAttr(stmt_h, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+			SQLSetStmtAttr(stmt_h, SQL_ATTR_ROWS_FETCHED_PTR, NULL, 0);
+			SQLSetStmtAttr(stmt_h, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
+		}
+		m_bound_cols.clear();
+		m_row_status.clear();
+		b_block_mode = false;
+	}
+
 	// Fetch next
 	bool statement::fetch_next()
 	{
@@ -831,6 +1165,25 @@ namespace tiodbc
 		if (b_col_info_needed) {
 			b_col_info_needed = false;
 			describe_cols();
+			m_rows_fetched = 0;
+			m_block_pos = 0;
+			// The buffers stay bound while the statement is re-executed
+			if (m_row_array_size > 1 && !b_block_mode)
+				bind_cols();
+		}
+
+		if (b_block_mode) {
+			if (++m_block_pos >= m_rows_fetched) {
+				m_block_pos = 0;
+				m_rows_fetched = 0;
+				rc = SQLFetch(stmt_h);
+				if (!TIODBC_SUCCESS_CODE(rc) || !m_rows_fetched)
+					return false;
+			}
+			// A block may be fetched with some of its rows failed
+			if (m_row_status[m_block_pos] == SQL_ROW_ERROR)
+				throw row_error(m_block_pos + 1);
+			return true;
 		}
 
 		rc = SQLFetch(stmt_h);
@@ -843,9 +1196,67 @@ namespace tiodbc
 	const field_impl statement::field(int _num) const
 	{
 		_tstring name = sqltchar2ybstring(m_cols[_num - 1].name, "");
+		if (b_block_mode) {
+			const bound_col &c = m_bound_cols[_num - 1];
+			SQLLEN ind = c.ind[m_block_pos];
+			if (c.c_type == SQL_C_TCHAR && ind != SQL_NULL_DATA) {
+				bool truncated = ind == SQL_NO_TOTAL ||
+					ind > c.elem_sz - (SQLLEN)sizeof(SQLTCHAR);
+				// A row with warnings may hold a truncated value even if
+				// the length indicator looks fine, so read it again
+				if (truncated ||
+						m_row_status[m_block_pos] == SQL_ROW_SUCCESS_WITH_INFO)
+				{
+					field_impl f(stmt_h, _num, name, m_cols[_num - 1].type);
+					try {
+						f.str_buf = get_truncated(_num);
+					}
+					catch (const fetch_error &) {
+						if (truncated)
+							throw;
+						return field_impl(stmt_h, _num, name, m_cols[_num - 1].type,
+								&c.buffer[m_block_pos * c.elem_sz], c.c_type, ind);
+					}
+					f.is_null_flag = 0;
+					return f;
+				}
+			}
+			return field_impl(stmt_h, _num, name, m_cols[_num - 1].type,
+					&c.buffer[m_block_pos * c.elem_sz], c.c_type, ind);
+		}
 		return field_impl(stmt_h, _num, name, m_cols[_num - 1].type);
 	}
 
+	// Read again a value truncated in the block buffer
+	_tstring statement::get_truncated(int _num) const
+	{
+		RETCODE rc = SQLSetPos(stmt_h, m_block_pos + 1, SQL_POSITION, SQL_LOCK_NO_CHANGE);
+		if (!TIODBC_SUCCESS_CODE(rc))
+			throw fetch_error(_num);
+		// A chunk may end in the middle of a multibyte character,
+		// so collect the raw units first and convert them at once
+		std::vector<SQLTCHAR> raw;
+		SQLTCHAR buff[1024];
+		for (;;) {
+			SQLLEN sz_needed = 0;
+			buff[0] = 0;
+			rc = SQLGetData(stmt_h, _num, SQL_C_TCHAR, buff, sizeof(buff), &sz_needed);
+			if (rc == SQL_NO_DATA)
+				break;
+			if (!TIODBC_SUCCESS_CODE(rc) || sz_needed == SQL_NULL_DATA)
+				throw fetch_error(_num);
+			size_t len = 0;
+			while (len < sizeof(buff) / sizeof(SQLTCHAR) - 1 && buff[len])
+				++len;
+			raw.insert(raw.end(), buff, buff + len);
+			// SQL_SUCCESS_WITH_INFO means there is more data
+			if (rc == SQL_SUCCESS)
+				break;
+		}
+		raw.push_back(0);
+		return sqltchar2ybstring(&raw[0], "");
+	}
+
 	// Count columns of the result
 	int statement::count_columns() const
 	{
@@ -903,13 +1314,119 @@ namespace tiodbc
 		return *m_params[_num];
 	}
 
+	// Set the number of parameter sets
+	bool statement::set_paramset_size(size_t _rows)
+	{
+		if (!is_open())
+			return false;
+
+		for (param_array_it it = m_param_arrays.begin();
+				it != m_param_arrays.end(); ++it)
+			delete it->second;
+		m_param_arrays.clear();
+
+		SQLULEN rows = _rows;
+		RETCODE rc = SQLSetStmtAttr(stmt_h, SQL_ATTR_PARAMSET_SIZE,
+				(SQLPOINTER)rows, 0);
+		if (TIODBC_SUCCESS_CODE(rc)) {
+			// The driver may substitute a value it supports
+			rows = 0;
+			rc = SQLGetStmtAttr(stmt_h, SQL_ATTR_PARAMSET_SIZE,
+					&rows, 0, NULL);
+		}
+		m_paramset_size = TIODBC_SUCCESS_CODE(rc)? (size_t)rows: 0;
+		if (m_paramset_size == _rows) {
+			// A batch with some of the sets failed may still
+			// return SQL_SUCCESS_WITH_INFO, so the status of every
+			// parameter set is checked after the execution
+			m_param_status.assign(_rows, SQL_PARAM_UNUSED);
+			m_params_processed = 0;
+			rc = SQLSetStmtAttr(stmt_h, SQL_ATTR_PARAM_STATUS_PTR,
+					&m_param_status[0], 0);
+			if (TIODBC_SUCCESS_CODE(rc))
+				rc = SQLSetStmtAttr(stmt_h, SQL_ATTR_PARAMS_PROCESSED_PTR,
+						&m_params_processed, 0);
+			if (TIODBC_SUCCESS_CODE(rc))
+				return true;
+		}
+		SQLSetStmtAttr(stmt_h, SQL_ATTR_PARAM_STATUS_PTR, NULL, 0);
+		SQLSetStmtAttr(stmt_h, SQL_ATTR_PARAMS_PROCESSED_PTR, NULL, 0);
+		SQLSetStmtAttr(stmt_h, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+		m_paramset_size = 1;
+		m_param_status.clear();
+		return false;
+	}
+
+	// Handle a parameter array
+	param_array & statement::array_param(int _num)
+	{
+		// Add a new if there isn't one
+		if (0 == m_param_arrays.count(_num))
+			m_param_arrays[_num] = new param_array(stmt_h, _num,
+					m_paramset_size);
+
+		return *m_param_arrays[_num];
+	}
+
+	// Execute for all parameter sets
+	bool statement::execute_arrays()
+	{
+		if (!is_open())
+			return false;
+
+		for (param_array_it it = m_param_arrays.begin();
+				it != m_param_arrays.end(); ++it)
+			it->second->bind();
+
+		m_params_processed = 0;
+		std::fill(m_param_status.begin(), m_param_status.end(),
+				(SQLUSMALLINT)SQL_PARAM_UNUSED);
+		if (!execute())
+			return false;
+		return failed_paramset() < 0;
+	}
+
+	// The first parameter set that failed or has not been processed
+	int statement::failed_paramset() const
+	{
+		for (size_t i = 0; i < m_param_status.size(); ++i) {
+			if (i >= m_params_processed)
+				return (int)i;
+			if (m_param_status[i] == SQL_PARAM_ERROR ||
+					m_param_status[i] == SQL_PARAM_UNUSED)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	// Free parameter handlers
+	void statement::free_params()
+	{
+		for (param_it it = m_params.begin(); it != m_params.end(); ++it)
+			delete it->second;
+		m_params.clear();
+		for (param_array_it it = m_param_arrays.begin();
+				it != m_param_arrays.end(); ++it)
+			delete it->second;
+		m_param_arrays.clear();
+	}
+
 	// Reset parameters (unbind all parameters
 	void statement::reset_parameters()
 	{
 		if (!is_open())
 			return;
 
+		if (m_paramset_size != 1) {
+			SQLSetStmtAttr(stmt_h, SQL_ATTR_PARAM_STATUS_PTR, NULL, 0);
+			SQLSetStmtAttr(stmt_h, SQL_ATTR_PARAMS_PROCESSED_PTR, NULL, 0);
+			SQLSetStmtAttr(stmt_h, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+			m_paramset_size = 1;
+			m_param_status.clear();
+		}
 		SQLFreeStmt(stmt_h, SQL_RESET_PARAMS);
+		// The handlers must bind again on the next use
+		free_params();
 	}
 
 }	// !namespace tiodbc
@@ -92,6 +92,29 @@ get_cur_time_millisec()
 #endif
 }
 
+YBUTIL_DECL MicroSec
+get_monotonic_microsec()
+{
+#if defined(__unix__) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        MicroSec r = ts.tv_sec;
+        r *= 1000000;
+        r += ts.tv_nsec / 1000;
+        return r;
+    }
+    return get_cur_time_millisec() * 1000;
+#elif defined(YBUTIL_WINDOWS)
+    LARGE_INTEGER freq, cnt;
+    if (QueryPerformanceFrequency(&freq) && QueryPerformanceCounter(&cnt))
+        return (MicroSec)(cnt.QuadPart / freq.QuadPart * 1000000
+                + cnt.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+    return get_cur_time_millisec() * 1000;
+#else
+    return get_cur_time_millisec() * 1000;
+#endif
+}
+
 YBUTIL_DECL struct tm *localtime_safe(const time_t *clock, struct tm *result)
 {
     if (!clock || !result)
@@ -121,6 +144,13 @@ int LogRecord::check_level(int level)
     return level;
 }
 
+LogRecord::LogRecord()
+    : t_(0)
+    , pid_(0)
+    , tid_(0)
+    , level_(ll_NONE)
+{}
+
 LogRecord::LogRecord(int level, const std::string &component,
                      const std::string &msg)
     : t_(get_cur_time_millisec())
@@ -131,6 +161,16 @@ LogRecord::LogRecord(int level, const std::string &component,
     , msg_(msg)
 {}
 
+void LogRecord::swap(LogRecord &other)
+{
+    std::swap(t_, other.t_);
+    std::swap(pid_, other.pid_);
+    std::swap(tid_, other.tid_);
+    std::swap(level_, other.level_);
+    component_.swap(other.component_);
+    msg_.swap(other.msg_);
+}
+
 const char *LogRecord::get_level_name() const
 {
     static const char *log_level_name[] = {
@@ -144,15 +184,26 @@ const char *LogRecord::get_level_name() const
     }
 }
 
+int ILogAppender::get_levels_version()
+{
+    return -1;
+}
+
 ILogAppender::~ILogAppender()
 {}
 
+bool ILogger::enabled(int level)
+{
+    return level <= get_level();
+}
+
 ILogger::~ILogger()
 {}
 
 Logger::Logger(ILogAppender *appender, const std::string &name)
     : appender_(appender)
     , name_(name)
+    , cached_level_(-1)
 {}
 
 ILogger::Ptr Logger::new_logger(const std::string &name)
@@ -193,10 +244,27 @@ void Logger::log(int level, const std::string &msg)
 {
     if (level <= ll_NONE || level > ll_TRACE)
         throw InvalidLogLevel();
+    if (!enabled(level))
+        return;
     LogRecord rec(level, get_name(), msg);
     appender_->append(rec);
 }
 
+bool Logger::enabled(int level)
+{
+    int version = appender_->get_levels_version();
+    if (version < 0)
+        return level <= appender_->get_level(get_name());
+    version &= 0x7ffffff;
+    int cached = cached_level_;
+    if (cached < 0 || (cached >> 4) != version) {
+        // the appender filters records by their component name
+        cached = (version << 4) | appender_->get_level(get_name());
+        cached_level_ = cached;
+    }
+    return level <= (cached & 15);
+}
+
 const std::string Logger::get_name() const
 {
     return name_.empty()? std::string("main"): name_;
@@ -268,6 +336,7 @@ LogAppender::LogAppender(std::ostream &s, int flush_interval)
     : s_(s)
     , last_flush_(time(NULL))
     , flush_interval_(flush_interval)
+    , levels_version_(0)
 {}
 
 LogAppender::~LogAppender()
@@ -302,6 +371,7 @@ int LogAppender::get_level(const std::string &name)
 void LogAppender::set_level(const std::string &name, int level)
 {
     ScopedLock lk(queue_mutex_);
+    ++levels_version_;
     if (name.size() >= 2 && name.substr(name.size() - 2) == ".*")
     {
         std::string prefix = name.substr(0, name.size() - 1);
@@ -322,6 +392,11 @@ void LogAppender::set_level(const std::string &name, int level)
     }
 }
 
+int LogAppender::get_levels_version()
+{
+    return levels_version_;
+}
+
 void LogAppender::flush()
 {
     ScopedLock lk(queue_mutex_);
@@ -329,6 +404,109 @@ void LogAppender::flush()
     do_flush(now);
 }
 
+AsyncLogWriter::AsyncLogWriter(AsyncLogAppender *appender)
+    : appender_(appender)
+{}
+
+void AsyncLogWriter::on_run()
+{
+    appender_->writer_thread();
+}
+
+#ifdef _MSC_VER
+#pragma warning(disable:4355)
+#endif // _MSC_VER
+
+AsyncLogAppender::AsyncLogAppender(std::ostream &s, size_t capacity,
+        int overflow)
+    // flushing is driven by the writer thread
+    : LogAppender(s, 1000000000)
+    , ring_(capacity? capacity: 1)
+    , head_(0)
+    , count_(0)
+    , overflow_(overflow)
+    , stop_(false)
+    , appended_(0)
+    , written_(0)
+    , dropped_(0)
+    , not_empty_(ring_mux_)
+    , not_full_(ring_mux_)
+    , written_cond_(ring_mux_)
+    , writer_(this)
+{
+    writer_.start();
+}
+
+AsyncLogAppender::~AsyncLogAppender()
+{
+    {
+        ScopedLock lock(ring_mux_);
+        stop_ = true;
+        not_empty_.notify_one();
+        not_full_.notify_all();
+    }
+    writer_.wait();
+}
+
+void AsyncLogAppender::append(const LogRecord &rec)
+{
+    // copy the strings before taking the lock
+    LogRecord tmp(rec);
+    ScopedLock lock(ring_mux_);
+    while (count_ == ring_.size()) {
+        if (overflow_ != BLOCK || stop_) {
+            ++dropped_;
+            return;
+        }
+        not_full_.wait(lock);
+    }
+    ring_[(head_ + count_) % ring_.size()].swap(tmp);
+    ++count_;
+    ++appended_;
+    if (count_ == 1)
+        not_empty_.notify_one();
+}
+
+void AsyncLogAppender::flush()
+{
+    ScopedLock lock(ring_mux_);
+    LongInt target = appended_;
+    while (written_ < target && !stop_)
+        written_cond_.wait(lock);
+}
+
+LongInt AsyncLogAppender::get_dropped()
+{
+    ScopedLock lock(ring_mux_);
+    return dropped_;
+}
+
+void AsyncLogAppender::writer_thread()
+{
+    std::vector<LogRecord> batch;
+    while (true) {
+        {
+            ScopedLock lock(ring_mux_);
+            while (!count_ && !stop_)
+                not_empty_.wait(lock);
+            if (!count_)
+                break;
+            batch.resize(count_);
+            for (size_t i = 0; i < batch.size(); ++i)
+                batch[i].swap(ring_[(head_ + i) % ring_.size()]);
+            head_ = (head_ + count_) % ring_.size();
+            count_ = 0;
+            not_full_.notify_all();
+        }
+        for (size_t i = 0; i < batch.size(); ++i)
+            LogAppender::append(batch[i]);
+        LogAppender::flush();
+        ScopedLock lock(ring_mux_);
+        written_ += batch.size();
+        written_cond_.notify_all();
+    }
+}
+
 } // namespace Yb
 
 #if 0
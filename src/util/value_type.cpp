@@ -3,6 +3,7 @@
 
 #include <time.h>
 #include <stdio.h>
+#include <new>
 #include <iomanip>
 #include "util/string_utils.h"
 #include "util/value_type.h"
@@ -22,6 +23,45 @@ static inline const T__ &get_as(const void *data) {
     return *reinterpret_cast<const T__ *>(data);
 }
 
+template <class T__>
+static inline void destroy_as(void *data) {
+    get_as<T__>(data).~T__();
+}
+
+// move a payload between raw storage areas, the source is left unconstructed
+template <class T__>
+static inline void relocate_copy(void *to, void *from) {
+    new (to) T__(get_as<T__>(from));
+    destroy_as<T__>(from);
+}
+
+template <class T__>
+static inline void relocate_swap(void *to, void *from) {
+    new (to) T__();
+    get_as<T__>(to).swap(get_as<T__>(from));
+    destroy_as<T__>(from);
+}
+
+static inline void relocate(int type, void *to, void *from)
+{
+    switch (type) {
+    case Value::STRING:
+        relocate_swap<String>(to, from);
+        break;
+    case Value::DECIMAL:
+        relocate_copy<Decimal>(to, from);
+        break;
+    case Value::DATETIME:
+        relocate_copy<DateTime>(to, from);
+        break;
+    case Value::BLOB:
+        relocate_swap<Blob>(to, from);
+        break;
+    default:
+        memcpy(to, from, sizeof(LongInt));
+    }
+}
+
 const int &
 Value::read_as_integer() const { return get_as<int>(&data_); }
 
@@ -29,41 +69,44 @@ const LongInt &
 Value::read_as_longint() const { return get_as<LongInt>(&data_); }
 
 const String &
-Value::read_as_string() const { return *get_as<const String *>(&data_); }
+Value::read_as_string() const { return get_as<String>(&data_); }
 
 const Decimal &
-Value::read_as_decimal() const { return *get_as<const Decimal *>(&data_); }
+Value::read_as_decimal() const { return get_as<Decimal>(&data_); }
 
 const DateTime &
-Value::read_as_datetime() const { return *get_as<const DateTime *>(&data_); }
+Value::read_as_datetime() const { return get_as<DateTime>(&data_); }
 
 const double &
 Value::read_as_float() const { return get_as<double>(&data_); }
 
 const Blob &
-Value::read_as_blob() const { return *get_as<const Blob *>(&data_); }
+Value::read_as_blob() const { return get_as<Blob>(&data_); }
 
 ValueIsNull::ValueIsNull()
     : ValueError(_T("Trying to get value of null"))
 {}
 
 void
-Value::init()
+Value::init(const Value &other)
 {
-    switch (type_) {
+    switch (other.type_) {
     case STRING:
-        get_as<String *>(&data_) = new String();
+        new (&data_) String(other.read_as_string());
         break;
     case DECIMAL:
-        get_as<Decimal *>(&data_) = new Decimal();
+        new (&data_) Decimal(other.read_as_decimal());
         break;
     case DATETIME:
-        get_as<DateTime *>(&data_) = new DateTime();
+        new (&data_) DateTime(other.read_as_datetime());
         break;
     case BLOB:
-        get_as<Blob *>(&data_) = new Blob();
+        new (&data_) Blob(other.read_as_blob());
         break;
+    default:
+        data_.l_ = other.data_.l_;
     }
+    type_ = other.type_;
 }
 
 void
@@ -71,21 +114,20 @@ Value::destroy()
 {
     switch (type_) {
     case STRING:
-        delete get_as<String *>(&data_);
+        destroy_as<String>(&data_);
         break;
     case DECIMAL:
-        delete get_as<Decimal *>(&data_);
+        destroy_as<Decimal>(&data_);
         break;
     case DATETIME:
-        delete get_as<DateTime *>(&data_);
+        destroy_as<DateTime>(&data_);
         break;
     case BLOB:
-        delete get_as<Blob *>(&data_);
+        destroy_as<Blob>(&data_);
         break;
-    default:
-        return;
     }
-    get_as<void *>(&data_) = NULL;
+    type_ = INVALID;
+    data_.l_ = 0;
 }
 
 void
@@ -93,99 +135,90 @@ Value::assign(const Value &other)
 {
     if (type_ != other.type_) {
         destroy();
-        type_ = other.type_;
-        init();
+        init(other);
+        return;
     }
     switch (type_) {
-    case INTEGER:
-        get_as<int>(&data_) = other.read_as_integer();
-        break;
-    case LONGINT:
-        get_as<LongInt>(&data_) = other.read_as_longint();
-        break;
     case STRING:
-        *get_as<String *>(&data_) = other.read_as_string();
+        get_as<String>(&data_) = other.read_as_string();
         break;
     case DECIMAL:
-        *get_as<Decimal *>(&data_) = other.read_as_decimal();
+        get_as<Decimal>(&data_) = other.read_as_decimal();
         break;
     case DATETIME:
-        *get_as<DateTime *>(&data_) = other.read_as_datetime();
-        break;
-    case FLOAT:
-        get_as<double>(&data_) = other.read_as_float();
+        get_as<DateTime>(&data_) = other.read_as_datetime();
         break;
     case BLOB:
-        *get_as<Blob *>(&data_) = other.read_as_blob();
+        get_as<Blob>(&data_) = other.read_as_blob();
         break;
+    default:
+        data_.l_ = other.data_.l_;
     }
 }
 
 Value::Value()
     : type_(INVALID)
-    , data_(0)
-{}
+{
+    data_.l_ = 0;
+}
 
 Value::Value(const int &x)
     : type_(INTEGER)
-    , data_(0)
 {
+    data_.l_ = 0;
     get_as<int>(&data_) = x;
 }
 
 Value::Value(const LongInt &x)
     : type_(LONGINT)
-    , data_(x)
-{}
+{
+    data_.l_ = x;
+}
 
 Value::Value(const double &x)
     : type_(FLOAT)
-    , data_(0)
 {
-    get_as<double>(&data_) = x;
+    data_.d_ = x;
 }
 
 Value::Value(const Decimal &x)
     : type_(DECIMAL)
-    , data_(0)
 {
-    get_as<Decimal *>(&data_) = new Decimal(x);
+    new (&data_) Decimal(x);
 }
 
 Value::Value(const DateTime &x)
     : type_(DATETIME)
-    , data_(0)
 {
-    get_as<DateTime *>(&data_) = new DateTime(x);
+    new (&data_) DateTime(x);
 }
 
 Value::Value(const String &x)
     : type_(STRING)
-    , data_(0)
 {
-    get_as<String *>(&data_) = new String(x);
+    new (&data_) String(x);
 }
 
 Value::Value(const Char *x)
-    : type_(x != NULL? STRING: INVALID)
-    , data_(0)
+    : type_(INVALID)
 {
-    if (type_ == STRING)
-        get_as<String *>(&data_) = new String(str_from_chars(x));
+    data_.l_ = 0;
+    if (x != NULL) {
+        new (&data_) String(str_from_chars(x));
+        type_ = STRING;
+    }
 }
 
 Value::Value(const Blob &x)
     : type_(BLOB)
-    , data_(0)
 {
-    get_as<Blob *>(&data_) = new Blob(x);
+    new (&data_) Blob(x);
 }
 
 Value::Value(const Value &other)
     : type_(INVALID)
-    , data_(0)
 {
-    assign(other);
+    init(other);
 }
 
 Value &
@@ -201,21 +234,18 @@ Value::~Value()
     destroy();
 }
 
-template <class Int__>
-static inline void xor_swap(Int__ &a, Int__ &b) SWAP_NOEXCEPT
-{
-    a ^= b;
-    b ^= a;
-    a ^= b;
-}
-
 void
 Value::swap(Value &other) SWAP_NOEXCEPT
 {
     if (this == &other)
         return;
-    xor_swap(type_, other.type_);
-    xor_swap(data_, other.data_);
+    // payloads may point into themselves (e.g. short strings),
+    // so they have to be moved one by one, not just byte-swapped
+    Value tmp;
+    relocate(type_, &tmp.data_, &data_);
+    relocate(other.type_, &data_, &other.data_);
+    relocate(type_, &other.data_, &tmp.data_);
+    std::swap(type_, other.type_);
 }
 
 void
@@ -225,16 +255,12 @@ Value::fix_type(int type)
         return;
     switch (type) {
     case Value::INVALID:
-        {
-            destroy();
-            type_ = type;
-        }
+        destroy();
         break;
     case Value::INTEGER:
         {
             int t = as_integer();
             destroy();
-            type_ = type;
             get_as<int>(&data_) = t;
         }
         break;
@@ -242,55 +268,50 @@ Value::fix_type(int type)
         {
             LongInt t = as_longint();
             destroy();
-            type_ = type;
-            get_as<LongInt>(&data_) = t;
+            data_.l_ = t;
         }
         break;
     case Value::STRING:
         {
             String t = as_string();
             destroy();
-            type_ = type;
-            init();
-            *get_as<String *>(&data_) = t;
+            new (&data_) String();
+            get_as<String>(&data_).swap(t);
         }
         break;
     case Value::DECIMAL:
         {
             Decimal t = as_decimal();
             destroy();
-            type_ = type;
-            init();
-            *get_as<Decimal *>(&data_) = t;
+            new (&data_) Decimal(t);
         }
         break;
     case Value::DATETIME:
         {
             DateTime t = as_date_time();
             destroy();
-            type_ = type;
-            init();
-            *get_as<DateTime *>(&data_) = t;
+            new (&data_) DateTime(t);
         }
         break;
     case Value::FLOAT:
         {
             double t = as_float();
             destroy();
-            type_ = type;
-            get_as<double>(&data_) = t;
+            data_.d_ = t;
         }
         break;
     case Value::BLOB:
         {
             Blob t = as_blob();
             destroy();
-            type_ = type;
-            init();
-            *get_as<Blob *>(&data_) = t;
+            new (&data_) Blob();
+            get_as<Blob>(&data_).swap(t);
         }
         break;
+    default:
+        return;
     }
+    type_ = type;
 }
 
 int
@@ -571,6 +592,78 @@ key_cmp(const Key &x, const Key &y)
     return 0;
 }
 
+static inline size_t hash_mix(size_t h, LongInt v)
+{
+    unsigned long long x = (unsigned long long)v;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return (h ^ (size_t)x) * 0x100000001b3ULL;
+}
+
+static inline size_t hash_chars(size_t h, const Char *s, size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+        h = (h ^ (size_t)char_code(s[i])) * 0x100000001b3ULL;
+    return h;
+}
+
+static size_t hash_text(size_t h, const Char *p, size_t len)
+{
+    // A numeric text is hashed with the trailing zeros of the fractional
+    // part dropped and "-0" turned into "0": such texts may compare equal
+    // to one Decimal or Float value, so they must hash the same.
+    size_t dot = len;
+    for (size_t i = 0; i < len; ++i) {
+        int c = char_code(p[i]);
+        if (c == '.' && dot == len)
+            dot = i;
+        else if (!(c >= '0' && c <= '9') && !(c == '-' && !i))
+            return hash_chars(h, p, len);
+    }
+    if (dot < len) {
+        while (len > dot && (char_code(p[len - 1]) == '0' || len - 1 == dot))
+            --len;
+    }
+    if (len == 2 && char_code(p[0]) == '-' && char_code(p[1]) == '0')
+        return hash_chars(h, _T("0"), 1);
+    return hash_chars(h, p, len);
+}
+
+static size_t value_hash(size_t h, const Value &x)
+{
+    if (x.is_null())
+        return hash_mix(h, 0);
+    // Values of different types compare equal by their string
+    // representation, so hash that one, normalized the same way
+    // for a String as for the others.
+    if (x.get_type() == Value::STRING) {
+        const String &s = x.read_as_string();
+        return hash_text(h, str_data(s), str_length(s));
+    }
+    if (x.get_type() == Value::FLOAT && x.read_as_float() == 0)
+        return hash_chars(h, _T("0"), 1);
+    String s = x.as_string();
+    return hash_text(h, str_data(s), str_length(s));
+}
+
+YBUTIL_DECL size_t
+key_hash(const Key &key)
+{
+    size_t h = 0xcbf29ce484222325ULL;
+    if (!key.table)
+        return h;
+    h = hash_chars(h, str_data(*key.table), str_length(*key.table));
+    if (key.id_name)
+        return hash_mix(h, key.id_is_null? 0: key.id_value);
+    for (size_t i = 0; i < key.fields.size(); ++i) {
+        const String &name = *key.fields[i].first;
+        h = hash_chars(h, str_data(name), str_length(name));
+        h = value_hash(h, key.fields[i].second);
+    }
+    return h;
+}
+
 YBUTIL_DECL bool
 empty_key(const Key &key)
 {
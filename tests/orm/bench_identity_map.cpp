@@ -0,0 +1,89 @@
+// -*- Mode: C++; c-basic-offset: 4; tab-width: 4; indent-tabs-mode: nil; -*-
+// Times identity map operations of a Session holding many objects.
+// Usage: yborm_bench_identity_map [objects]
+// No database connection is needed, all the objects are ghosts.
+#include <stdlib.h>
+#include <iostream>
+#include <iomanip>
+#include "util/string_utils.h"
+#include "util/nlogger.h"
+#include "orm/data_object.h"
+
+using namespace std;
+using namespace Yb;
+
+static void report(const char *what, MicroSec elapsed, long count)
+{
+    cout << setw(36) << left << what << " "
+        << setw(10) << right << fixed << setprecision(1)
+        << elapsed * 1000.0 / count << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    long n = argc > 1? atol(argv[1]): 1000000;
+    if (n <= 0)
+        n = 1000000;
+    Schema schema;
+    Table::Ptr t(new Table(_T("A"), _T(""), _T("A")));
+    t->add_column(Column(_T("X"), Value::LONGINT, 0, Column::PK));
+    t->add_column(Column(_T("Y"), Value::STRING, 20));
+    schema.add_table(t);
+    Table::Ptr u(new Table(_T("B"), _T(""), _T("B")));
+    u->add_column(Column(_T("X"), Value::LONGINT, 0, Column::PK));
+    u->add_column(Column(_T("Y"), Value::STRING, 20, Column::PK));
+    schema.add_table(u);
+    schema.fill_fkeys();
+    const String &tbl_a = schema.table(_T("A")).name(),
+        &tbl_b = schema.table(_T("B")).name(),
+        &col_x = schema.table(_T("A")).get_surrogate_pk(),
+        col_y = _T("Y");
+
+    cout << "objects: " << n << endl;
+    cout << setw(36) << left << "operation" << " "
+        << setw(10) << right << "ns/op" << endl;
+    Session session(schema);
+    MicroSec t0 = get_monotonic_microsec();
+    for (long i = 0; i < n; ++i)
+        session.get_lazy(Key(&tbl_a, &col_x, i));
+    report("get_lazy, new int key", get_monotonic_microsec() - t0, n);
+    t0 = get_monotonic_microsec();
+    for (long i = 0; i < n; ++i)
+        session.get_lazy(Key(&tbl_a, &col_x, (i * 7919) % n));
+    report("get_lazy, existing int key", get_monotonic_microsec() - t0, n);
+    long n_comp = n / 10;
+    Key key(&tbl_b);
+    key.fields.push_back(make_pair(&col_x, Value()));
+    key.fields.push_back(make_pair(&col_y, Value()));
+    t0 = get_monotonic_microsec();
+    for (long i = 0; i < n_comp; ++i) {
+        key.fields[0].second = Value((LongInt)(i % 100));
+        key.fields[1].second = Value(to_string(i));
+        session.get_lazy(key);
+    }
+    report("get_lazy, new composite key", get_monotonic_microsec() - t0, n_comp);
+    t0 = get_monotonic_microsec();
+    for (long i = 0; i < n_comp; ++i) {
+        long j = (i * 7919) % n_comp;
+        key.fields[0].second = Value((LongInt)(j % 100));
+        key.fields[1].second = Value(to_string(j));
+        session.get_lazy(key);
+    }
+    report("get_lazy, existing composite key",
+           get_monotonic_microsec() - t0, n_comp);
+    DataObjectList objs;
+    objs.reserve(n / 2);
+    for (long i = 0; i < n; i += 2)
+        objs.push_back(session.get_lazy(Key(&tbl_a, &col_x, i)));
+    t0 = get_monotonic_microsec();
+    for (size_t i = 0; i < objs.size(); ++i)
+        session.detach(objs[i]);
+    report("detach", get_monotonic_microsec() - t0, objs.size());
+    t0 = get_monotonic_microsec();
+    session.clear();
+    report("clear, per object", get_monotonic_microsec() - t0,
+           n - objs.size() + n_comp);
+    return 0;
+}
+
+// vim:ts=4:sts=4:sw=4:et:
@@ -0,0 +1,132 @@
+// -*- Mode: C++; c-basic-offset: 4; tab-width: 4; indent-tabs-mode: nil; -*-
+// Counts heap allocations made while fetching and copying rows.
+// Usage: YBORM_URL=sqlite:///path/to/test_db yborm_bench_values [rows]
+// The test rows are inserted into T_ORM_TEST and rolled back at exit.
+#include <stdlib.h>
+#include <new>
+#include <iostream>
+#include <iomanip>
+#include "util/string_utils.h"
+#include "orm/engine.h"
+
+using namespace std;
+using namespace Yb;
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#define BENCH_THROW_BAD_ALLOC
+#define BENCH_NOTHROW noexcept
+#else
+#define BENCH_THROW_BAD_ALLOC throw (std::bad_alloc)
+#define BENCH_NOTHROW throw ()
+#endif
+
+static long n_allocs = 0;
+
+void *operator new(size_t n) BENCH_THROW_BAD_ALLOC
+{
+    ++n_allocs;
+    void *p = malloc(n? n: 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) BENCH_NOTHROW
+{
+    free(p);
+}
+
+static void report(const char *what, long allocs, long count)
+{
+    cout << setw(32) << left << what << " "
+        << setw(8) << right << fixed << setprecision(2)
+        << (double)allocs / count << endl;
+}
+
+static void bench_copy(const char *what, const Value &x)
+{
+    const int n = 10000;
+    Values v(n);
+    long start = n_allocs;
+    for (int i = 0; i < n; ++i)
+        v[i] = x;
+    Values w(v);
+    report(what, n_allocs - start, 2 * n);
+}
+
+int main(int argc, char *argv[])
+{
+    int n_rows = argc > 1? atoi(argv[1]): 1000;
+    if (n_rows <= 0)
+        n_rows = 1000;
+    cout << "sizeof(Value): " << sizeof(Value) << endl;
+    cout << setw(32) << left << "operation" << " "
+        << setw(8) << right << "allocs" << endl;
+    bench_copy("copy Value(int)", Value(1));
+    bench_copy("copy Value(short string)", Value(_T("item")));
+    bench_copy("copy Value(long string)",
+            Value(String(_T("a string too long to fit in place, 48 chars"))));
+    bench_copy("copy Value(decimal)", Value(Decimal(_T("1.23"))));
+    bench_copy("copy Value(datetime)", Value(now()));
+
+    Engine engine(Engine::READ_WRITE);
+    SqlConnection *conn = engine.get_conn();
+    conn->begin_trans_if_necessary();
+    LongInt first_id;
+    {
+        auto_ptr<SqlCursor> cur = conn->new_cursor();
+        cur->prepare(_T("SELECT MAX(ID) MAX_ID FROM T_ORM_TEST"));
+        cur->exec(Values());
+        RowPtr row = cur->fetch_row();
+        first_id = (*row)[0].is_null()? 1: (*row)[0].as_longint() + 1;
+        cur->fetch_row();
+    }
+    {
+        vector<Values> params_set(n_rows);
+        for (int i = 0; i < n_rows; ++i) {
+            Values &params = params_set[i];
+            params.push_back(Value(first_id + i));
+            params.push_back(i % 2? Value(_T("item")):
+                    Value(String(_T("a string too long to fit in place"))));
+            params.push_back(Value(now()));
+            params.push_back(Value(Decimal(_T("1.23"))));
+            params.push_back(Value(4.56));
+        }
+        auto_ptr<SqlCursor> cur = conn->new_cursor();
+        cur->prepare(_T("INSERT INTO T_ORM_TEST(ID, A, B, C, D) "
+                    "VALUES(?, ?, ?, ?, ?)"));
+        cur->exec_many(params_set);
+    }
+    Values params;
+    params.push_back(Value(first_id));
+    const String sql = _T("SELECT ID, A, B, C, D FROM T_ORM_TEST "
+            "WHERE ID >= ? ORDER BY ID");
+    {
+        auto_ptr<SqlCursor> cur = conn->new_cursor();
+        cur->prepare(sql);
+        cur->exec(params);
+        Row row;
+        long start = n_allocs, count = 0;
+        while (cur->fetch_into(row))
+            ++count;
+        report("fetch_into, reused row", n_allocs - start, count);
+    }
+    RowsPtr rows;
+    {
+        auto_ptr<SqlCursor> cur = conn->new_cursor();
+        cur->prepare(sql);
+        cur->exec(params);
+        long start = n_allocs;
+        rows = cur->fetch_rows();
+        report("fetch_rows", n_allocs - start, rows->size());
+    }
+    {
+        long start = n_allocs;
+        Rows copy(*rows);
+        report("copy fetched row", n_allocs - start, copy.size());
+    }
+    conn->rollback();
+    return 0;
+}
+
+// vim:ts=4:sts=4:sw=4:et:
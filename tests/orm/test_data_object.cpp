@@ -36,6 +36,12 @@ class TestDataObject : public CppUnit::TestFixture
     CPPUNIT_TEST(test_calc_depth);
     CPPUNIT_TEST_EXCEPTION(test_cycle_detected, CycleDetected);
     CPPUNIT_TEST(test_filter_by_key);
+    CPPUNIT_TEST(test_filter_by_keys);
+    CPPUNIT_TEST(test_identity_map);
+    CPPUNIT_TEST(test_identity_map_composite);
+    CPPUNIT_TEST(test_work_lists);
+    CPPUNIT_TEST(test_modified_columns);
+    CPPUNIT_TEST(test_save_or_update_dirty);
     //CPPUNIT_TEST(test_bad_type_cast_format);
     CPPUNIT_TEST_SUITE_END();
 
@@ -364,6 +370,165 @@ public:
         CPPUNIT_ASSERT_EQUAL(string("C.U = 'YYY'"), NARROW(kf2.get_sql()));
     }
 
+    void test_filter_by_keys()
+    {
+        String tbl_a = _T("A"), col_x = _T("X"),
+               tbl_c = _T("C"), col_u = _T("U");
+        Keys keys;
+        keys.push_back(Key(&tbl_a, &col_x, 10));
+        CPPUNIT_ASSERT_EQUAL(string("A.X = 10"),
+                NARROW(filter_by_keys(keys).get_sql()));
+        keys.push_back(Key(&tbl_a, &col_x, 11));
+        CPPUNIT_ASSERT_EQUAL(string("A.X IN (10, 11)"),
+                NARROW(filter_by_keys(keys).get_sql()));
+        Keys keys2(2, Key(&tbl_c));
+        keys2[0].fields.push_back(std::make_pair(&col_u, Value(_T("YYY"))));
+        keys2[1].fields.push_back(std::make_pair(&col_u, Value(_T("ZZZ"))));
+        CPPUNIT_ASSERT_EQUAL(string("C.U IN ('YYY', 'ZZZ')"),
+                NARROW(filter_by_keys(keys2).get_sql()));
+        String col_v = _T("V");
+        Keys keys3(3, Key(&tbl_c));
+        for (int i = 0; i < 3; ++i) {
+            keys3[i].fields.push_back(std::make_pair(&col_u, Value(i)));
+            keys3[i].fields.push_back(std::make_pair(&col_v, Value(i * 10)));
+        }
+        CPPUNIT_ASSERT_EQUAL(string("((C.U = 0) AND (C.V = 0)) OR "
+                    "(((C.U = 1) AND (C.V = 10)) OR ((C.U = 2) AND (C.V = 20)))"),
+                NARROW(filter_by_keys(keys3).get_sql()));
+    }
+
+    void test_identity_map()
+    {
+        const int n = 3000;
+        String tbl_a = _T("A"), tbl_b = _T("B"), col_x = _T("X");
+        DataObjectList objs;
+        IdentityMap idmap;
+        for (int i = 0; i < n; ++i) {
+            objs.push_back(DataObject::create_new(r_.table(_T("A"))));
+            Key key(i % 2? &tbl_a: &tbl_b, &col_x, i / 2);
+            CPPUNIT_ASSERT(!idmap.insert(key, shptr_get(objs[i])));
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)n, idmap.size());
+        Key dup(&tbl_a, &col_x, 0);
+        CPPUNIT_ASSERT(shptr_get(objs[1]) == idmap.insert(dup, shptr_get(objs[0])));
+        for (int i = 0; i < n; i += 3)
+            CPPUNIT_ASSERT(idmap.erase(Key(i % 2? &tbl_a: &tbl_b, &col_x, i / 2)));
+        CPPUNIT_ASSERT(!idmap.erase(Key(&tbl_b, &col_x, 0)));
+        CPPUNIT_ASSERT_EQUAL((size_t)(n - n / 3), idmap.size());
+        for (int i = 0; i < n; ++i) {
+            DataObject *found = idmap.find(Key(i % 2? &tbl_a: &tbl_b, &col_x, i / 2));
+            CPPUNIT_ASSERT(found == (i % 3? shptr_get(objs[i]): NULL));
+        }
+        size_t count = 0;
+        IdentityMap::const_iterator j = idmap.begin(), jend = idmap.end();
+        for (; j != jend; ++j, ++count)
+            CPPUNIT_ASSERT(j->obj == idmap.find(j->key));
+        CPPUNIT_ASSERT_EQUAL(idmap.size(), count);
+        // the table is matched by name, not by the string address
+        String tbl_a2 = _T("A");
+        CPPUNIT_ASSERT(shptr_get(objs[1]) == idmap.find(Key(&tbl_a2, &col_x, 0)));
+        idmap.clear();
+        CPPUNIT_ASSERT(idmap.empty() && idmap.begin() == idmap.end());
+        CPPUNIT_ASSERT(!idmap.find(Key(&tbl_a, &col_x, 0)));
+    }
+
+    void test_identity_map_composite()
+    {
+        String tbl_b = _T("B"), col_q = _T("Q"), col_z = _T("Z");
+        DataObject::Ptr d = DataObject::create_new(r_.table(_T("B"))),
+            e = DataObject::create_new(r_.table(_T("B")));
+        IdentityMap idmap;
+        Key k1(&tbl_b);
+        k1.fields.push_back(make_pair(&col_z, Value(1)));
+        k1.fields.push_back(make_pair(&col_q, Value(Decimal(_T("1.50")))));
+        Key k2(k1);
+        k2.fields[1].second = Value(Decimal(_T("2.5")));
+        CPPUNIT_ASSERT(!idmap.insert(k1, shptr_get(d)));
+        CPPUNIT_ASSERT(!idmap.insert(k2, shptr_get(e)));
+        Key k3(k1);
+        k3.fields[0].second = Value((LongInt)1);
+        k3.fields[1].second = Value(Decimal(_T("1.5")));
+        CPPUNIT_ASSERT(shptr_get(d) == idmap.find(k3));
+        k3.fields[1].second = Value(_T("2.5"));
+        CPPUNIT_ASSERT(shptr_get(e) == idmap.find(k3));
+        k3.fields[0].second = Value();
+        CPPUNIT_ASSERT(!idmap.find(k3));
+    }
+
+    void test_work_lists()
+    {
+        String tbl_a = _T("A"), col_x = _T("X");
+        Session session(r_);
+        DataObject::Ptr d = DataObject::create_new(r_.table(_T("A")));
+        session.save(d);
+        session.save(d);
+        CPPUNIT_ASSERT_EQUAL((size_t)1, session.work_lists_[DataObject::New].size());
+        DataObject::Ptr e = session.get_lazy(Key(&tbl_a, &col_x, 10));
+        CPPUNIT_ASSERT_EQUAL((size_t)0, session.work_lists_[DataObject::Ghost].size());
+        e->delete_object(DelUnchecked);
+        CPPUNIT_ASSERT_EQUAL((int)DataObject::ToBeDeleted, (int)e->status());
+        CPPUNIT_ASSERT(shptr_get(e) ==
+                session.work_lists_[DataObject::ToBeDeleted].head());
+        d->delete_object(DelUnchecked);
+        CPPUNIT_ASSERT(session.work_lists_[DataObject::New].empty());
+        CPPUNIT_ASSERT(shptr_get(d) ==
+                session.work_lists_[DataObject::Deleted].head());
+        session.detach(e);
+        CPPUNIT_ASSERT(session.work_lists_[DataObject::ToBeDeleted].empty());
+        DataObject::Ptr f = DataObject::create_new(r_.table(_T("A")));
+        session.save(f);
+        session.clear();
+        for (int i = DataObject::New; i <= DataObject::Deleted; ++i)
+            CPPUNIT_ASSERT(session.work_lists_[i].empty());
+        CPPUNIT_ASSERT_EQUAL((int)DataObject::New, (int)f->status());
+    }
+
+    void test_modified_columns()
+    {
+        DataObject::Ptr d = DataObject::create_new(
+                r_.table(_T("A")), DataObject::Sync);
+        d->set(_T("X"), Value(10));
+        CPPUNIT_ASSERT(d->modified_columns().empty());
+        CPPUNIT_ASSERT_EQUAL((int)DataObject::Sync, (int)d->status());
+        d->set(_T("Y"), Value(_T("abc")));
+        CPPUNIT_ASSERT_EQUAL((int)DataObject::Dirty, (int)d->status());
+        CPPUNIT_ASSERT_EQUAL((size_t)4, d->modified_columns().size());
+        CPPUNIT_ASSERT(d->modified_columns()[1] && !d->modified_columns()[2]);
+        d->set(_T("P"), Value(5));
+        CPPUNIT_ASSERT(d->modified_columns()[1] && d->modified_columns()[2]);
+        // touched as a whole
+        DataObject::Ptr e = DataObject::create_new(
+                r_.table(_T("A")), DataObject::Sync);
+        e->touch();
+        e->set(_T("Y"), Value(_T("abc")));
+        CPPUNIT_ASSERT(e->modified_columns().empty());
+        // new objects are inserted as a whole
+        DataObject::Ptr f = DataObject::create_new(r_.table(_T("A")));
+        f->set(_T("Y"), Value(_T("abc")));
+        CPPUNIT_ASSERT(f->modified_columns().empty());
+    }
+
+    void test_save_or_update_dirty()
+    {
+        DataObject::Ptr d = DataObject::create_new(
+                r_.table(_T("A")), DataObject::Sync);
+        d->set(_T("X"), Value(10));
+        Session session(r_);
+        session.save(d);
+        d->set(_T("Y"), Value(_T("abc")));
+        CPPUNIT_ASSERT(!d->modified_columns().empty());
+        DataObject::Ptr e = DataObject::create_new(
+                r_.table(_T("A")), DataObject::Dirty);
+        e->set(_T("X"), Value(10));
+        e->set(_T("Y"), Value(_T("xyz")));
+        e->set(_T("P"), Value(5));
+        DataObject::Ptr f = session.save_or_update(e);
+        CPPUNIT_ASSERT(shptr_get(d) == shptr_get(f));
+        CPPUNIT_ASSERT_EQUAL((int)DataObject::Dirty, (int)f->status());
+        // every column has been replaced
+        CPPUNIT_ASSERT(f->modified_columns().empty());
+    }
+
     /*
     void test_bad_type_cast_format()
     {
@@ -421,6 +586,8 @@ class TestDataObjectSaveLoad : public CppUnit::TestFixture
     CPPUNIT_TEST(test_lazy_load);
     //CPPUNIT_TEST_EXCEPTION(test_lazy_load_fail, ObjectNotFoundByKey);
     CPPUNIT_TEST(test_lazy_load_fail);
+    CPPUNIT_TEST(test_lazy_load_batch);
+    CPPUNIT_TEST(test_entity_cache);
     CPPUNIT_TEST(test_lazy_load_slaves);
     CPPUNIT_TEST(test_flush_dirty);
     CPPUNIT_TEST(test_flush_new);
@@ -476,7 +643,7 @@ public:
 "<?xml version='1.0' encoding='UTF-8'?>"
 "<schema>"
 "    <table name='T_ORM_TEST' sequence='S_ORM_TEST_ID'"
-"            class='OrmTest' xml-name='orm-test'>"
+"            class='OrmTest' xml-name='orm-test' cache='read-write'>"
 "        <column name='ID' type='longint'>"
 "            <primary-key />"
 "            <read-only />"
@@ -487,7 +654,7 @@ public:
 "        <column name='D' type='float'/>"
 "    </table>"
 "    <table name='T_ORM_XML' sequence='S_ORM_XML_ID'"
-"            class='OrmXml' xml-name='orm-xml'>"
+"            class='OrmXml' xml-name='orm-xml' batch-size='10'>"
 "        <column name='ID' type='longint'>"
 "            <primary-key />"
 "            <read-only />"
@@ -542,6 +709,56 @@ public:
         CPPUNIT_ASSERT_EQUAL((int)DataObject::Dirty, (int)d->status());
     }
 
+    void test_lazy_load_batch()
+    {
+        Engine engine(Engine::READ_ONLY);
+        setup_log(engine);
+        Session session(r_, &engine);
+        const Table &t = r_.table(_T("T_ORM_XML"));
+        DataObject::Ptr e = session.get_lazy(t.mk_key(-20)),
+            f = session.get_lazy(t.mk_key(-30)),
+            g = session.get_lazy(t.mk_key(-40));
+        CPPUNIT_ASSERT(Decimal(_T("2.7")) == f->get(_T("B")).as_decimal());
+        CPPUNIT_ASSERT_EQUAL((int)DataObject::Sync, (int)f->status());
+        CPPUNIT_ASSERT_EQUAL((int)DataObject::Sync, (int)e->status());
+        CPPUNIT_ASSERT(Decimal(_T("3.14")) == e->get(_T("B")).as_decimal());
+        // not found objects stay ghosts
+        CPPUNIT_ASSERT_EQUAL((int)DataObject::Ghost, (int)g->status());
+    }
+
+    void test_entity_cache()
+    {
+        Engine engine;
+        setup_log(engine);
+        EntityCache *cache = new EntityCache;
+        engine.set_entity_cache(auto_ptr<EntityCache>(cache));
+        const Table &t = r_.table(_T("T_ORM_TEST"));
+        {
+            Session session(r_, &engine);
+            DataObject::Ptr d = session.get_lazy(t.mk_key(-10));
+            CPPUNIT_ASSERT_EQUAL(string("item"),
+                    NARROW(d->get(_T("A")).as_string()));
+        }
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, cache->get_stats().misses);
+        {
+            // another session gets the row from the cache
+            Session session(r_, &engine);
+            DataObject::Ptr d = session.get_lazy(t.mk_key(-10));
+            CPPUNIT_ASSERT_EQUAL(string("item"),
+                    NARROW(d->get(_T("A")).as_string()));
+            CPPUNIT_ASSERT_EQUAL((LongInt)1, cache->get_stats().hits);
+            d->set(_T("A"), String(_T("meti")));
+            session.commit();
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)0, cache->size());
+        {
+            Session session(r_, &engine);
+            DataObject::Ptr d = session.get_lazy(t.mk_key(-10));
+            CPPUNIT_ASSERT_EQUAL(string("meti"),
+                    NARROW(d->get(_T("A")).as_string()));
+        }
+    }
+
     void test_lazy_load_fail()
     {
         Key k;
@@ -68,6 +68,18 @@ static void setup_log(SqlConnection &c)
     c.set_echo(true);
 }
 
+class StatementCounter: public SqlStatementObserver
+{
+public:
+    int execs_;
+    StatementCounter(): execs_(0) {}
+    void on_statement(SqlConnection &conn, const SqlStatementEvent &event)
+    {
+        if (event.phase == STMT_EXEC || event.phase == STMT_EXEC_DIRECT)
+            ++execs_;
+    }
+};
+
 class TestDomainObject : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE(TestDomainObject);
@@ -82,6 +94,10 @@ class TestDomainObject : public CppUnit::TestFixture
 #endif // defined(YB_USE_TUPLE)
     CPPUNIT_TEST(test_explicit_join1);
     CPPUNIT_TEST(test_explicit_join2);
+    CPPUNIT_TEST(test_prefetch);
+    CPPUNIT_TEST_EXCEPTION(test_prefetch_unknown, PrefetchRelationNotFound);
+    CPPUNIT_TEST(test_untracked);
+    CPPUNIT_TEST(test_untracked_recycle);
 #if defined(YB_USE_TUPLE)
     CPPUNIT_TEST(test_explicit_join3);
 #endif // defined(YB_USE_TUPLE)
@@ -300,6 +316,103 @@ public:
         CPPUNIT_ASSERT(out[0] != out[1]);
     }
 
+    void test_prefetch()
+    {
+        Engine engine(Engine::READ_ONLY);
+        setup_log(engine);
+        StatementCounter counter;
+        engine.get_conn()->set_observer(&counter);
+        Session session(Yb::theSchema(), &engine);
+        DomainResultSet<OrmTest> rs = Yb::query<OrmTest>(session)
+            .prefetch(_T("orm_xmls"))
+            .all();
+        vector<OrmTest> out;
+        copy(rs.begin(), rs.end(), back_inserter(out));
+        CPPUNIT_ASSERT_EQUAL(1, (int)out.size());
+        RelationObject *ro = out[0].get_slaves_ro(_T("orm_xmls"));
+        CPPUNIT_ASSERT_EQUAL((int)RelationObject::Sync, (int)ro->status());
+        CPPUNIT_ASSERT_EQUAL((size_t)2, ro->slave_objects().size());
+        CPPUNIT_ASSERT_EQUAL(3, (int)session.objects_.size());
+        // one query for the masters, one for all their slaves
+        CPPUNIT_ASSERT_EQUAL(2, counter.execs_);
+        int n = 0;
+        ManagedList<OrmXml>::iterator i = out[0].orm_xmls.begin(),
+            iend = out[0].orm_xmls.end();
+        for (; i != iend; ++i)
+            ++n;
+        CPPUNIT_ASSERT_EQUAL(2, n);
+        CPPUNIT_ASSERT_EQUAL(2, counter.execs_);
+        engine.get_conn()->set_observer(NULL);
+    }
+
+    void test_prefetch_unknown()
+    {
+        Engine engine(Engine::READ_ONLY);
+        setup_log(engine);
+        Session session(Yb::theSchema(), &engine);
+        DomainResultSet<OrmTest> rs = Yb::query<OrmTest>(session)
+            .prefetch(_T("no_such_relation"))
+            .all();
+        vector<OrmTest> out;
+        copy(rs.begin(), rs.end(), back_inserter(out));
+    }
+
+    void test_untracked()
+    {
+        Engine engine(Engine::READ_ONLY);
+        setup_log(engine);
+        Session session(Yb::theSchema(), &engine);
+        DomainResultSet<OrmXml> rs = Yb::query<OrmXml>(session)
+            .filter_by(OrmXml::c.orm_test_id == ORM_TEST_ID1)
+            .order_by(OrmXml::c.id)
+            .untracked()
+            .all();
+        vector<OrmXml> out;
+        copy(rs.begin(), rs.end(), back_inserter(out));
+        CPPUNIT_ASSERT_EQUAL(2, (int)out.size());
+        CPPUNIT_ASSERT(out[0] != out[1]);
+        CPPUNIT_ASSERT(!out[0].get_data_object()->session());
+        CPPUNIT_ASSERT_EQUAL((int)DataObject::Sync,
+                (int)out[1].get_data_object()->status());
+        CPPUNIT_ASSERT_EQUAL(0, (int)session.objects_.size());
+        CPPUNIT_ASSERT_EQUAL(0, (int)session.identity_map_.size());
+    }
+
+    void test_untracked_recycle()
+    {
+        Engine engine(Engine::READ_ONLY);
+        setup_log(engine);
+        Session session(Yb::theSchema(), &engine);
+        DataObjectResultSet rs = session.load_collection(
+                ColumnExpr(_T("T_ORM_XML")), Expression(),
+                ColumnExpr(_T("ID")), false, true);
+        // only the addresses are kept, not the objects
+        vector<DataObject *> addrs;
+        vector<LongInt> ids;
+        vector<string> bs;
+        DataObjectResultSet::iterator i = rs.begin(), iend = rs.end();
+        for (; i != iend; ++i) {
+            DataObject *d = (*i)[0].get();
+            addrs.push_back(d);
+            ids.push_back(d->get(_T("ID")).as_longint());
+            bs.push_back(NARROW(d->get(_T("B")).as_string()));
+            CPPUNIT_ASSERT_EQUAL((int)DataObject::Sync, (int)d->status());
+            CPPUNIT_ASSERT(!d->session());
+        }
+        CPPUNIT_ASSERT_EQUAL(3, (int)addrs.size());
+        // the object of the first row has been refilled with the third
+        CPPUNIT_ASSERT(addrs[0] != addrs[1]);
+        CPPUNIT_ASSERT(addrs[2] == addrs[0]);
+        CPPUNIT_ASSERT_EQUAL((LongInt)ORM_XML_ID4, ids[0]);
+        CPPUNIT_ASSERT_EQUAL((LongInt)ORM_XML_ID3, ids[1]);
+        CPPUNIT_ASSERT_EQUAL((LongInt)ORM_XML_ID2, ids[2]);
+        CPPUNIT_ASSERT_EQUAL(string("42"), bs[0]);
+        CPPUNIT_ASSERT_EQUAL(string("2.7"), bs[1]);
+        CPPUNIT_ASSERT_EQUAL(string("3.14"), bs[2]);
+        CPPUNIT_ASSERT_EQUAL(0, (int)session.objects_.size());
+        CPPUNIT_ASSERT_EQUAL(0, (int)session.identity_map_.size());
+    }
+
 #if defined(YB_USE_TUPLE)
     void test_explicit_join3()
     {
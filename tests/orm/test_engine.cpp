@@ -17,6 +17,24 @@ Row::iterator find_in_row(Row &row, const String &name)
     return i;
 }
 
+// simulates a sequence created with INCREMENT BY increment
+class CountingIdAllocator: public BlockIdAllocator
+{
+    LongInt curr_;
+public:
+    int fetches_;
+    CountingIdAllocator(): curr_(1), fetches_(0) {}
+protected:
+    LongInt fetch_block(EngineBase &engine,
+            const String &seq_name, int increment)
+    {
+        ++fetches_;
+        LongInt first = curr_;
+        curr_ += increment;
+        return first;
+    }
+};
+
 class TestEngine : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE(TestEngine);
@@ -36,15 +54,32 @@ class TestEngine : public CppUnit::TestFixture
     CPPUNIT_TEST_EXCEPTION(test_select_having_wo_groupby, BadSQLOperation);
     CPPUNIT_TEST(test_insert_simple);
     CPPUNIT_TEST(test_insert_exclude);
+    CPPUNIT_TEST(test_insert_multirow);
+    CPPUNIT_TEST(test_insert_all);
+    CPPUNIT_TEST(test_insert_returning);
     CPPUNIT_TEST(test_update_where);
     CPPUNIT_TEST(test_update_combo);
+    CPPUNIT_TEST(test_update_columns);
     CPPUNIT_TEST_EXCEPTION(test_update_wo_clause, BadSQLOperation);
     CPPUNIT_TEST(test_delete);
+    CPPUNIT_TEST(test_delete_many);
+    CPPUNIT_TEST(test_delete_many_composite);
     CPPUNIT_TEST_EXCEPTION(test_delete_wo_pk, BadSQLOperation);
     CPPUNIT_TEST_EXCEPTION(test_insert_ro_mode, BadOperationInMode);
     CPPUNIT_TEST_EXCEPTION(test_update_ro_mode, BadOperationInMode);
     CPPUNIT_TEST_EXCEPTION(test_delete_ro_mode, BadOperationInMode);
     CPPUNIT_TEST_EXCEPTION(test_execpoc_ro_mode, BadOperationInMode);
+    CPPUNIT_TEST(test_row_descr);
+    CPPUNIT_TEST(test_row_items);
+    CPPUNIT_TEST(test_create_sequence);
+    CPPUNIT_TEST(test_ping_query);
+    CPPUNIT_TEST(test_block_id_allocator);
+    CPPUNIT_TEST(test_entity_cache);
+    CPPUNIT_TEST(test_entity_cache_generation);
+    CPPUNIT_TEST(test_entity_cache_full);
+    CPPUNIT_TEST(test_query_cache);
+    CPPUNIT_TEST(test_query_cache_lru);
+    CPPUNIT_TEST(test_query_cache_generation);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -252,6 +287,58 @@ public:
         CPPUNIT_ASSERT_EQUAL((int)Value::LONGINT, types[0]);
     }
 
+    void test_insert_multirow()
+    {
+        Engine engine(Engine::READ_ONLY);
+        Table t(_T("T"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("A"), Value::STRING, 0, 0));
+        String sql;
+        TypeCodes types;
+        ParamNums param_nums;
+        engine.gen_sql_insert(sql, types, param_nums, t, true, false, 3);
+        CPPUNIT_ASSERT_EQUAL(string("INSERT INTO T (ID, A) VALUES "
+                    "(?, ?), (?, ?), (?, ?)"), NARROW(sql));
+        CPPUNIT_ASSERT_EQUAL(6, (int)types.size());
+        CPPUNIT_ASSERT_EQUAL(2, (int)param_nums.size());
+        CPPUNIT_ASSERT_EQUAL(1, (int)param_nums[_T("A")]);
+        CPPUNIT_ASSERT_EQUAL((int)Value::LONGINT, types[4]);
+        CPPUNIT_ASSERT_EQUAL((int)Value::STRING, types[5]);
+    }
+
+    void test_insert_all()
+    {
+        Engine engine(Engine::READ_ONLY);
+        Table t(_T("T"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("A"), Value::STRING, 0, 0));
+        String sql;
+        TypeCodes types;
+        ParamNums param_nums;
+        engine.gen_sql_insert(sql, types, param_nums, t, true, true, 2,
+                INSERT_ALL);
+        CPPUNIT_ASSERT_EQUAL(string("INSERT ALL INTO T (ID, A) VALUES (:1, :2)"
+                    " INTO T (ID, A) VALUES (:3, :4) SELECT * FROM DUAL"),
+                NARROW(sql));
+        CPPUNIT_ASSERT_EQUAL(4, (int)types.size());
+    }
+
+    void test_insert_returning()
+    {
+        Engine engine(Engine::READ_ONLY);
+        Table t(_T("T"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("A"), Value::STRING, 0, 0));
+        String sql;
+        TypeCodes types;
+        ParamNums param_nums;
+        engine.gen_sql_insert(sql, types, param_nums, t, false, false, 2,
+                INSERT_VALUES_LIST, RETURNING_CLAUSE);
+        CPPUNIT_ASSERT_EQUAL(string("INSERT INTO T (A) VALUES (?), (?)"
+                    " RETURNING ID"), NARROW(sql));
+        CPPUNIT_ASSERT_EQUAL(2, (int)types.size());
+    }
+
     void test_update_where()
     {
         Engine engine(Engine::READ_ONLY);
@@ -302,6 +389,33 @@ public:
         CPPUNIT_ASSERT_EQUAL((int)Value::DECIMAL, types[4]);
     }
 
+    void test_update_columns()
+    {
+        Engine engine(Engine::READ_ONLY);
+        Table t(_T("T"));
+        t.add_column(Column(_T("Q"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("E"), Value::STRING, 0, 0));
+        t.add_column(Column(_T("F"), Value::FLOAT, 0, 0));
+        t.add_column(Column(_T("R"), Value::LONGINT, 0, Column::RO));
+        String sql;
+        TypeCodes types;
+        ParamNums param_nums;
+        SqlGeneratorOptions options(NO_QUOTES, true, true);
+        ColumnMask columns(4);
+        columns[2] = true;
+        engine.gen_sql_update(sql, types, param_nums, t, options, &columns);
+        CPPUNIT_ASSERT_EQUAL(string("UPDATE T SET F = ? WHERE T.Q = ?"), NARROW(sql));
+        CPPUNIT_ASSERT_EQUAL((size_t)2, types.size());
+        CPPUNIT_ASSERT_EQUAL(0, param_nums[_T("F")]);
+        CPPUNIT_ASSERT_EQUAL(1, param_nums[_T("Q")]);
+        CPPUNIT_ASSERT_EQUAL((int)Value::FLOAT, types[0]);
+        // no updatable column selected means all of them
+        columns[2] = false;
+        columns[3] = true;
+        engine.gen_sql_update(sql, types, param_nums, t, options, &columns);
+        CPPUNIT_ASSERT_EQUAL(string("UPDATE T SET E = ?, F = ? WHERE T.Q = ?"), NARROW(sql));
+    }
+
     void test_update_wo_clause()
     {
         Engine engine(Engine::READ_ONLY);
@@ -329,6 +443,39 @@ public:
         CPPUNIT_ASSERT_EQUAL((int)Value::LONGINT, types[0]);
     }
 
+    void test_delete_many()
+    {
+        Engine engine(Engine::READ_ONLY);
+        Table t(_T("T"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        String sql;
+        TypeCodes types;
+        SqlGeneratorOptions options(NO_QUOTES, true, true);
+        engine.gen_sql_delete(sql, types, t, options, 3);
+        CPPUNIT_ASSERT_EQUAL(string("DELETE FROM T WHERE T.ID IN (?, ?, ?)"),
+                NARROW(sql));
+        CPPUNIT_ASSERT_EQUAL((size_t)3, types.size());
+        CPPUNIT_ASSERT_EQUAL((int)Value::LONGINT, types[2]);
+    }
+
+    void test_delete_many_composite()
+    {
+        Engine engine(Engine::READ_ONLY);
+        Table t(_T("T"));
+        t.add_column(Column(_T("A"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("B"), Value::STRING, 10, Column::PK));
+        String sql;
+        TypeCodes types;
+        SqlGeneratorOptions options(NO_QUOTES, true, true, true);
+        engine.gen_sql_delete(sql, types, t, options, 2);
+        CPPUNIT_ASSERT_EQUAL(string("DELETE FROM T WHERE "
+                    "((T.A = :1) AND (T.B = :2)) OR ((T.A = :3) AND (T.B = :4))"),
+                NARROW(sql));
+        CPPUNIT_ASSERT_EQUAL((size_t)4, types.size());
+        CPPUNIT_ASSERT_EQUAL((int)Value::LONGINT, types[2]);
+        CPPUNIT_ASSERT_EQUAL((int)Value::STRING, types[3]);
+    }
+
     void test_delete_wo_pk()
     {
         Engine engine(Engine::READ_ONLY);
@@ -368,6 +515,272 @@ public:
         Engine engine(Engine::READ_ONLY);
         engine.exec_proc(_T(""));
     }
+
+    void test_row_descr()
+    {
+        RowDescr::Ptr descr(new RowDescr);
+        descr->add_column(_T("id"));
+        descr->add_column(_T("Name"));
+        CPPUNIT_ASSERT_EQUAL((size_t)2, descr->size());
+        CPPUNIT_ASSERT_EQUAL(string("NAME"), NARROW(descr->name(1)));
+        CPPUNIT_ASSERT_EQUAL(0, descr->find(_T("ID")));
+        CPPUNIT_ASSERT_EQUAL(1, descr->find(_T("name")));
+        CPPUNIT_ASSERT_EQUAL(-1, descr->find(_T("X")));
+        Row r1(descr), r2(descr);
+        CPPUNIT_ASSERT_EQUAL((size_t)2, r1.size());
+        CPPUNIT_ASSERT(r1.descr().get() == r2.descr().get());
+        r1[0] = Value(10);
+        r1[1] = Value(_T("abc"));
+        CPPUNIT_ASSERT_EQUAL(string("ID"), NARROW(r1.name(0)));
+        CPPUNIT_ASSERT_EQUAL(string("abc"),
+                NARROW(r1[r1.find(_T("NAME"))].as_string()));
+        r1.swap(r2);
+        CPPUNIT_ASSERT(r1[0].is_null());
+        CPPUNIT_ASSERT_EQUAL(10, r2[0].as_integer());
+    }
+
+    void test_row_items()
+    {
+        RowItems items;
+        items.push_back(RowItem(_T("a"), Value(1)));
+        items.push_back(RowItem(_T("b"), Value(_T("x"))));
+        Row row(items);
+        CPPUNIT_ASSERT_EQUAL((size_t)2, row.size());
+        Row::iterator i = row.begin();
+        CPPUNIT_ASSERT_EQUAL(string("A"), NARROW(i->first));
+        CPPUNIT_ASSERT_EQUAL(1, i->second.as_integer());
+        ++i;
+        i->second = Value(_T("y"));
+        CPPUNIT_ASSERT_EQUAL(string("y"), NARROW(row[1].as_string()));
+        CPPUNIT_ASSERT(++i == row.end());
+        RowItems items2 = row.items();
+        CPPUNIT_ASSERT_EQUAL((size_t)2, items2.size());
+        CPPUNIT_ASSERT_EQUAL(string("B"), NARROW(items2[1].first));
+        CPPUNIT_ASSERT_EQUAL(string("y"), NARROW(items2[1].second.as_string()));
+    }
+
+    void test_create_sequence()
+    {
+        SqlDialect *pg = sql_dialect(_T("POSTGRES"));
+        CPPUNIT_ASSERT_EQUAL(string("CREATE SEQUENCE S"),
+                NARROW(pg->create_sequence(_T("S"))));
+        CPPUNIT_ASSERT_EQUAL(string("CREATE SEQUENCE S INCREMENT BY 50"),
+                NARROW(pg->create_sequence(_T("S"), 50)));
+        CPPUNIT_ASSERT_EQUAL(string("S.NEXTVAL"),
+                NARROW(sql_dialect(_T("ORACLE"))->select_next_block(
+                        _T("S"), 50)));
+        CPPUNIT_ASSERT_EQUAL(string("GEN_ID(S, 50) - 50 + 1"),
+                NARROW(sql_dialect(_T("INTERBASE"))->select_next_block(
+                        _T("S"), 50)));
+    }
+
+    void test_ping_query()
+    {
+        CPPUNIT_ASSERT_EQUAL(string("SELECT 1"),
+                NARROW(sql_dialect(_T("POSTGRES"))->ping_query()));
+        CPPUNIT_ASSERT_EQUAL(string("SELECT 1 FROM DUAL"),
+                NARROW(sql_dialect(_T("ORACLE"))->ping_query()));
+        CPPUNIT_ASSERT_EQUAL(string("SELECT 1 FROM RDB$DATABASE"),
+                NARROW(sql_dialect(_T("INTERBASE"))->ping_query()));
+    }
+
+    void test_block_id_allocator()
+    {
+        Engine engine(Engine::READ_ONLY);
+        Table t(_T("A"));
+        t.set_seq_name(_T("S_A"));
+        t.set_seq_increment(3);
+        Table u(_T("B"));
+        u.set_seq_name(_T("S_B"));
+        CountingIdAllocator *alloc = new CountingIdAllocator;
+        engine.set_id_allocator(auto_ptr<IdAllocator>(alloc));
+        std::auto_ptr<EngineCloned> cloned = engine.clone();
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, engine.get_next_id(t));
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, cloned->get_next_id(t));
+        CPPUNIT_ASSERT_EQUAL((LongInt)3, engine.get_next_id(t));
+        CPPUNIT_ASSERT_EQUAL(1, alloc->fetches_);
+        CPPUNIT_ASSERT_EQUAL((LongInt)4, cloned->get_next_id(t));
+        CPPUNIT_ASSERT_EQUAL(2, alloc->fetches_);
+        CPPUNIT_ASSERT_EQUAL((LongInt)7, engine.get_next_id(u));
+        CPPUNIT_ASSERT_EQUAL(3, alloc->fetches_);
+        alloc->reset();
+        CPPUNIT_ASSERT_EQUAL((LongInt)8, engine.get_next_id(t));
+        CPPUNIT_ASSERT_EQUAL(4, alloc->fetches_);
+    }
+
+    void test_entity_cache()
+    {
+        Table t(_T("A"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("X"), Value::STRING, 10, 0));
+        t.set_cache(Table::ReadWriteCache);
+        EntityCache cache(2);
+        Values row(2), out;
+        row[0] = Value(1);
+        row[1] = Value(_T("one"));
+        CPPUNIT_ASSERT(!cache.get(t, t.mk_key(1), out));
+        cache.put(t, t.mk_key(1), row, cache.generation(t));
+        CPPUNIT_ASSERT(cache.get(t, t.mk_key(1), out));
+        CPPUNIT_ASSERT_EQUAL(string("one"), NARROW(out[1].as_string()));
+        row[0] = Value(2);
+        cache.put(t, t.mk_key(2), row, cache.generation(t));
+        row[0] = Value(3);
+        cache.put(t, t.mk_key(3), row, cache.generation(t));
+        // over the limit, the least recently used row is dropped
+        CPPUNIT_ASSERT_EQUAL((size_t)2, cache.size());
+        CPPUNIT_ASSERT(cache.get(t, t.mk_key(3), out));
+        CPPUNIT_ASSERT(!cache.get(t, t.mk_key(1), out));
+        EntityCacheStats stats = cache.get_stats();
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, stats.hits);
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, stats.misses);
+        CPPUNIT_ASSERT_EQUAL((LongInt)3, stats.puts);
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, stats.evictions);
+        cache.invalidate(t.name());
+        CPPUNIT_ASSERT_EQUAL((size_t)0, cache.size());
+        CPPUNIT_ASSERT(!cache.get(t, t.mk_key(1), out));
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, cache.get_stats().invalidations);
+    }
+
+    void test_entity_cache_generation()
+    {
+        Table t(_T("A"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.set_cache(Table::ReadWriteCache);
+        EntityCache cache;
+        Values row(1, Value(1)), out;
+        LongInt generation = cache.generation(t);
+        // the row has been read before the table was changed
+        cache.invalidate(t.name());
+        cache.put(t, t.mk_key(1), row, generation);
+        CPPUNIT_ASSERT(!cache.get(t, t.mk_key(1), out));
+        cache.put(t, t.mk_key(1), row, cache.generation(t));
+        CPPUNIT_ASSERT(cache.get(t, t.mk_key(1), out));
+    }
+
+    void test_entity_cache_full()
+    {
+        Table t(_T("A"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.set_cache(Table::ReadWriteCache);
+        Table u(_T("B"));
+        u.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        u.set_cache(Table::ReadOnlyCache);
+        EntityCache cache(3);
+        Values row(1), out;
+        for (int i = 1; i <= 3; ++i) {
+            row[0] = Value(i);
+            cache.put(t, t.mk_key(i), row, cache.generation(t));
+        }
+        // the oldest one gets used
+        CPPUNIT_ASSERT(cache.get(t, t.mk_key(1), out));
+        // a new key is cached in place of the least recently used one
+        row[0] = Value(10);
+        cache.put(u, u.mk_key(10), row, cache.generation(u));
+        CPPUNIT_ASSERT_EQUAL((size_t)3, cache.size());
+        CPPUNIT_ASSERT(cache.get(u, u.mk_key(10), out));
+        CPPUNIT_ASSERT_EQUAL((LongInt)10, out[0].as_longint());
+        CPPUNIT_ASSERT(cache.get(t, t.mk_key(1), out));
+        CPPUNIT_ASSERT(!cache.get(t, t.mk_key(2), out));
+        CPPUNIT_ASSERT(cache.get(t, t.mk_key(3), out));
+        // the invalidated rows leave the LRU order as well
+        cache.invalidate(t.name());
+        CPPUNIT_ASSERT_EQUAL((size_t)1, cache.size());
+        for (int i = 4; i <= 6; ++i) {
+            row[0] = Value(i);
+            cache.put(t, t.mk_key(i), row, cache.generation(t));
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)3, cache.size());
+        CPPUNIT_ASSERT(!cache.get(u, u.mk_key(10), out));
+        CPPUNIT_ASSERT(cache.get(t, t.mk_key(6), out));
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, cache.get_stats().evictions);
+    }
+
+    static const Rows mk_query_rows(int count, const String &x)
+    {
+        RowDescr::Ptr descr(new RowDescr);
+        descr->add_column(_T("ID"));
+        descr->add_column(_T("X"));
+        Rows rows;
+        for (int i = 0; i < count; ++i) {
+            rows.push_back(Row(descr));
+            rows.back()[0] = Value(i + 1);
+            rows.back()[1] = Value(x);
+        }
+        return rows;
+    }
+
+    void test_query_cache()
+    {
+        QueryCache cache;
+        Strings tables;
+        tables.push_back(_T("A"));
+        tables.push_back(_T("B"));
+        Rows out;
+        CPPUNIT_ASSERT(!cache.get(_T("Q1"), out));
+        cache.put(_T("Q1"), tables, mk_query_rows(2, _T("one")),
+                cache.generation(tables));
+        CPPUNIT_ASSERT(cache.get(_T("Q1"), out));
+        CPPUNIT_ASSERT_EQUAL((size_t)2, out.size());
+        CPPUNIT_ASSERT_EQUAL(string("X"), NARROW(out[1].name(1)));
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, out[1][0].as_longint());
+        CPPUNIT_ASSERT_EQUAL(string("one"), NARROW(out[1][1].as_string()));
+        CPPUNIT_ASSERT(out[0].descr() == out[1].descr());
+        // the copies handed out have a descriptor of their own
+        Rows out2;
+        CPPUNIT_ASSERT(cache.get(_T("Q1"), out2));
+        CPPUNIT_ASSERT(out[0].descr() != out2[0].descr());
+        // any of the tables read from drops the entry
+        cache.invalidate(_T("b"));
+        CPPUNIT_ASSERT_EQUAL((size_t)0, cache.size());
+        CPPUNIT_ASSERT_EQUAL((size_t)0, cache.bytes());
+        CPPUNIT_ASSERT(!cache.get(_T("Q1"), out));
+        QueryCacheStats stats = cache.get_stats();
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, stats.hits);
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, stats.misses);
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, stats.puts);
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, stats.invalidations);
+    }
+
+    void test_query_cache_lru()
+    {
+        Strings tables(1, _T("A"));
+        Rows rows = mk_query_rows(10, _T("0123456789"));
+        QueryCache probe;
+        probe.put(_T("Q1"), tables, rows, 0);
+        // enough room for two entries only
+        QueryCache cache(probe.bytes() * 2 + probe.bytes() / 2);
+        cache.put(_T("Q1"), tables, rows, 0);
+        cache.put(_T("Q2"), tables, rows, 0);
+        Rows out;
+        CPPUNIT_ASSERT(cache.get(_T("Q1"), out));
+        cache.put(_T("Q3"), tables, rows, 0);
+        CPPUNIT_ASSERT_EQUAL((size_t)2, cache.size());
+        CPPUNIT_ASSERT(cache.get(_T("Q1"), out));
+        CPPUNIT_ASSERT(!cache.get(_T("Q2"), out));
+        CPPUNIT_ASSERT(cache.get(_T("Q3"), out));
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, cache.get_stats().evictions);
+        // too big to be cached at all
+        cache.put(_T("Q4"), tables, mk_query_rows(100, _T("x")), 0);
+        CPPUNIT_ASSERT(!cache.get(_T("Q4"), out));
+        CPPUNIT_ASSERT_EQUAL((size_t)2, cache.size());
+    }
+
+    void test_query_cache_generation()
+    {
+        QueryCache cache;
+        Strings tables(1, _T("A"));
+        LongInt generation = cache.generation(tables);
+        // the rows have been read before the table was changed
+        cache.invalidate(_T("A"));
+        cache.put(_T("Q1"), tables, mk_query_rows(1, _T("x")), generation);
+        Rows out;
+        CPPUNIT_ASSERT(!cache.get(_T("Q1"), out));
+        cache.put(_T("Q1"), tables, mk_query_rows(1, _T("x")),
+                cache.generation(tables));
+        CPPUNIT_ASSERT(cache.get(_T("Q1"), out));
+        cache.clear();
+        CPPUNIT_ASSERT(!cache.get(_T("Q1"), out));
+    }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestEngine);
@@ -411,13 +824,45 @@ static LongInt get_next_test_id(SqlConnection *conn)
     return x.is_null()? 1: x.as_longint() + 1;
 }
 
+class RecordingObserver: public SqlStatementObserver
+{
+public:
+    std::vector<int> phases_;
+    std::vector<LongInt> rows_;
+    std::vector<bool> failed_;
+    std::vector<size_t> n_params_;
+    void on_statement(SqlConnection &conn, const SqlStatementEvent &event)
+    {
+        phases_.push_back(event.phase);
+        rows_.push_back(event.rows);
+        failed_.push_back(event.failed);
+        n_params_.push_back(event.params? event.params->size(): 0);
+        CPPUNIT_ASSERT(event.elapsed >= 0);
+        CPPUNIT_ASSERT(!str_empty(event.sql));
+    }
+};
+
 class TestEngineSql : public CppUnit::TestFixture
 {
     CPPUNIT_TEST_SUITE(TestEngineSql);
     CPPUNIT_TEST(test_select_sql);
     CPPUNIT_TEST(test_select_sql_max_rows);
     CPPUNIT_TEST(test_insert_sql);
+    CPPUNIT_TEST(test_insert_batch_sql);
+    CPPUNIT_TEST(test_insert_new_ids_sql);
     CPPUNIT_TEST(test_update_sql);
+    CPPUNIT_TEST(test_fetch_shared_descr);
+    CPPUNIT_TEST(test_fetch_text_params);
+    CPPUNIT_TEST(test_fetch_multibyte);
+    CPPUNIT_TEST(test_stmt_cache);
+    CPPUNIT_TEST(test_exec_many);
+    CPPUNIT_TEST(test_exec_many_mixed_types);
+    CPPUNIT_TEST(test_typed_values);
+    CPPUNIT_TEST(test_statement_observer);
+    CPPUNIT_TEST(test_slow_query_log);
+    CPPUNIT_TEST(test_query_cache);
+    CPPUNIT_TEST(test_query_cache_key);
+    CPPUNIT_TEST(test_query_cache_big_result);
     CPPUNIT_TEST_SUITE_END();
 
     LongInt record_id_;
@@ -517,6 +962,75 @@ public:
         engine.commit();
     }
 
+    void test_insert_batch_sql()
+    {
+        Engine engine(Engine::READ_WRITE);
+        setup_log(engine);
+        engine.get_conn()->set_echo(false);
+        Table t(_T("T_ORM_TEST"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("A"), Value::STRING, 100, 0));
+        t.add_column(Column(_T("B"), Value::DATETIME, 0, Column::RO));
+        t.add_column(Column(_T("C"), Value::DECIMAL, 0, 0));
+        // more rows than fit into one statement for any dialect
+        const int count = 2503;
+        LongInt id = get_next_test_id(engine.get_conn());
+        std::vector<Values> data(count);
+        RowsData rows;
+        for (int i = 0; i < count; ++i) {
+            data[i].push_back(Value(id + i));
+            data[i].push_back(Value(_T("batch")));
+            data[i].push_back(Value(now()));
+            data[i].push_back(Value(Decimal(i)));
+            rows.push_back(&data[i]);
+        }
+        engine.get_conn()->grant_insert_id(_T("T_ORM_TEST"), true, true);
+        engine.insert(t, rows, false);
+        engine.get_conn()->grant_insert_id(_T("T_ORM_TEST"), false, true);
+        RowsPtr ptr = engine.select(Expression(_T("COUNT(*)")),
+                ColumnExpr(t.name()),
+                t.column(_T("A")) == Value(_T("batch")));
+        CPPUNIT_ASSERT_EQUAL(count, (int)(*ptr)[0][0].as_longint());
+        ptr = engine.select(Expression(_T("C")), ColumnExpr(t.name()),
+                t.column(_T("ID")) == Value(id + count - 1));
+        CPPUNIT_ASSERT_EQUAL(1, (int)ptr->size());
+        CPPUNIT_ASSERT(Decimal(count - 1) == (*ptr)[0][0].as_decimal());
+        engine.commit();
+    }
+
+    void test_insert_new_ids_sql()
+    {
+        Engine engine(Engine::READ_WRITE);
+        setup_log(engine);
+        Table t(_T("T_ORM_TEST"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("A"), Value::STRING, 100, 0));
+        t.add_column(Column(_T("B"), Value::DATETIME, 0, Column::RO));
+        t.add_column(Column(_T("C"), Value::DECIMAL, 0, 0));
+        if (engine.get_dialect()->has_sequences())
+            return;
+        const int count = 3;
+        std::vector<Values> data(count);
+        RowsData rows;
+        for (int i = 0; i < count; ++i) {
+            data[i].push_back(Value());
+            data[i].push_back(Value(_T("new") + to_string(i)));
+            data[i].push_back(Value());
+            data[i].push_back(Value(Decimal(i)));
+            rows.push_back(&data[i]);
+        }
+        std::vector<LongInt> ids = engine.insert(t, rows, true);
+        CPPUNIT_ASSERT_EQUAL(count, (int)ids.size());
+        for (int i = 0; i < count; ++i) {
+            RowsPtr ptr = engine.select(Expression(_T("A")),
+                    ColumnExpr(t.name()), t.column(_T("ID")) == ids[i]);
+            CPPUNIT_ASSERT_EQUAL(1, (int)ptr->size());
+            CPPUNIT_ASSERT_EQUAL(NARROW(_T("new") + to_string(i)),
+                    NARROW((*ptr)[0][0].as_string()));
+        }
+        engine.commit();
+    }
+
     void test_update_sql()
     {
         Engine engine(Engine::READ_WRITE);
@@ -547,6 +1061,393 @@ public:
                 find_in_row(*ptr->begin(), _T("B"))->second.as_date_time());
         engine.commit();
     }
+
+    void test_fetch_shared_descr()
+    {
+        SqlConnection conn(Engine::sql_source_from_env());
+        setup_log(conn);
+        std::auto_ptr<SqlCursor> cur = conn.new_cursor();
+        cur->prepare(_T("SELECT ID, A FROM T_ORM_TEST WHERE ID = ?"));
+        Values params;
+        params.push_back(Value(record_id_));
+        cur->exec(params);
+        RowPtr row1 = cur->fetch_row();
+        CPPUNIT_ASSERT(row1.get() != NULL);
+        cur->exec(params);
+        RowPtr row2 = cur->fetch_row();
+        CPPUNIT_ASSERT(row2.get() != NULL);
+        CPPUNIT_ASSERT(row1->descr().get() != NULL);
+        CPPUNIT_ASSERT(row1->descr().get() == row2->descr().get());
+        CPPUNIT_ASSERT_EQUAL(string("A"), NARROW(row2->name(1)));
+        CPPUNIT_ASSERT_EQUAL(string("item"), NARROW((*row2)[1].as_string()));
+    }
+
+    void test_fetch_text_params()
+    {
+        SqlConnection conn(Engine::sql_source_from_env());
+        setup_log(conn);
+        std::auto_ptr<SqlCursor> cur = conn.new_cursor();
+        // the text parameters are used by every fetch, not just by exec
+        cur->prepare(_T("SELECT ID FROM T_ORM_TEST WHERE A = ? AND ID < ?"
+                    " UNION ALL SELECT ID FROM T_ORM_TEST WHERE A = ?"));
+        Values params;
+        params.push_back(Value(_T("nothing")));
+        params.push_back(Value(record_id_ + 1));
+        params.push_back(Value(_T("item")));
+        cur->exec(params);
+        params.clear();
+        RowsPtr rows = cur->fetch_rows();
+        CPPUNIT_ASSERT_EQUAL(1, (int)rows->size());
+        CPPUNIT_ASSERT_EQUAL(record_id_, (*rows)[0][0].as_longint());
+    }
+
+    void test_fetch_multibyte()
+    {
+        SqlConnection conn(Engine::sql_source_from_env());
+        conn.set_convert_params(true);
+        setup_log(conn);
+        conn.begin_trans_if_necessary();
+        // as many characters as the column holds, two bytes each in UTF-8
+        std::string s;
+        for (int i = 0; i < 200; ++i)
+            s += "\xd0\xb6";
+        Values params;
+        params.push_back(Value(WIDEN(s)));
+        params.push_back(Value(record_id_));
+        conn.prepare(_T("UPDATE T_ORM_TEST SET A = ? WHERE ID = ?"));
+        conn.exec(params);
+        std::auto_ptr<SqlCursor> cur = conn.new_cursor();
+        cur->prepare(_T("SELECT A FROM T_ORM_TEST WHERE ID = ?"));
+        params.erase(params.begin());
+        cur->exec(params);
+        RowsPtr rows = cur->fetch_rows();
+        CPPUNIT_ASSERT_EQUAL(1, (int)rows->size());
+        CPPUNIT_ASSERT_EQUAL(s, NARROW((*rows)[0][0].as_string()));
+        conn.rollback();
+    }
+
+    void test_exec_many()
+    {
+        SqlConnection conn(Engine::sql_source_from_env());
+        conn.set_convert_params(true);
+        setup_log(conn);
+        conn.begin_trans_if_necessary();
+        std::auto_ptr<SqlCursor> cur = conn.new_cursor();
+        cur->prepare(_T("UPDATE T_ORM_TEST SET A = ? WHERE ID = ?"));
+        TypeCodes types;
+        types.push_back(Value::STRING);
+        types.push_back(Value::LONGINT);
+        cur->bind_params(types);
+        std::vector<Values> params_set(3, Values(2));
+        params_set[0][0] = Value(_T("many"));
+        params_set[0][1] = Value(record_id_);
+        params_set[1][0] = Value(_T("x"));
+        params_set[1][1] = Value(record_id_ + 100);
+        params_set[2][0] = Value(_T("many more"));
+        params_set[2][1] = Value(record_id_);
+        cur->exec_many(params_set);
+        cur->prepare(_T("SELECT A FROM T_ORM_TEST WHERE ID = ?"));
+        Values params;
+        params.push_back(Value(record_id_));
+        cur->exec(params);
+        RowsPtr rows = cur->fetch_rows();
+        CPPUNIT_ASSERT_EQUAL(1, (int)rows->size());
+        CPPUNIT_ASSERT_EQUAL(string("many more"),
+                NARROW((*rows)[0][0].as_string()));
+        conn.commit();
+    }
+
+    void test_exec_many_mixed_types()
+    {
+        SqlConnection conn(Engine::sql_source_from_env());
+        setup_log(conn);
+        conn.begin_trans_if_necessary();
+        std::auto_ptr<SqlCursor> cur = conn.new_cursor();
+        cur->prepare(_T("UPDATE T_ORM_TEST SET D = ? WHERE ID = ?"));
+        // the later values don't fit the type of the first ones
+        std::vector<Values> params_set(3, Values(2));
+        params_set[0][0] = Value(1);
+        params_set[0][1] = Value((int)record_id_);
+        params_set[1][0] = Value(0.5);
+        params_set[1][1] = Value((LongInt)5000000000LL);
+        params_set[2][0] = Value(2.5);
+        params_set[2][1] = Value((int)record_id_);
+        cur->exec_many(params_set);
+        cur->prepare(_T("SELECT D FROM T_ORM_TEST WHERE ID = ?"));
+        Values params;
+        params.push_back(Value(record_id_));
+        cur->exec(params);
+        RowsPtr rows = cur->fetch_rows();
+        CPPUNIT_ASSERT_EQUAL(1, (int)rows->size());
+        CPPUNIT_ASSERT_EQUAL(2.5, (*rows)[0][0].as_float());
+        conn.rollback();
+    }
+
+    void test_stmt_cache()
+    {
+        Engine engine(Engine::READ_ONLY);
+        setup_log(engine);
+        SqlConnection *conn = engine.get_conn();
+        conn->set_stmt_cache_size(1);
+        const StmtCacheStats &stats = conn->get_stmt_cache_stats();
+        int misses = stats.misses, hits = stats.hits;
+        for (int i = 0; i < 3; ++i) {
+            RowsPtr ptr = engine.select(Expression(_T("A")),
+                    Expression(_T("T_ORM_TEST")),
+                    Expression(_T("ID")) == record_id_);
+            CPPUNIT_ASSERT_EQUAL(1, (int)ptr->size());
+            CPPUNIT_ASSERT_EQUAL(string("item"),
+                    NARROW((*ptr)[0][0].as_string()));
+        }
+        CPPUNIT_ASSERT_EQUAL(misses + 1, stats.misses);
+        CPPUNIT_ASSERT_EQUAL(hits + 2, stats.hits);
+        // the same statement while the first one is still being read
+        {
+            SqlResultSet rs1 = engine.select_iter(
+                    SelectExpr(Expression(_T("A")))
+                    .from_(Expression(_T("T_ORM_TEST"))));
+            SqlResultSet rs2 = engine.select_iter(
+                    SelectExpr(Expression(_T("A")))
+                    .from_(Expression(_T("T_ORM_TEST"))));
+            CPPUNIT_ASSERT(rs1.begin() != rs1.end());
+            CPPUNIT_ASSERT(rs2.begin() != rs2.end());
+        }
+        CPPUNIT_ASSERT_EQUAL(misses + 3, stats.misses);
+        int evictions = stats.evictions;
+        engine.select(Expression(_T("A")), Expression(_T("T_ORM_TEST")),
+                Expression(_T("ID")) == record_id_);
+        CPPUNIT_ASSERT_EQUAL(evictions + 1, stats.evictions);
+        conn->set_stmt_cache_size(0);
+        engine.select(Expression(_T("A")), Expression(_T("T_ORM_TEST")),
+                Expression(_T("ID")) == record_id_);
+        CPPUNIT_ASSERT_EQUAL(misses + 5, stats.misses);
+    }
+
+    void test_statement_observer()
+    {
+        SqlConnection conn(Engine::sql_source_from_env());
+        RecordingObserver observer;
+        conn.set_observer(&observer);
+        {
+            std::auto_ptr<SqlCursor> cur = conn.new_cursor();
+            cur->prepare(_T("SELECT ID FROM T_ORM_TEST WHERE ID >= ?"));
+            Values params;
+            params.push_back(Value(record_id_));
+            cur->exec(params);
+            RowsPtr rows = cur->fetch_rows();
+            CPPUNIT_ASSERT_EQUAL((size_t)1, rows->size());
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)3, observer.phases_.size());
+        CPPUNIT_ASSERT_EQUAL((int)STMT_PREPARE, observer.phases_[0]);
+        CPPUNIT_ASSERT_EQUAL((int)STMT_EXEC, observer.phases_[1]);
+        CPPUNIT_ASSERT_EQUAL((size_t)1, observer.n_params_[1]);
+        CPPUNIT_ASSERT_EQUAL((int)STMT_FETCH, observer.phases_[2]);
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, observer.rows_[2]);
+        // the fetch timing is reported when the cursor goes away
+        {
+            std::auto_ptr<SqlCursor> cur = conn.new_cursor();
+            cur->prepare(_T("SELECT ID FROM T_ORM_TEST"));
+            cur->exec(Values());
+            CPPUNIT_ASSERT(cur->fetch_row().get() != NULL);
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)6, observer.phases_.size());
+        CPPUNIT_ASSERT_EQUAL((int)STMT_FETCH, observer.phases_[5]);
+        bool failed = false;
+        try {
+            conn.exec_direct(_T("SELECT * FROM NO_SUCH_TABLE"));
+        }
+        catch (const DBError &) {
+            failed = true;
+        }
+        CPPUNIT_ASSERT(failed);
+        CPPUNIT_ASSERT_EQUAL((size_t)7, observer.phases_.size());
+        CPPUNIT_ASSERT_EQUAL((int)STMT_EXEC_DIRECT, observer.phases_[6]);
+        CPPUNIT_ASSERT(observer.failed_[6]);
+        conn.set_observer(NULL);
+    }
+
+    void test_slow_query_log()
+    {
+        std::ostringstream out;
+        LogAppender appender(out);
+        Logger root(&appender);
+        SqlConnection conn(Engine::sql_source_from_env());
+        SlowQueryLog slow_log(&root, 0);
+        conn.set_observer(&slow_log);
+        conn.prepare(_T("SELECT ID FROM T_ORM_TEST WHERE ID = ?"));
+        Values params;
+        params.push_back(Value(record_id_));
+        conn.exec(params);
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, slow_log.slow_count());
+        appender.flush();
+        CPPUNIT_ASSERT(out.str().find("slow exec: ") != std::string::npos);
+        CPPUNIT_ASSERT(out.str().find(
+                    "sql: SELECT ID FROM T_ORM_TEST WHERE ID = ? p1=")
+                != std::string::npos);
+        // nothing is slow, every second statement is logged
+        SlowQueryLog sampled_log(&root, 1000000, 2);
+        conn.set_observer(&sampled_log);
+        for (int i = 0; i < 4; ++i)
+            conn.exec_direct(_T("SELECT 1"));
+        conn.set_observer(NULL);
+        appender.flush();
+        CPPUNIT_ASSERT_EQUAL((LongInt)0, sampled_log.slow_count());
+        size_t count = 0, pos = 0;
+        const std::string s = out.str();
+        while ((pos = s.find("sampled exec_direct", pos)) != std::string::npos) {
+            ++count;
+            ++pos;
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)2, count);
+    }
+
+    void test_typed_values()
+    {
+        Engine engine(Engine::READ_WRITE);
+        setup_log(engine);
+        Table t(_T("T_ORM_TEST"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("A"), Value::STRING, 100, 0));
+        t.add_column(Column(_T("D"), Value::FLOAT, 0, 0));
+        // does not fit into 32 bits
+        LongInt id = record_id_ + LongInt(5000000000LL);
+        Values row;
+        row.push_back(Value(id));
+        row.push_back(Value(_T("big")));
+        row.push_back(Value(0.25));
+        RowsData rows;
+        rows.push_back(&row);
+        engine.get_conn()->grant_insert_id(_T("T_ORM_TEST"), true, true);
+        engine.insert(t, rows, false);
+        engine.get_conn()->grant_insert_id(_T("T_ORM_TEST"), false, true);
+        RowsPtr ptr = engine.select(Expression(_T("ID, A, D")),
+                ColumnExpr(t.name()), t.column(_T("ID")) == id);
+        CPPUNIT_ASSERT_EQUAL(1, (int)ptr->size());
+        Row &r = (*ptr)[0];
+        CPPUNIT_ASSERT_EQUAL(id, r[0].as_longint());
+        CPPUNIT_ASSERT_EQUAL(string("big"), NARROW(r[1].as_string()));
+        CPPUNIT_ASSERT_EQUAL(0.25, r[2].as_float());
+        if (engine.get_dialect()->get_name() == _T("SQLITE")) {
+            CPPUNIT_ASSERT_EQUAL((int)Value::LONGINT, r[0].get_type());
+            CPPUNIT_ASSERT_EQUAL((int)Value::FLOAT, r[2].get_type());
+        }
+    }
+
+    void test_query_cache()
+    {
+        Engine engine(Engine::READ_WRITE);
+        setup_log(engine);
+        engine.set_query_cache(std::auto_ptr<QueryCache>(new QueryCache));
+        QueryCache *cache = engine.query_cache();
+        Table t(_T("T_ORM_TEST"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("A"), Value::STRING, 100, 0));
+        for (int i = 0; i < 2; ++i) {
+            RowsPtr ptr = engine.select(Expression(_T("A")),
+                    ColumnExpr(t.name()), t.column(_T("ID")) == record_id_);
+            CPPUNIT_ASSERT_EQUAL(1, (int)ptr->size());
+            CPPUNIT_ASSERT_EQUAL(string("item"),
+                    NARROW((*ptr)[0][0].as_string()));
+        }
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, cache->get_stats().hits);
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, cache->get_stats().misses);
+        Values row;
+        row.push_back(Value(record_id_));
+        row.push_back(Value(_T("changed")));
+        RowsData rows;
+        rows.push_back(&row);
+        engine.update(t, rows);
+        CPPUNIT_ASSERT_EQUAL((size_t)0, cache->size());
+        // not cached until the change is committed
+        for (int i = 0; i < 2; ++i) {
+            RowsPtr ptr = engine.select(Expression(_T("A")),
+                    ColumnExpr(t.name()), t.column(_T("ID")) == record_id_);
+            CPPUNIT_ASSERT_EQUAL(string("changed"),
+                    NARROW((*ptr)[0][0].as_string()));
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)0, cache->size());
+        engine.commit();
+        engine.select(Expression(_T("A")),
+                ColumnExpr(t.name()), t.column(_T("ID")) == record_id_);
+        CPPUNIT_ASSERT_EQUAL((size_t)1, cache->size());
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, cache->get_stats().hits);
+    }
+
+    void test_query_cache_key()
+    {
+        Engine engine(Engine::READ_ONLY);
+        setup_log(engine);
+        engine.set_query_cache(std::auto_ptr<QueryCache>(new QueryCache));
+        Table t(_T("T_ORM_TEST"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("A"), Value::STRING, 100, 0));
+        // the parameters would give the same text if just joined
+        RowsPtr ptr = engine.select(Expression(_T("ID")), ColumnExpr(t.name()),
+                t.column(_T("A")) == Value(_T("item\n3:y")) ||
+                t.column(_T("A")) == Value(_T("z")));
+        CPPUNIT_ASSERT_EQUAL(0, (int)ptr->size());
+        ptr = engine.select(Expression(_T("ID")), ColumnExpr(t.name()),
+                t.column(_T("A")) == Value(_T("item")) ||
+                t.column(_T("A")) == Value(_T("y\n3:z")));
+        CPPUNIT_ASSERT_EQUAL(1, (int)ptr->size());
+        // floats and datetimes differing past their default text
+        t.add_column(Column(_T("B"), Value::DATETIME, 0, 0));
+        t.add_column(Column(_T("D"), Value::FLOAT, 0, 0));
+        engine.select(Expression(_T("ID")), ColumnExpr(t.name()),
+                t.column(_T("D")) == Value(1.0000001));
+        engine.select(Expression(_T("ID")), ColumnExpr(t.name()),
+                t.column(_T("D")) == Value(1.0000002));
+        engine.select(Expression(_T("ID")), ColumnExpr(t.name()),
+                t.column(_T("B")) == Value(dt_make(2001, 1, 1, 0, 0, 0, 100)));
+        engine.select(Expression(_T("ID")), ColumnExpr(t.name()),
+                t.column(_T("B")) == Value(dt_make(2001, 1, 1, 0, 0, 0, 900)));
+        CPPUNIT_ASSERT_EQUAL((LongInt)0, engine.query_cache()->get_stats().hits);
+        CPPUNIT_ASSERT_EQUAL((LongInt)6, engine.query_cache()->get_stats().misses);
+    }
+
+    void test_query_cache_big_result()
+    {
+        {
+            SqlConnection conn(Engine::sql_source_from_env());
+            setup_log(conn);
+            conn.begin_trans_if_necessary();
+            conn.grant_insert_id(_T("T_ORM_TEST"), true, true);
+            conn.prepare(_T("INSERT INTO T_ORM_TEST(ID, A) VALUES(?, ?)"));
+            Values params(2);
+            params[1] = Value(String(150, _T('x')));
+            for (int i = 1; i <= 5; ++i) {
+                params[0] = Value(record_id_ + i);
+                conn.exec(params);
+            }
+            conn.grant_insert_id(_T("T_ORM_TEST"), false, true);
+            conn.commit();
+        }
+        Engine engine(Engine::READ_ONLY);
+        setup_log(engine);
+        // room for a few of the rows only
+        engine.set_query_cache(std::auto_ptr<QueryCache>(new QueryCache(1000)));
+        QueryCache *cache = engine.query_cache();
+        Table t(_T("T_ORM_TEST"));
+        t.add_column(Column(_T("ID"), Value::LONGINT, 0, Column::PK));
+        t.add_column(Column(_T("A"), Value::STRING, 100, 0));
+        for (int i = 0; i < 2; ++i) {
+            RowsPtr ptr = engine.select(Expression(_T("ID, A")),
+                    ColumnExpr(t.name()), t.column(_T("ID")) >= record_id_,
+                    Expression(), Expression(), Expression(_T("ID")));
+            CPPUNIT_ASSERT_EQUAL(6, (int)ptr->size());
+            for (int j = 0; j < 6; ++j)
+                CPPUNIT_ASSERT_EQUAL(record_id_ + j, (*ptr)[j][0].as_longint());
+        }
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, cache->get_stats().misses);
+        CPPUNIT_ASSERT_EQUAL((LongInt)0, cache->get_stats().puts);
+        // a result cut to max_rows doesn't use the cache at all
+        RowsPtr ptr = engine.select(Expression(_T("ID")),
+                ColumnExpr(t.name()), t.column(_T("ID")) == record_id_,
+                Expression(), Expression(), Expression(), 1);
+        CPPUNIT_ASSERT_EQUAL(1, (int)ptr->size());
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, cache->get_stats().misses);
+        CPPUNIT_ASSERT_EQUAL((size_t)0, cache->size());
+    }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestEngineSql);
@@ -684,4 +1585,334 @@ public:
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestSqlIntrospection);
 
+static SqlSource pool_test_source(int max_size, int min_idle = 0)
+{
+    SqlSource src = Engine::sql_source_from_env(_T("pool_test"));
+    src[_T("pool_max_size")] = Yb::to_string(max_size);
+    src[_T("pool_min_idle")] = Yb::to_string(min_idle);
+    return src;
+}
+
+class PoolStats
+{
+    Mutex mux_;
+    int in_use_;
+public:
+    int max_in_use_, done_, errors_;
+    PoolStats(): in_use_(0), max_in_use_(0), done_(0), errors_(0) {}
+    void acquired() {
+        ScopedLock lock(mux_);
+        if (++in_use_ > max_in_use_)
+            max_in_use_ = in_use_;
+    }
+    void released(bool ok) {
+        ScopedLock lock(mux_);
+        --in_use_;
+        ++done_;
+        if (!ok)
+            ++errors_;
+    }
+    void failed() {
+        ScopedLock lock(mux_);
+        ++done_;
+        ++errors_;
+    }
+};
+
+class PoolClientThread: public Thread
+{
+    SqlPool &pool_;
+    PoolStats &stats_;
+public:
+    PoolClientThread(SqlPool &pool, PoolStats &stats)
+        : pool_(pool), stats_(stats)
+    {}
+    void on_run()
+    {
+        try {
+            SqlConnectionVar conn(pool_, _T("pool_test"), 60);
+            stats_.acquired();
+            bool ok = false;
+            try {
+                std::auto_ptr<SqlCursor> cur = conn->new_cursor();
+                cur->prepare(_T("SELECT COUNT(*) CNT FROM T_ORM_TEST"));
+                cur->exec(Values());
+                ok = cur->fetch_row().get() != NULL;
+            }
+            catch (const std::exception &) {}
+            stats_.released(ok);
+        }
+        catch (const std::exception &) {
+            stats_.failed();
+        }
+    }
+};
+
+class TestSqlPool: public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestSqlPool);
+    CPPUNIT_TEST(test_pool_max_size);
+    CPPUNIT_TEST(test_pool_timeout);
+    CPPUNIT_TEST(test_pool_hand_off);
+    CPPUNIT_TEST(test_ping);
+    CPPUNIT_TEST(test_pool_stats);
+    CPPUNIT_TEST(test_replicas_round_robin);
+    CPPUNIT_TEST(test_replicas_least_in_use);
+    CPPUNIT_TEST(test_replicas_fallback);
+    CPPUNIT_TEST(test_replicas_busy);
+    CPPUNIT_TEST(test_read_only_engine);
+    CPPUNIT_TEST(test_pool_keeps_stmt_cache);
+    CPPUNIT_TEST_EXCEPTION(test_pool_unknown_source, PoolError);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void test_pool_max_size()
+    {
+        const int n_threads = 300, max_size = 3;
+        SqlPool pool(YB_POOL_MAX_SIZE, YB_POOL_IDLE_TIME,
+                YB_POOL_MONITOR_SLEEP, NULL, true, 2);
+        pool.add_source(pool_test_source(max_size, 2));
+        PoolStats stats;
+        std::vector<PoolClientThread *> threads;
+        for (int i = 0; i < n_threads; ++i)
+            threads.push_back(new PoolClientThread(pool, stats));
+        for (int i = 0; i < n_threads; ++i)
+            threads[i]->start();
+        for (int i = 0; i < n_threads; ++i) {
+            threads[i]->wait();
+            delete threads[i];
+        }
+        CPPUNIT_ASSERT_EQUAL(n_threads, stats.done_);
+        CPPUNIT_ASSERT_EQUAL(0, stats.errors_);
+        CPPUNIT_ASSERT(stats.max_in_use_ >= 1);
+        CPPUNIT_ASSERT(stats.max_in_use_ <= max_size);
+    }
+
+    void test_pool_timeout()
+    {
+        SqlPool pool(1);
+        pool.add_source(Engine::sql_source_from_env(_T("pool_test")));
+        SqlConnection *conn = pool.get(_T("pool_test"), 1);
+        CPPUNIT_ASSERT(conn != NULL);
+        bool timed_out = false;
+        try {
+            pool.get(_T("pool_test"), 0);
+        }
+        catch (const PoolError &) {
+            timed_out = true;
+        }
+        CPPUNIT_ASSERT(timed_out);
+        timed_out = false;
+        MilliSec t0 = get_cur_time_millisec();
+        try {
+            pool.get(_T("pool_test"), 1);
+        }
+        catch (const PoolError &) {
+            timed_out = true;
+        }
+        CPPUNIT_ASSERT(timed_out);
+        CPPUNIT_ASSERT(get_cur_time_millisec() - t0 >= 900);
+        pool.put(conn);
+        SqlConnection *conn2 = pool.get(_T("pool_test"), 0);
+        CPPUNIT_ASSERT(conn == conn2);
+        pool.put(conn2, true);
+        conn = pool.get(_T("pool_test"), 0);
+        CPPUNIT_ASSERT(conn != NULL);
+        pool.put(conn);
+    }
+
+    void test_pool_hand_off()
+    {
+        SqlPool pool(1);
+        pool.add_source(Engine::sql_source_from_env(_T("pool_test")));
+        SqlConnection *conn = pool.get(_T("pool_test"), 1);
+        PoolStats stats;
+        PoolClientThread client(pool, stats);
+        client.start();
+        // give the client a chance to start waiting
+        Mutex mux;
+        Condition cond(mux);
+        {
+            ScopedLock lock(mux);
+            cond.wait(lock, 200);
+        }
+        CPPUNIT_ASSERT_EQUAL(0, stats.done_);
+        pool.put(conn);
+        client.wait();
+        CPPUNIT_ASSERT_EQUAL(1, stats.done_);
+        CPPUNIT_ASSERT_EQUAL(0, stats.errors_);
+        CPPUNIT_ASSERT(conn == pool.get(_T("pool_test"), 0));
+        pool.put(conn);
+    }
+
+    void test_ping()
+    {
+        SqlPool pool(1);
+        pool.add_source(Engine::sql_source_from_env(_T("pool_test")));
+        SqlConnectionVar conn(pool, _T("pool_test"), 0);
+        CPPUNIT_ASSERT(conn->ping());
+        CPPUNIT_ASSERT(!conn->bad());
+        CPPUNIT_ASSERT_EQUAL(1, conn->get_stats().checkouts);
+        CPPUNIT_ASSERT_EQUAL(0, conn->get_stats().bad_marks);
+    }
+
+    void test_pool_stats()
+    {
+        SqlPool pool(2);
+        pool.add_source(Engine::sql_source_from_env(_T("pool_test")));
+        SqlConnection *a = pool.get(_T("pool_test"), 0);
+        SqlConnection *b = pool.get(_T("pool_test"), 0);
+        try {
+            pool.get(_T("pool_test"), 0);
+        }
+        catch (const PoolError &) {}
+        SqlPoolStats stats = pool.get_pool_stats(_T("pool_test"));
+        CPPUNIT_ASSERT_EQUAL(2, stats.in_use);
+        CPPUNIT_ASSERT_EQUAL(0, stats.idle);
+        CPPUNIT_ASSERT_EQUAL(2, stats.max_size);
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, stats.timeouts);
+        CPPUNIT_ASSERT(stats.longest_hold >= 0);
+        pool.put(a);
+        pool.put(b, true);
+        a = pool.get(_T("pool_test"), 0);
+        pool.put(a);
+        stats = pool.get_pool_stats(_T("pool_test"));
+        CPPUNIT_ASSERT_EQUAL(0, stats.in_use);
+        CPPUNIT_ASSERT_EQUAL(1, stats.idle);
+        CPPUNIT_ASSERT_EQUAL((LongInt)3, stats.checkouts);
+        CPPUNIT_ASSERT_EQUAL((LongInt)2, stats.opened);
+        CPPUNIT_ASSERT_EQUAL((LongInt)1, stats.closed);
+        LongInt waits = 0;
+        for (int i = 0; i < YB_POOL_WAIT_BUCKETS; ++i)
+            waits += stats.wait_hist[i];
+        CPPUNIT_ASSERT_EQUAL((LongInt)3, waits);
+        std::string json = ElementTree::etree2json(pool.stats_to_json());
+        CPPUNIT_ASSERT(json.find("{\"pool_test\": {\"in_use\": 0, "
+                    "\"idle\": 1, ") == 0);
+        CPPUNIT_ASSERT(json.find("\"ge_10000\": 0}") != std::string::npos);
+    }
+
+    void test_replicas_round_robin()
+    {
+        SqlPool pool(2);
+        pool.add_source(Engine::sql_source_from_env(_T("primary")));
+        pool.add_replica(_T("primary"), Engine::sql_source_from_env(_T("r1")));
+        pool.add_replica(_T("primary"), Engine::sql_source_from_env(_T("r2")));
+        const char *expected[] = { "r1", "r2", "r1" };
+        for (int i = 0; i < 3; ++i) {
+            SqlConnection *conn = pool.get_for_read(_T("primary"), 0);
+            CPPUNIT_ASSERT_EQUAL(string(expected[i]),
+                    NARROW(conn->get_source().id()));
+            pool.put(conn);
+        }
+        SqlConnection *conn = pool.get(_T("primary"), 0);
+        CPPUNIT_ASSERT_EQUAL(string("primary"),
+                NARROW(conn->get_source().id()));
+        pool.put(conn);
+    }
+
+    void test_replicas_least_in_use()
+    {
+        SqlPool pool(2);
+        SqlSource primary = Engine::sql_source_from_env(_T("primary"));
+        primary[_T("pool_balancing")] = _T("least_in_use");
+        pool.add_source(primary);
+        pool.add_replica(_T("primary"), Engine::sql_source_from_env(_T("r1")));
+        pool.add_replica(_T("primary"), Engine::sql_source_from_env(_T("r2")));
+        SqlConnection *c1 = pool.get_for_read(_T("primary"), 0);
+        SqlConnection *c2 = pool.get_for_read(_T("primary"), 0);
+        SqlConnection *c3 = pool.get_for_read(_T("primary"), 0);
+        CPPUNIT_ASSERT(c1->get_source().id() != c2->get_source().id());
+        // both replicas are used, the third one goes to the less loaded
+        CPPUNIT_ASSERT(c3->get_source().id() != _T("primary"));
+        pool.put(c3);
+        pool.put(c1);
+        SqlConnection *c4 = pool.get_for_read(_T("primary"), 0);
+        CPPUNIT_ASSERT_EQUAL(NARROW(c1->get_source().id()),
+                NARROW(c4->get_source().id()));
+        pool.put(c4);
+        pool.put(c2);
+    }
+
+    void test_replicas_fallback()
+    {
+        SqlPool pool(2);
+        pool.add_source(Engine::sql_source_from_env(_T("primary")));
+        SqlSource broken(_T("sqlite:///nonexistent/dir/replica.db"));
+        broken[_T("&id")] = _T("broken");
+        pool.add_replica(_T("primary"), broken);
+        SqlConnection *conn = pool.get_for_read(_T("primary"), 0);
+        CPPUNIT_ASSERT_EQUAL(string("primary"),
+                NARROW(conn->get_source().id()));
+        pool.put(conn);
+        CPPUNIT_ASSERT_EQUAL((LongInt)1,
+                pool.get_pool_stats(_T("broken")).open_errors);
+        // the broken replica is not tried again for a while
+        conn = pool.get_for_read(_T("primary"), 0);
+        pool.put(conn);
+        CPPUNIT_ASSERT_EQUAL((LongInt)1,
+                pool.get_pool_stats(_T("broken")).open_errors);
+    }
+
+    void test_replicas_busy()
+    {
+        SqlPool pool(1);
+        pool.add_source(Engine::sql_source_from_env(_T("primary")));
+        pool.add_replica(_T("primary"), Engine::sql_source_from_env(_T("r1")));
+        pool.add_replica(_T("primary"), Engine::sql_source_from_env(_T("r2")));
+        SqlConnection *c1 = pool.get_for_read(_T("primary"), 0);
+        SqlConnection *c2 = pool.get_for_read(_T("primary"), 0);
+        // both replicas are full, they are skipped with no waiting
+        MilliSec t0 = get_cur_time_millisec();
+        SqlConnection *c3 = pool.get_for_read(_T("primary"), 5);
+        CPPUNIT_ASSERT(get_cur_time_millisec() - t0 < 1000);
+        CPPUNIT_ASSERT_EQUAL(string("primary"),
+                NARROW(c3->get_source().id()));
+        CPPUNIT_ASSERT_EQUAL((LongInt)0, pool.get_pool_stats(_T("r1")).timeouts);
+        pool.put(c3);
+        pool.put(c2);
+        pool.put(c1);
+    }
+
+    void test_read_only_engine()
+    {
+        auto_ptr<SqlPool> pool(new SqlPool(2));
+        pool->add_source(Engine::sql_source_from_env(_T("primary")));
+        pool->add_replica(_T("primary"), Engine::sql_source_from_env(_T("r1")));
+        Engine engine(Engine::READ_ONLY, pool, _T("primary"));
+        CPPUNIT_ASSERT_EQUAL(string("r1"),
+                NARROW(engine.get_conn()->get_source().id()));
+    }
+
+    void test_pool_keeps_stmt_cache()
+    {
+        auto_ptr<SqlPool> pool(new SqlPool(1));
+        pool->add_source(Engine::sql_source_from_env(_T("primary")));
+        Engine engine(Engine::READ_ONLY, pool, _T("primary"));
+        RecordingObserver observer;
+        SqlConnection *conn = NULL;
+        // one session after another on the same pooled connection
+        for (int i = 0; i < 2; ++i) {
+            auto_ptr<EngineCloned> cloned = engine.clone();
+            CPPUNIT_ASSERT(!conn || conn == cloned->get_conn());
+            conn = cloned->get_conn();
+            conn->set_observer(&observer);
+            cloned->select(Expression(_T("ID")),
+                    Expression(_T("T_ORM_TEST")), Expression());
+        }
+        CPPUNIT_ASSERT_EQUAL(1, (int)count(observer.phases_.begin(),
+                    observer.phases_.end(), (int)STMT_PREPARE));
+        CPPUNIT_ASSERT_EQUAL(1, conn->get_stmt_cache_stats().hits);
+        conn->set_observer(NULL);
+    }
+
+    void test_pool_unknown_source()
+    {
+        SqlPool pool(1);
+        pool.get(_T("no_such_source"), 0);
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestSqlPool);
+
 // vim:ts=4:sts=4:sw=4:et:
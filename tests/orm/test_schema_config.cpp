@@ -25,6 +25,10 @@ class TestXMLConfig : public CppUnit::TestFixture
     CPPUNIT_TEST(testParseTable);
     CPPUNIT_TEST(testNoAutoInc);
     CPPUNIT_TEST(testAutoInc);
+    CPPUNIT_TEST(testSeqIncrement);
+    CPPUNIT_TEST(testBatchSize);
+    CPPUNIT_TEST(testCache);
+    CPPUNIT_TEST_EXCEPTION(testCacheBadMode, XMLConfigError);
     CPPUNIT_TEST(testNullable);
     CPPUNIT_TEST(testClassName);
     CPPUNIT_TEST(testClassNameDefault);
@@ -135,6 +139,67 @@ public:
         CPPUNIT_ASSERT_EQUAL(true, t->autoinc());
     }
 
+    void testSeqIncrement()
+    {
+        ElementTree::ElementPtr node(ElementTree::parse(
+            "<table name='A' sequence='S' sequence-increment='50'>"
+            "<column type='longint' name='B'>"
+            "<primary-key/>"
+            "</column>"
+            "</table>"
+        ));
+        Table::Ptr t = cfg_.parse_table(node);
+        CPPUNIT_ASSERT_EQUAL(string("S"), NARROW(t->seq_name()));
+        CPPUNIT_ASSERT_EQUAL(50, t->seq_increment());
+    }
+
+    void testBatchSize()
+    {
+        ElementTree::ElementPtr node(ElementTree::parse(
+            "<table name='A' batch-size='100'>"
+            "<column type='longint' name='B'>"
+            "<primary-key/>"
+            "</column>"
+            "</table>"
+        ));
+        Table::Ptr t = cfg_.parse_table(node);
+        CPPUNIT_ASSERT_EQUAL(100, t->batch_size());
+        ElementTree::ElementPtr node2 = MetaDataConfig::table_to_tree(*t);
+        CPPUNIT_ASSERT_EQUAL(string("100"),
+                NARROW(node2->get_attr(_T("batch-size"))));
+    }
+
+    void testCache()
+    {
+        ElementTree::ElementPtr node(ElementTree::parse(
+            "<table name='A' cache='read-write' ttl='60'>"
+            "<column type='longint' name='B'>"
+            "<primary-key/>"
+            "</column>"
+            "</table>"
+        ));
+        Table::Ptr t = cfg_.parse_table(node);
+        CPPUNIT_ASSERT_EQUAL((int)Table::ReadWriteCache, t->cache_mode());
+        CPPUNIT_ASSERT_EQUAL(60, t->cache_ttl());
+        ElementTree::ElementPtr node2 = MetaDataConfig::table_to_tree(*t);
+        CPPUNIT_ASSERT_EQUAL(string("read-write"),
+                NARROW(node2->get_attr(_T("cache"))));
+        CPPUNIT_ASSERT_EQUAL(string("60"),
+                NARROW(node2->get_attr(_T("ttl"))));
+    }
+
+    void testCacheBadMode()
+    {
+        ElementTree::ElementPtr node(ElementTree::parse(
+            "<table name='A' cache='sometimes'>"
+            "<column type='longint' name='B'>"
+            "<primary-key/>"
+            "</column>"
+            "</table>"
+        ));
+        cfg_.parse_table(node);
+    }
+
     void testNullable()
     {
         ElementTree::ElementPtr node(ElementTree::parse(
@@ -5,6 +5,7 @@
 
 #include "util/string_utils.h"
 #include "util/element_tree.h"
+#include "util/nlogger.h"
 
 using namespace std;
 using namespace Yb;
@@ -491,4 +492,100 @@ public:
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestElementTree);
 
+static size_t count_lines(const string &s, const string &pattern)
+{
+    size_t count = 0, pos = 0;
+    while ((pos = s.find(pattern, pos)) != string::npos) {
+        ++count;
+        ++pos;
+    }
+    return count;
+}
+
+class LoggingThread: public Thread
+{
+    ILogger &logger_;
+    int n_;
+public:
+    LoggingThread(ILogger &logger, int n): logger_(logger), n_(n) {}
+    void on_run()
+    {
+        for (int i = 0; i < n_; ++i)
+            logger_.info("record " + to_stdstring(i));
+    }
+};
+
+class TestLogger: public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE(TestLogger);
+    CPPUNIT_TEST(testEnabled);
+    CPPUNIT_TEST(testAsyncAppender);
+    CPPUNIT_TEST(testAsyncAppenderDrop);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void testEnabled()
+    {
+        ostringstream out;
+        LogAppender appender(out);
+        Logger root(&appender);
+        ILogger::Ptr comp = root.new_logger("comp");
+        CPPUNIT_ASSERT(comp->enabled(ll_TRACE));
+        appender.set_level("comp", ll_INFO);
+        CPPUNIT_ASSERT(!comp->enabled(ll_DEBUG));
+        CPPUNIT_ASSERT(comp->enabled(ll_INFO));
+        comp->debug("hidden");
+        comp->info("shown");
+        appender.flush();
+        CPPUNIT_ASSERT_EQUAL((size_t)0, count_lines(out.str(), "hidden"));
+        CPPUNIT_ASSERT_EQUAL((size_t)1, count_lines(out.str(), "shown"));
+        appender.set_level("comp", ll_ALL);
+        CPPUNIT_ASSERT(comp->enabled(ll_DEBUG));
+    }
+
+    void testAsyncAppender()
+    {
+        const int n_threads = 4, n_records = 1000;
+        ostringstream out;
+        {
+            AsyncLogAppender appender(out, 16, AsyncLogAppender::BLOCK);
+            Logger root(&appender);
+            ILogger::Ptr comp = root.new_logger("comp");
+            std::vector<LoggingThread *> threads;
+            for (int i = 0; i < n_threads; ++i)
+                threads.push_back(new LoggingThread(*comp, n_records));
+            for (int i = 0; i < n_threads; ++i)
+                threads[i]->start();
+            for (int i = 0; i < n_threads; ++i) {
+                threads[i]->wait();
+                delete threads[i];
+            }
+            appender.flush();
+            CPPUNIT_ASSERT_EQUAL((size_t)(n_threads * n_records),
+                    count_lines(out.str(), " comp: record "));
+            CPPUNIT_ASSERT_EQUAL((LongInt)0, appender.get_dropped());
+            comp->info("last one");
+        }
+        // the destructor writes out what's left
+        CPPUNIT_ASSERT_EQUAL((size_t)1, count_lines(out.str(), "last one"));
+    }
+
+    void testAsyncAppenderDrop()
+    {
+        const int n_records = 10000;
+        ostringstream out;
+        AsyncLogAppender appender(out, 1, AsyncLogAppender::DROP);
+        Logger root(&appender);
+        LoggingThread writer(root, n_records);
+        writer.start();
+        writer.wait();
+        appender.flush();
+        CPPUNIT_ASSERT_EQUAL((size_t)n_records,
+                count_lines(out.str(), " main: record ")
+                + (size_t)appender.get_dropped());
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestLogger);
+
 // vim:ts=4:sts=4:sw=4:et:
@@ -30,6 +30,8 @@ class TestResultSet: public CppUnit::TestFixture
     CPPUNIT_TEST(testCopy);
     CPPUNIT_TEST(testLimitedCopy2);
     CPPUNIT_TEST(testLimitedCopy0);
+    CPPUNIT_TEST(testSwapRows);
+    CPPUNIT_TEST(testBuffersReused);
     CPPUNIT_TEST_EXCEPTION(testThrows, Yb::AssertError);
 
     CPPUNIT_TEST_SUITE_END();
@@ -89,6 +91,37 @@ public:
         CPPUNIT_ASSERT_EQUAL((size_t)0, out.size());
     }
 
+    void testSwapRows()
+    {
+        Items items(3), out(1, 5);
+        items[0] = 10; items[1] = 11; items[2] = 12;
+        MockResultSet rs(items);
+        Yb::swap_no_more_than_n(rs, 2, out);
+        CPPUNIT_ASSERT_EQUAL((size_t)3, out.size());
+        CPPUNIT_ASSERT_EQUAL(5, out[0]);
+        CPPUNIT_ASSERT_EQUAL(12, out[1]);
+        CPPUNIT_ASSERT_EQUAL(11, out[2]);
+    }
+
+    void testBuffersReused()
+    {
+        Items items(3);
+        items[0] = 10; items[1] = 11; items[2] = 12;
+        MockResultSet rs(items);
+        MockResultSet::iterator it = rs.begin(), end = rs.end();
+        Item *first = &*it;
+        Item *prev = it++;
+        CPPUNIT_ASSERT(first == prev);
+        CPPUNIT_ASSERT_EQUAL(12, *prev);
+        CPPUNIT_ASSERT_EQUAL(11, *it);
+        CPPUNIT_ASSERT(first != &*it);
+        ++it;
+        CPPUNIT_ASSERT_EQUAL(10, *it);
+        CPPUNIT_ASSERT(first == &*it);
+        ++it;
+        CPPUNIT_ASSERT(it == end);
+    }
+
     void testThrows()
     {
         Items items;
@@ -23,6 +23,8 @@ class TestValue : public CppUnit::TestFixture
     CPPUNIT_TEST(test_as_integer);
     CPPUNIT_TEST(test_as_float);
     CPPUNIT_TEST(test_swap);
+    CPPUNIT_TEST(test_swap_payloads);
+    CPPUNIT_TEST(test_copy_payloads);
     CPPUNIT_TEST(test_fix_type);
 #if defined(YB_USE_TUPLE)
     CPPUNIT_TEST(test_tuple_values);
@@ -37,6 +39,7 @@ class TestValue : public CppUnit::TestFixture
     CPPUNIT_TEST_EXCEPTION(test_value_bad_cast_date_time, ValueBadCast);
     CPPUNIT_TEST(testEmptyKey);
     CPPUNIT_TEST(testKey2Str);
+    CPPUNIT_TEST(testKeyHash);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -196,6 +199,52 @@ public:
         CPPUNIT_ASSERT_EQUAL(1234, a.as_integer());
     }
 
+    void test_swap_payloads()
+    {
+        Blob blob(3, 'z');
+        String long_str(100, _T('x'));
+        Values v;
+        v.push_back(Value(_T("ab")));
+        v.push_back(Value(long_str));
+        v.push_back(Value(Decimal(_T("-12.345"))));
+        v.push_back(Value(dt_make(2013, 5, 14, 10, 20, 30)));
+        v.push_back(Value(blob));
+        v.push_back(Value(2.5));
+        v.push_back(Value());
+        Values w(v);
+        for (size_t i = 0; i < v.size(); ++i)
+            for (size_t j = 0; j < v.size(); ++j) {
+                Value a(v[i]), b(v[j]);
+                a.swap(b);
+                CPPUNIT_ASSERT(v[j] == a && v[i] == b);
+                std::swap(a, b);
+                CPPUNIT_ASSERT(v[i] == a && v[j] == b);
+            }
+        std::reverse(w.begin(), w.end());
+        std::reverse(w.begin(), w.end());
+        CPPUNIT_ASSERT(v == w);
+        CPPUNIT_ASSERT_EQUAL(long_str, w[1].read_as<String>());
+        CPPUNIT_ASSERT(blob == w[4].read_as<Blob>());
+    }
+
+    void test_copy_payloads()
+    {
+        Value a(_T("short")), b(String(100, _T('y')));
+        Value c(a);
+        c = b;
+        CPPUNIT_ASSERT(b == c);
+        c = Value(Decimal(_T("1.5")));
+        CPPUNIT_ASSERT_EQUAL(string("1.5"), NARROW(c.as_string()));
+        c = a;
+        a = Value(1);
+        CPPUNIT_ASSERT_EQUAL(string("short"), NARROW(c.as_string()));
+        c = c;
+        CPPUNIT_ASSERT_EQUAL(string("short"), NARROW(c.read_as<String>()));
+        c.fix_type(Value::BLOB);
+        CPPUNIT_ASSERT_EQUAL((int)Value::BLOB, (int)c.get_type());
+        CPPUNIT_ASSERT_EQUAL((size_t)5, c.read_as<Blob>().size());
+    }
+
     void test_fix_type()
     {
         Value a(1234), b(_T("12.3"));
@@ -307,6 +356,33 @@ public:
         k5.fields.push_back(std::make_pair(&col_a, Value(10)));
         CPPUNIT_ASSERT_EQUAL(string("Key('TBL1', {'A': 10})"), NARROW(key2str(k5)));
     }
+
+    void testKeyHash()
+    {
+        String tbl_name = _T("TBL1"), tbl_name2 = _T("TBL1"), col_a = _T("A");
+        Key k1(&tbl_name, &col_a, 10, false), k2(&tbl_name2, &col_a, 10, false);
+        CPPUNIT_ASSERT(k1 == k2);
+        CPPUNIT_ASSERT_EQUAL(key_hash(k1), key_hash(k2));
+        k2.id_value = 11;
+        CPPUNIT_ASSERT(key_hash(k1) != key_hash(k2));
+        Value equal_values[][2] = {
+            { Value(5), Value((LongInt)5) },
+            { Value(5), Value(_T("5")) },
+            { Value(Decimal(_T("1.50"))), Value(Decimal(_T("1.5"))) },
+            { Value(Decimal(_T("2.00"))), Value(2) },
+            { Value(_T("1.5")), Value(Decimal(_T("1.50"))) },
+            { Value(_T("-0")), Value(-0.0) },
+            { Value(0.0), Value(-0.0) },
+            { Value(dt_make(2013, 5, 14)), Value(dt_make(2013, 5, 14)) },
+        };
+        for (size_t i = 0; i < sizeof(equal_values) / sizeof(equal_values[0]); ++i) {
+            Key x(&tbl_name), y(&tbl_name2);
+            x.fields.push_back(std::make_pair(&col_a, equal_values[i][0]));
+            y.fields.push_back(std::make_pair(&col_a, equal_values[i][1]));
+            CPPUNIT_ASSERT(x == y);
+            CPPUNIT_ASSERT_EQUAL(key_hash(x), key_hash(y));
+        }
+    }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestValue);